@@ -0,0 +1,790 @@
+// <BEHOLD the GPL!>
+// ntheory's dsp-bench, microbenchmarks for DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include "../library/DSPlib.h"
+#include "../library/DSPlibSIMD.h"
+#include "../library/DSPlibOscillator.h"
+#include "../library/DSPlibFilter.h"
+#include "../library/DSPlibResonator.h"
+#include "../library/DSPlibTopology.h"
+#include "../library/DSPlibMetrics.h"
+#include "../library/DSPlibPipeline.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+
+// How long each measurement should run for.  Long enough to ride out the clock ramping up.
+#define		BENCH_TARGET_NS			50000000.0
+
+// The array length for the array primitives.  Small enough to stay in L1 so we measure the loops, not memory.
+#define		BENCH_ARRAY_LENGTH		1024
+
+// The oscillator benchmark makes this many tones this long (long enough for phase drift to show up)
+#define		BENCH_OSCILLATOR_TONES		8
+#define		BENCH_OSCILLATOR_LENGTH		(1 << 20)
+#define		BENCH_OSCILLATOR_RATE		8000
+
+// The filter benchmark runs this much audio through the eight DTMF detectors at each rate.  The FIRs are sized the
+// way tt-dec sizes them (tone +/- 0.7 %, 20 dB down at the neighbouring tones' pass bands) and the resonators are
+// all 19.5 Hz wide, also like tt-dec.
+#define		BENCH_FILTER_LENGTH_MS		1000
+#define		BENCH_FILTER_TOLERANCE		0.007
+#define		BENCH_FILTER_ATTENUATION	20.0
+#define		BENCH_FILTER_BANDWIDTH		19.5
+
+// The decimator benchmark takes this much 48 kHz audio down to 8 kHz the way "tt-dec --decimate 6" does (passing
+// 80 % of the new Nyquist frequency), in tt-dec's block size
+#define		BENCH_DECIMATOR_RATE		48000
+#define		BENCH_DECIMATOR_FACTOR		6
+#define		BENCH_DECIMATOR_PASS_BAND	3200.0
+#define		BENCH_DECIMATOR_INPUT		BENCH_DECIMATOR_RATE
+#define		BENCH_DECIMATOR_OUTPUT		(BENCH_DECIMATOR_INPUT / BENCH_DECIMATOR_FACTOR)
+#define		BENCH_DECIMATOR_BLOCK		4096
+
+// The socket benchmark runs the 8 kHz FIR bank (the same filters as above) on a block this long over and over, on
+// more and more cores of one node at a time
+#define		BENCH_SOCKET_RATE		8000
+#define		BENCH_SOCKET_BLOCK		1024
+
+// The metrics benchmark makes this many updates per call, and times them on one thread and then on up to this many at
+// once (one per CPU)
+#define		BENCH_METRICS_UPDATES		1024
+#define		BENCH_METRICS_THREADS		8
+
+// The buffers every array benchmark works on
+fftw_real *In1, *In2, *In3, *In4, *Out;
+short     *Shorts;
+
+// One array primitive to time.  Run calls the kernel from the given set on the buffers above.
+typedef struct {
+  const char *Name;
+  void (*Run) (DSPlibArrayKernelsType *Kernels);
+} ArrayBenchType;
+
+static void RunMix2      (DSPlibArrayKernelsType *Kernels) { Kernels->MixArrays2 (In1, In2, Out, BENCH_ARRAY_LENGTH); }
+static void RunMix4      (DSPlibArrayKernelsType *Kernels) { Kernels->MixArrays4 (In1, In2, In3, In4, Out, BENCH_ARRAY_LENGTH); }
+static void RunMultiply2 (DSPlibArrayKernelsType *Kernels) { Kernels->MultiplyArrays2 (In1, In2, Out, BENCH_ARRAY_LENGTH); }
+static void RunMultiply4 (DSPlibArrayKernelsType *Kernels) { Kernels->MultiplyArrays4 (In1, In2, In3, In4, Out, BENCH_ARRAY_LENGTH); }
+static void RunMaxAbs    (DSPlibArrayKernelsType *Kernels) { Out [0] = Kernels->MaxAbs (In1, BENCH_ARRAY_LENGTH); }
+static void RunNormalize (DSPlibArrayKernelsType *Kernels) { Kernels->DivideArray (In1, Kernels->MaxAbs (In1, BENCH_ARRAY_LENGTH), Out, BENCH_ARRAY_LENGTH); }
+static void RunInvert    (DSPlibArrayKernelsType *Kernels) { CopyArray (In1, Out, BENCH_ARRAY_LENGTH); Kernels->InvertArray (Out, BENCH_ARRAY_LENGTH); }
+static void RunToInts    (DSPlibArrayKernelsType *Kernels) { Kernels->ConvertToInts (In4, Shorts, BENCH_ARRAY_LENGTH); }
+static void RunToReals   (DSPlibArrayKernelsType *Kernels) { Kernels->ConvertToReals (Shorts, Out, BENCH_ARRAY_LENGTH); }
+
+static ArrayBenchType ArrayBenches [] = {
+  { "MixArrays (2)",      RunMix2      },
+  { "MixArrays (4)",      RunMix4      },
+  { "MultiplyArrays (2)", RunMultiply2 },
+  { "MultiplyArrays (4)", RunMultiply4 },
+  { "MaxAbs",             RunMaxAbs    },
+  { "Normalize",          RunNormalize },
+  { "InvertArray",        RunInvert    },
+  { "ConvertToInts",      RunToInts    },
+  { "ConvertToReals",     RunToReals   },
+  { NULL,                 NULL         }
+};
+
+// Monotonic time in nanoseconds
+double Now ()
+{
+  struct timespec Time;
+
+  clock_gettime (CLOCK_MONOTONIC, &Time);
+
+  return (double) Time.tv_sec * 1e9 + (double) Time.tv_nsec;
+}
+
+// Run something over and over until BENCH_TARGET_NS has gone by and return the nanoseconds per call
+double TimeIt (void (*Run) (DSPlibArrayKernelsType *Kernels), DSPlibArrayKernelsType *Kernels)
+{
+  long Iterations = 1, Loop;
+  double Start, Elapsed;
+
+  // Warm up and then keep doubling the iteration count until the run is long enough to trust
+  Run (Kernels);
+
+  for (;;) {
+    Start = Now ();
+
+    for (Loop = 0; Loop < Iterations; Loop++) {
+      Run (Kernels);
+    }
+
+    Elapsed = Now () - Start;
+
+    if (Elapsed >= BENCH_TARGET_NS) {
+      return Elapsed / (double) Iterations;
+    }
+
+    Iterations *= 2;
+  }
+}
+
+void BenchArrays ()
+{
+  int BestISA = DSPlibDetectISA ();
+  double Scalar, Current;
+  fftw_real *Reference = new fftw_real [BENCH_ARRAY_LENGTH];
+  short *ReferenceShorts = new short [BENCH_ARRAY_LENGTH];
+
+  printf ("Array primitives (%d elements, ns per element, speedup over scalar)\n\n", BENCH_ARRAY_LENGTH);
+  printf ("  %-20s", "");
+
+  for (int ISA = DSPLIB_ISA_SCALAR; ISA <= BestISA; ISA++) {
+    printf ("%16s", DSPlibISAName (ISA));
+  }
+
+  printf ("\n");
+
+  for (int Bench = 0; ArrayBenches [Bench].Name != NULL; Bench++) {
+    printf ("  %-20s", ArrayBenches [Bench].Name);
+
+    // Get the scalar answer to check every other level against
+    ArrayBenches [Bench].Run (DSPlibGetArrayKernels (DSPLIB_ISA_SCALAR));
+    memcpy (Reference, Out, BENCH_ARRAY_LENGTH * sizeof (fftw_real));
+    memcpy (ReferenceShorts, Shorts, BENCH_ARRAY_LENGTH * sizeof (short));
+
+    Scalar = TimeIt (ArrayBenches [Bench].Run, DSPlibGetArrayKernels (DSPLIB_ISA_SCALAR));
+
+    for (int ISA = DSPLIB_ISA_SCALAR; ISA <= BestISA; ISA++) {
+      Current = (ISA == DSPLIB_ISA_SCALAR) ? Scalar : TimeIt (ArrayBenches [Bench].Run, DSPlibGetArrayKernels (ISA));
+
+      if ((memcmp (Reference, Out, BENCH_ARRAY_LENGTH * sizeof (fftw_real)) != 0) ||
+	  (memcmp (ReferenceShorts, Shorts, BENCH_ARRAY_LENGTH * sizeof (short)) != 0)) {
+	printf ("%16s", "MISMATCH");
+      }
+      else {
+	printf ("%7.3f (%5.2fx)", Current / BENCH_ARRAY_LENGTH, Scalar / Current);
+      }
+    }
+
+    printf ("\n");
+  }
+
+  printf ("\n");
+
+  delete [] Reference;
+  delete [] ReferenceShorts;
+}
+
+// The oscillator benchmark's tones and output
+double      OscillatorFrequencies [BENCH_OSCILLATOR_TONES] = { 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
+fftw_real  *OscillatorOut [BENCH_OSCILLATOR_TONES];
+
+// Every tone the way GenerateSine used to do it: one sin () per sample
+static void RunLibmSines (DSPlibArrayKernelsType *Kernels)
+{
+  for (int Tone = 0; Tone < BENCH_OSCILLATOR_TONES; Tone++) {
+    double Omega = 2.0 * M_PI * OscillatorFrequencies [Tone] / (double) BENCH_OSCILLATOR_RATE;
+
+    for (int Loop = 0; Loop < BENCH_OSCILLATOR_LENGTH; Loop++) {
+      OscillatorOut [Tone][Loop] = sin (Omega * (double) Loop);
+    }
+  }
+}
+
+// Every tone at once from the oscillator bank
+static void RunOscillatorBank (DSPlibArrayKernelsType *Kernels)
+{
+  DSPlibOscillatorBank Oscillators (BENCH_OSCILLATOR_TONES, OscillatorFrequencies, NULL, NULL, BENCH_OSCILLATOR_RATE);
+
+  Oscillators.Generate (OscillatorOut, BENCH_OSCILLATOR_LENGTH);
+}
+
+// The worst difference from a long double reference with the phase reduced exactly
+double OscillatorError ()
+{
+  long double Cycles, Error, Worst = 0.0;
+
+  for (int Tone = 0; Tone < BENCH_OSCILLATOR_TONES; Tone++) {
+    for (long Loop = 0; Loop < BENCH_OSCILLATOR_LENGTH; Loop++) {
+      Cycles = fmodl ((long double) OscillatorFrequencies [Tone] * (long double) Loop, (long double) BENCH_OSCILLATOR_RATE) /
+	       (long double) BENCH_OSCILLATOR_RATE;
+      Error  = fabsl (sinl (2.0L * 3.14159265358979323846264338327950288L * Cycles) - (long double) OscillatorOut [Tone][Loop]);
+
+      if (Error > Worst) {
+	Worst = Error;
+      }
+    }
+  }
+
+  return (double) Worst;
+}
+
+void BenchOscillators ()
+{
+  double Libm, Bank, LibmError, BankError;
+  long Samples = (long) BENCH_OSCILLATOR_TONES * BENCH_OSCILLATOR_LENGTH;
+
+  for (int Tone = 0; Tone < BENCH_OSCILLATOR_TONES; Tone++) {
+    OscillatorOut [Tone] = new fftw_real [BENCH_OSCILLATOR_LENGTH];
+  }
+
+  printf ("Sine generation (%d tones x %d samples, ns per sample, worst error)\n\n",
+	  BENCH_OSCILLATOR_TONES, BENCH_OSCILLATOR_LENGTH);
+
+  Libm = TimeIt (RunLibmSines, NULL);
+  LibmError = OscillatorError ();
+
+  Bank = TimeIt (RunOscillatorBank, NULL);
+  BankError = OscillatorError ();
+
+  printf ("  %-20s%7.3f          %.3g\n", "sin () per sample", Libm / Samples, LibmError);
+  printf ("  %-20s%7.3f (%5.2fx) %.3g\n", "oscillator bank", Bank / Samples, Libm / Bank, BankError);
+  printf ("\n");
+
+  for (int Tone = 0; Tone < BENCH_OSCILLATOR_TONES; Tone++) {
+    delete [] OscillatorOut [Tone];
+  }
+}
+
+// The filter benchmark's tones, banks and input
+double          FilterFrequencies [8] = { 697, 770, 852, 941, 1209, 1336, 1477, 1633 };
+DSPlibFilter   *FIRBank [8];
+DSPlibResonatorBank *IIRBank;
+fftw_real      *FilterIn, *FilterOut [8];
+int             FilterLength;
+
+// Every sample through every FIR one at a time, like tt-dec does it
+static void RunFIRBank (DSPlibArrayKernelsType *Kernels)
+{
+  for (int Loop = 0; Loop < FilterLength; Loop++) {
+    for (int Tone = 0; Tone < 8; Tone++) {
+      FIRBank [Tone]->PutSample (FilterIn [Loop]);
+      FilterOut [Tone][Loop] = FIRBank [Tone]->GetSample ();
+    }
+  }
+}
+
+// Every sample through the resonators one at a time, like tt-dec does it
+static void RunIIRSamples (DSPlibArrayKernelsType *Kernels)
+{
+  fftw_real Outputs [8];
+
+  for (int Loop = 0; Loop < FilterLength; Loop++) {
+    IIRBank->Filter (FilterIn [Loop], Outputs);
+  }
+
+  FilterOut [0][0] = Outputs [0];
+}
+
+// The whole input through the resonators in one call
+static void RunIIRBlock (DSPlibArrayKernelsType *Kernels)
+{
+  IIRBank->Filter (FilterIn, FilterLength, FilterOut);
+}
+
+void BenchFilters (int Rate)
+{
+  double LowPass, HighPass, LowStop, HighStop, Bandwidths [8];
+  double FIR, Samples, Block;
+  fftw_real *Taps;
+  int TapCount, TotalTaps = 0;
+
+  FilterLength = Rate / 1000 * BENCH_FILTER_LENGTH_MS;
+  FilterIn     = new fftw_real [FilterLength];
+
+  for (int Tone = 0; Tone < 8; Tone++) {
+    FilterOut [Tone] = new fftw_real [FilterLength];
+  }
+
+  // A "5" at about -10 dB in 16 bit units
+  GenerateSine (FilterIn,      FilterLength, 770.0,  10000.0, Rate);
+  GenerateSine (FilterOut [0], FilterLength, 1336.0, 10000.0, Rate);
+  MixArrays (FilterIn, FilterOut [0], FilterIn, FilterLength);
+
+  for (int Tone = 0; Tone < 8; Tone++) {
+    LowPass  = FilterFrequencies [Tone] * (1.0 - BENCH_FILTER_TOLERANCE);
+    HighPass = FilterFrequencies [Tone] * (1.0 + BENCH_FILTER_TOLERANCE);
+
+    LowStop  = (Tone > 0) ? FilterFrequencies [Tone - 1] * (1.0 + BENCH_FILTER_TOLERANCE) : 0.0;
+    HighStop = (Tone < 7) ? FilterFrequencies [Tone + 1] * (1.0 - BENCH_FILTER_TOLERANCE) : 0.0;
+
+    if (Tone == 0) LowStop  = LowPass  - (HighStop - HighPass);
+    if (Tone == 7) HighStop = HighPass + (LowPass - LowStop);
+
+    CreateBandPassFilter (LowStop, LowPass, HighPass, HighStop, BENCH_FILTER_ATTENUATION, Rate, &TapCount, &Taps);
+
+    FIRBank [Tone] = new DSPlibFilter (TapCount, Taps);
+    TotalTaps += TapCount;
+
+    delete [] Taps;
+
+    Bandwidths [Tone] = BENCH_FILTER_BANDWIDTH;
+  }
+
+  IIRBank = new DSPlibResonatorBank (8, FilterFrequencies, Bandwidths, Rate);
+
+  printf ("DTMF filter banks at %d Hz (%d samples, ns per input sample, multiply-adds per input sample)\n\n",
+	  Rate, FilterLength);
+
+  FIR     = TimeIt (RunFIRBank,    NULL);
+  Samples = TimeIt (RunIIRSamples, NULL);
+  Block   = TimeIt (RunIIRBlock,   NULL);
+
+  printf ("  %-20s%9.1f            %5d\n", "FIR bank", FIR / FilterLength, TotalTaps);
+  printf ("  %-20s%9.1f (%6.2fx)  %5d\n", "IIR (per sample)", Samples / FilterLength, FIR / Samples, 8 * 5);
+  printf ("  %-20s%9.1f (%6.2fx)  %5d\n", "IIR (block)", Block / FilterLength, FIR / Block, 8 * 5);
+  printf ("\n");
+
+  for (int Tone = 0; Tone < 8; Tone++) {
+    delete FIRBank [Tone];
+    delete [] FilterOut [Tone];
+  }
+
+  delete IIRBank;
+  delete [] FilterIn;
+}
+
+// The decimator benchmark's input and output, and how far the source stage has got through the input
+short *DecimatorIn, *DecimatorOut;
+long   DecimatorNext;
+
+// Hand the input out a block at a time, like tt-dec's convert stage
+static bool RunDecimatorSource (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out)
+{
+  long Count = BENCH_DECIMATOR_INPUT - DecimatorNext;
+
+  Count = (Count < Out->Capacity) ? Count : Out->Capacity;
+
+  memcpy (Out->Data, &DecimatorIn [DecimatorNext], Count * sizeof (short));
+
+  Out->Position  = DecimatorNext;
+  Out->Length    = Count;
+  DecimatorNext += Count;
+
+  return (Count > 0);
+}
+
+// The whole input through a new decimator.  It uses whichever kernels DSPlibSetISA picked last.
+static void RunDecimator (DSPlibArrayKernelsType *Kernels)
+{
+  DSPlibPipeline   Pipeline;
+  DSPlibDecimator  Decimator (BENCH_DECIMATOR_FACTOR, BENCH_DECIMATOR_RATE, BENCH_DECIMATOR_PASS_BAND, 0,
+			      BENCH_DECIMATOR_OUTPUT);
+  DSPlibBlockType *Block;
+  int Last;
+
+  DecimatorNext = 0;
+
+  Pipeline.AddStage ("source", RunDecimatorSource, NULL, sizeof (short), BENCH_DECIMATOR_BLOCK);
+  Last = Pipeline.AddStage ("decimate", DSPlibDecimator::Stage, &Decimator, sizeof (short), BENCH_DECIMATOR_BLOCK);
+
+  while ((Block = Pipeline.Pull (Last)) != NULL) {
+    memcpy (&DecimatorOut [Block->Position], Block->Data, Block->Length * sizeof (short));
+  }
+}
+
+void BenchDecimator ()
+{
+  int BestISA = DSPlibDetectISA ();
+  double Scalar, Current;
+  fftw_real *Low  = new fftw_real [BENCH_DECIMATOR_INPUT];
+  fftw_real *High = new fftw_real [BENCH_DECIMATOR_INPUT];
+  short *Reference = new short [BENCH_DECIMATOR_OUTPUT];
+  bool Matches;
+
+  DecimatorIn  = new short [BENCH_DECIMATOR_INPUT];
+  DecimatorOut = new short [BENCH_DECIMATOR_OUTPUT];
+
+  // A "5" at about -10 dB in 16 bit units
+  GenerateSine (Low,  BENCH_DECIMATOR_INPUT, 770.0,  10000.0, BENCH_DECIMATOR_RATE);
+  GenerateSine (High, BENCH_DECIMATOR_INPUT, 1336.0, 10000.0, BENCH_DECIMATOR_RATE);
+  MixArrays (Low, High, Low, BENCH_DECIMATOR_INPUT);
+  ConvertToInts (Low, DecimatorIn, BENCH_DECIMATOR_INPUT);
+
+  printf ("Decimator (%d Hz to %d Hz, ns per output sample, output samples per second, speedup over scalar)\n\n",
+	  BENCH_DECIMATOR_RATE, BENCH_DECIMATOR_RATE / BENCH_DECIMATOR_FACTOR);
+
+  // Get the scalar answer to check every other level against.  The vector dot products add up in a different order,
+  // so they're allowed to round a sample the other way.
+  DSPlibSetISA (DSPLIB_ISA_SCALAR);
+  RunDecimator (NULL);
+  memcpy (Reference, DecimatorOut, BENCH_DECIMATOR_OUTPUT * sizeof (short));
+
+  Scalar = TimeIt (RunDecimator, NULL);
+
+  for (int ISA = DSPLIB_ISA_SCALAR; ISA <= BestISA; ISA++) {
+    DSPlibSetISA (ISA);
+
+    Current = (ISA == DSPLIB_ISA_SCALAR) ? Scalar : TimeIt (RunDecimator, NULL);
+    Matches = true;
+
+    for (int Loop = 0; Loop < BENCH_DECIMATOR_OUTPUT; Loop++) {
+      if (abs (DecimatorOut [Loop] - Reference [Loop]) > 1) {
+	Matches = false;
+      }
+    }
+
+    if (!Matches) {
+      printf ("  %-20s%16s\n", DSPlibISAName (ISA), "MISMATCH");
+    }
+    else {
+      printf ("  %-20s%9.1f %12.0f (%5.2fx)\n", DSPlibISAName (ISA), Current / BENCH_DECIMATOR_OUTPUT,
+	      BENCH_DECIMATOR_OUTPUT * 1e9 / Current, Scalar / Current);
+    }
+  }
+
+  printf ("\n");
+
+  DSPlibSetISA (BestISA);
+
+  delete [] Low;
+  delete [] High;
+  delete [] Reference;
+  delete [] DecimatorIn;
+  delete [] DecimatorOut;
+}
+
+// One core's worth of the socket benchmark.  A local worker makes its own bank and input once it's pinned, so they're
+// on its node.  Otherwise they were made for it on another node beforehand.
+typedef struct {
+  DSPlibTopology *Topology;
+  int             Placement;
+  bool            Local;
+
+  DSPlibFilter   *Bank [8];
+  fftw_real      *In;
+
+  pthread_barrier_t *Start;
+  double          Elapsed;
+  long            Samples;
+  pthread_t       Thread;
+} SocketWorkerType;
+
+fftw_real *SocketTaps [8];
+int        SocketTapCounts [8];
+
+static void CreateSocketBank (SocketWorkerType *Worker)
+{
+  for (int Tone = 0; Tone < 8; Tone++) {
+    Worker->Bank [Tone] = new DSPlibFilter (SocketTapCounts [Tone], SocketTaps [Tone]);
+  }
+
+  Worker->In = new fftw_real [BENCH_SOCKET_BLOCK];
+
+  GenerateSine (Worker->In, BENCH_SOCKET_BLOCK, 770.0, 10000.0, BENCH_SOCKET_RATE);
+}
+
+static void DeleteSocketBank (SocketWorkerType *Worker)
+{
+  for (int Tone = 0; Tone < 8; Tone++) {
+    delete Worker->Bank [Tone];
+  }
+
+  delete [] Worker->In;
+}
+
+static void *RunSocketWorker (void *Argument)
+{
+  SocketWorkerType *Worker = (SocketWorkerType *) Argument;
+  fftw_real Sum = 0.0;
+  double Start;
+
+  Worker->Topology->Pin (Worker->Placement);
+
+  if (Worker->Local) {
+    CreateSocketBank (Worker);
+  }
+
+  // Everybody starts at once so they're all fighting over the memory together
+  pthread_barrier_wait (Worker->Start);
+
+  Start = Now ();
+  Worker->Samples = 0;
+
+  do {
+    for (int Loop = 0; Loop < BENCH_SOCKET_BLOCK; Loop++) {
+      for (int Tone = 0; Tone < 8; Tone++) {
+	Worker->Bank [Tone]->PutSample (Worker->In [Loop]);
+	Sum += Worker->Bank [Tone]->GetSample ();
+      }
+    }
+
+    Worker->Samples += BENCH_SOCKET_BLOCK;
+    Worker->Elapsed  = Now () - Start;
+  } while (Worker->Elapsed < BENCH_TARGET_NS);
+
+  // Keep the compiler from throwing the filtering away
+  Worker->In [0] += Sum * 0.0;
+
+  return NULL;
+}
+
+// Millions of input samples a second through Count workers on the first Count cores of Topology.  If Home isn't -1
+// the banks are all made by this thread on the CPU at Home of Everywhere first.
+double RunSocketWorkers (DSPlibTopology *Topology, int Count, DSPlibTopology *Everywhere, int Home)
+{
+  SocketWorkerType *Workers = new SocketWorkerType [Count];
+  pthread_barrier_t Start;
+  double Rate = 0.0;
+
+  pthread_barrier_init (&Start, NULL, Count);
+
+  if (Home >= 0) {
+    Everywhere->Pin (Home);
+  }
+
+  for (int Worker = 0; Worker < Count; Worker++) {
+    Workers [Worker].Topology  = Topology;
+    Workers [Worker].Placement = Worker;
+    Workers [Worker].Local     = (Home < 0);
+    Workers [Worker].Start     = &Start;
+
+    if (Home >= 0) {
+      CreateSocketBank (&Workers [Worker]);
+    }
+  }
+
+  for (int Worker = 0; Worker < Count; Worker++) {
+    pthread_create (&Workers [Worker].Thread, NULL, RunSocketWorker, &Workers [Worker]);
+  }
+
+  for (int Worker = 0; Worker < Count; Worker++) {
+    pthread_join (Workers [Worker].Thread, NULL);
+
+    Rate += Workers [Worker].Samples / Workers [Worker].Elapsed * 1000.0;
+    DeleteSocketBank (&Workers [Worker]);
+  }
+
+  pthread_barrier_destroy (&Start);
+  delete [] Workers;
+
+  return Rate;
+}
+
+// Print how a node (or every node, for -1) scales from one core to all of them, with the banks on the node and with
+// them on the next node over
+void BenchSocket (DSPlibTopology *Everywhere, int Node)
+{
+  DSPlibTopology *Topology = new DSPlibTopology ();
+  double Single = 0.0, Local, Remote;
+  int Cores = 0, Home = -1, Other = (Node >= 0) ? ((Node + 1) % Everywhere->GetNodeCount ()) : -1;
+
+  if (Node >= 0) {
+    Topology->KeepNode (Node);
+  }
+
+  // Workers only go one to a core.  The first CPU of the next node over is where the remote banks get made.
+  for (int Index = 0; Index < Topology->GetCPUCount (); Index++) {
+    Cores += Topology->IsFirstOnCore (Index) ? 1 : 0;
+  }
+
+  for (int Index = 0; (Other != Node) && (Home < 0) && (Index < Everywhere->GetCPUCount ()); Index++) {
+    if (Everywhere->GetNode (Index) == Other) {
+      Home = Index;
+    }
+  }
+
+  if (Node >= 0) {
+    printf ("  node %d (socket %d, %d cores)\n", Everywhere->GetNodeNumber (Node), Topology->GetPackage (0), Cores);
+  }
+  else {
+    printf ("  every node (%d sockets, %d cores)\n", Everywhere->GetPackageCount (), Cores);
+  }
+
+  printf ("    %-8s%20s%12s\n", "cores", "local", "remote");
+
+  // One core, then twice as many each time up to all of them
+  for (int Count = 1; Count <= Cores; Count = ((Count == Cores) || (2 * Count < Cores)) ? (2 * Count) : Cores) {
+    Local = RunSocketWorkers (Topology, Count, Everywhere, -1);
+
+    if (Count == 1) {
+      Single = Local;
+    }
+
+    printf ("    %-8d%8.2f (%5.2fx)", Count, Local, Local / Single);
+
+    if (Home >= 0) {
+      Remote = RunSocketWorkers (Topology, Count, Everywhere, Home);
+      printf ("%12.2f", Remote);
+    }
+    else {
+      printf ("%12s", "-");
+    }
+
+    printf ("\n");
+  }
+
+  printf ("\n");
+
+  delete Topology;
+}
+
+void BenchSockets ()
+{
+  DSPlibTopology *Everywhere = new DSPlibTopology ();
+  double LowPass, HighPass, LowStop, HighStop;
+
+  for (int Tone = 0; Tone < 8; Tone++) {
+    LowPass  = FilterFrequencies [Tone] * (1.0 - BENCH_FILTER_TOLERANCE);
+    HighPass = FilterFrequencies [Tone] * (1.0 + BENCH_FILTER_TOLERANCE);
+
+    LowStop  = (Tone > 0) ? FilterFrequencies [Tone - 1] * (1.0 + BENCH_FILTER_TOLERANCE) : 0.0;
+    HighStop = (Tone < 7) ? FilterFrequencies [Tone + 1] * (1.0 - BENCH_FILTER_TOLERANCE) : 0.0;
+
+    if (Tone == 0) LowStop  = LowPass  - (HighStop - HighPass);
+    if (Tone == 7) HighStop = HighPass + (LowPass - LowStop);
+
+    CreateBandPassFilter (LowStop, LowPass, HighPass, HighStop, BENCH_FILTER_ATTENUATION, BENCH_SOCKET_RATE,
+			  &SocketTapCounts [Tone], &SocketTaps [Tone]);
+  }
+
+  printf ("Scaling per socket (%d Hz FIR bank on 1 to every core of each node, millions of samples per second,\n"
+	  "speedup over one core, and the same with every bank made on the next node over)\n\n", BENCH_SOCKET_RATE);
+
+  for (int Node = 0; Node < Everywhere->GetNodeCount (); Node++) {
+    BenchSocket (Everywhere, Node);
+  }
+
+  if (Everywhere->GetNodeCount () > 1) {
+    BenchSocket (Everywhere, -1);
+  }
+
+  for (int Tone = 0; Tone < 8; Tone++) {
+    delete [] SocketTaps [Tone];
+  }
+
+  delete Everywhere;
+}
+
+// The metrics benchmark's registry, its counter and histogram, and a counter every thread adds to with an atomic
+// instruction (what the per-thread copies save us from)
+DSPlibMetrics *BenchMetrics;
+int            BenchCounter, BenchHistogram;
+long           SharedCount;
+
+static void RunCounter   (DSPlibArrayKernelsType *Kernels) { for (long Loop = 0; Loop < BENCH_METRICS_UPDATES; Loop++) BenchMetrics->Add (BenchCounter, 1); }
+static void RunHistogram (DSPlibArrayKernelsType *Kernels) { for (long Loop = 0; Loop < BENCH_METRICS_UPDATES; Loop++) BenchMetrics->Observe (BenchHistogram, Loop * 997); }
+static void RunShared    (DSPlibArrayKernelsType *Kernels) { for (long Loop = 0; Loop < BENCH_METRICS_UPDATES; Loop++) __atomic_fetch_add (&SharedCount, 1, __ATOMIC_RELAXED); }
+
+static ArrayBenchType MetricsBenches [] = {
+  { "Counter (Add)",       RunCounter   },
+  { "Histogram (Observe)", RunHistogram },
+  { "Shared atomic add",   RunShared    },
+  { NULL,                  NULL         }
+};
+
+// One thread of the metrics benchmark
+typedef struct {
+  void    (*Run) (DSPlibArrayKernelsType *Kernels);
+  double    Elapsed;
+  pthread_t Thread;
+} MetricsWorkerType;
+
+static void *RunMetricsWorker (void *Argument)
+{
+  MetricsWorkerType *Worker = (MetricsWorkerType *) Argument;
+
+  Worker->Elapsed = TimeIt (Worker->Run, NULL);
+
+  return NULL;
+}
+
+void BenchMetricsUpdates ()
+{
+  MetricsWorkerType Workers [BENCH_METRICS_THREADS];
+  int Threads = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  double Elapsed;
+
+  Threads = (Threads < 1) ? 1 : (Threads > BENCH_METRICS_THREADS) ? BENCH_METRICS_THREADS : Threads;
+
+  BenchMetrics   = new DSPlibMetrics ();
+  BenchCounter   = BenchMetrics->AddCounter ("bench_updates_total", "", "Updates.");
+  BenchHistogram = BenchMetrics->AddHistogram ("bench_values", "", "Values.", 1.0);
+
+  printf ("Metrics (ns per update on one thread, and on each of %d threads at once)\n\n", Threads);
+  printf ("  %-20s%16s%16s\n", "", "1 thread", "threads");
+
+  for (int Bench = 0; MetricsBenches [Bench].Name != NULL; Bench++) {
+    printf ("  %-20s%16.3f", MetricsBenches [Bench].Name, TimeIt (MetricsBenches [Bench].Run, NULL) / BENCH_METRICS_UPDATES);
+
+    for (int Worker = 0; Worker < Threads; Worker++) {
+      Workers [Worker].Run = MetricsBenches [Bench].Run;
+      pthread_create (&Workers [Worker].Thread, NULL, RunMetricsWorker, &Workers [Worker]);
+    }
+
+    Elapsed = 0.0;
+
+    for (int Worker = 0; Worker < Threads; Worker++) {
+      pthread_join (Workers [Worker].Thread, NULL);
+      Elapsed += Workers [Worker].Elapsed;
+    }
+
+    printf ("%16.3f\n", Elapsed / Threads / BENCH_METRICS_UPDATES);
+  }
+
+  printf ("\n");
+
+  delete BenchMetrics;
+}
+
+int main (int argc, char **argv) {
+  const char *Only = argv [1];
+
+  // Fill the buffers with something that isn't all the same.  In4 goes past the range of a short so the
+  // conversions have to saturate.
+  In1 = new fftw_real [BENCH_ARRAY_LENGTH]; In2 = new fftw_real [BENCH_ARRAY_LENGTH];
+  In3 = new fftw_real [BENCH_ARRAY_LENGTH]; In4 = new fftw_real [BENCH_ARRAY_LENGTH];
+  Out = new fftw_real [BENCH_ARRAY_LENGTH];
+  Shorts = new short [BENCH_ARRAY_LENGTH];
+
+  GenerateSine (In1, BENCH_ARRAY_LENGTH, 697.0,  1.0,     8000);
+  GenerateSine (In2, BENCH_ARRAY_LENGTH, 1209.0, 0.5,     8000);
+  GenerateSine (In3, BENCH_ARRAY_LENGTH, 941.0,  0.25,    8000);
+  GenerateSine (In4, BENCH_ARRAY_LENGTH, 1633.0, 40000.0, 8000);
+
+  ConvertToInts (In4, Shorts, BENCH_ARRAY_LENGTH);
+
+  printf ("Best instruction set: %s\n\n", DSPlibISAName (DSPlibDetectISA ()));
+
+  if ((Only == NULL) || (strcmp (Only, "arrays") == 0)) {
+    BenchArrays ();
+  }
+
+  if ((Only == NULL) || (strcmp (Only, "oscillator") == 0)) {
+    BenchOscillators ();
+  }
+
+  if ((Only == NULL) || (strcmp (Only, "filters") == 0)) {
+    BenchFilters (8000);
+    BenchFilters (48000);
+  }
+
+  if ((Only == NULL) || (strcmp (Only, "decimator") == 0)) {
+    BenchDecimator ();
+  }
+
+  if ((Only == NULL) || (strcmp (Only, "sockets") == 0)) {
+    BenchSockets ();
+  }
+
+  if ((Only == NULL) || (strcmp (Only, "metrics") == 0)) {
+    BenchMetricsUpdates ();
+  }
+
+  delete [] In1; delete [] In2; delete [] In3; delete [] In4;
+  delete [] Out;
+  delete [] Shorts;
+}
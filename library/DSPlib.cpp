@@ -28,8 +28,11 @@
 #include <sys/soundcard.h>	// For the printer or something...
 
 #include "DSPlib.h"
+#include "DSPlibSIMD.h"
+#include "DSPlibOscillator.h"
+#include "DSPlibTrace.h"
 
-#define		DSPLIB_PI		3.14159
+#define		DSPLIB_PI		3.14159265358979323846
 
 const int	DSPLIB_BITS_PER_SAMPLE	= 16;
 const int	DSPLIB_CHANNELS		= 1;
@@ -40,7 +43,8 @@ const int	DSPLIB_ANY_RATE		= -1;
 //     These functions are used to generate various types of waves.  Currently there are only sine waves supported.
 //
 //   Notes:
-//     These functions always use the fftw_real type so FFTW can work with them.
+//     These functions always use the fftw_real type so FFTW can work with them.  They're one tone runs of
+//       DSPlibOscillatorBank, so use that directly to make a lot of tones (or one very long one) at once.
 // --------------------------------------------------------------------------------------------------------------------
 
 void GenerateSine (fftw_real *Out, int Length, double Frequency, double Amplitude, int SamplingRate)
@@ -50,19 +54,9 @@ void GenerateSine (fftw_real *Out, int Length, double Frequency, double Amplitud
 
 void GenerateSine (fftw_real *Out, int Length, double Frequency, double Amplitude, double Phase, int SamplingRate)
 {
-  double TwoPi = DSPLIB_PI * 2;
-  double SamplingRateOverLength = (double) SamplingRate / (double) Length;
-  double Position, CurrentValue;
-  double RadianPhase = Phase / (double) 360 * TwoPi;
+  DSPlibOscillatorBank Oscillator (1, &Frequency, &Amplitude, &Phase, SamplingRate);
 
-  for (int Loop = 0; Loop < Length; Loop++) {
-    Position = (((double) Loop / (double) Length) * TwoPi) / SamplingRateOverLength;
-    Position += RadianPhase;
-
-    CurrentValue = sin (Position * Frequency) * Amplitude;
-
-    Out [Loop] = CurrentValue;
-  }
+  Oscillator.GenerateMix (Out, Length);
 }
 
 void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplitude, int SamplingRate)
@@ -80,7 +74,8 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
 //     These functions are used to work with arrays.
 //
 //   Notes:
-//     These functions always use the fftw_real type so FFTW can work with them.
+//     These functions always use the fftw_real type so FFTW can work with them.  The loops themselves live in
+//       DSPlibSIMD.cpp, which picks SSE2/AVX2/AVX-512 versions at run time.
 // --------------------------------------------------------------------------------------------------------------------
 
   // Mix two or four arrays using addition ----------------------------------------------------------------------------
@@ -91,16 +86,12 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
 
     void MixArrays (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
     {
-      for (int Loop = 0; Loop < Length; Loop++) {
-        Out [Loop] = (In1 [Loop] + In2 [Loop]) / 2;
-      }
+      DSPlibArrayKernels->MixArrays2 (In1, In2, Out, Length);
     }
 
     void MixArrays (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
     {
-      for (int Loop = 0; Loop < Length; Loop++) {
-        Out [Loop] = (In1 [Loop] + In2 [Loop] + In3 [Loop] + In4 [Loop]) / 4;
-      }
+      DSPlibArrayKernels->MixArrays4 (In1, In2, In3, In4, Out, Length);
     }
 
   // Mix two arrays using multiplication ------------------------------------------------------------------------------
@@ -110,9 +101,12 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
 
     void MultiplyArrays (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
     {
-      for (int Loop = 0; Loop < Length; Loop++) {
-        Out [Loop] = In1 [Loop] * In2 [Loop];
-      }
+      DSPlibArrayKernels->MultiplyArrays2 (In1, In2, Out, Length);
+    }
+
+    void MultiplyArrays (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
+    {
+      DSPlibArrayKernels->MultiplyArrays4 (In1, In2, In3, In4, Out, Length);
     }
 
   // Save an array to disk --------------------------------------------------------------------------------------------
@@ -143,7 +137,7 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
         printf ("fopen failed for %s\n", FinalFileName);
       }
 
-      delete FinalFileName;
+      delete [] FinalFileName;
     }
 
   // Save an array to disk as a SoX readable .dat file ----------------------------------------------------------------
@@ -169,7 +163,7 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
         fprintf (OutFile, "; Sample Rate %d\n", SamplingRate);
 
         for (int Loop = 0; Loop < Length; Loop++) {
-          fprintf (OutFile, "%lf\n", Data [Loop]);
+          fprintf (OutFile, "%lf\n", NormalizedData [Loop]);
         }
 
         fprintf (OutFile, "\n");
@@ -179,39 +173,61 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
         printf ("fopen failed for %s\n", FinalFileName);
       }
 
-      delete NormalizedData;
-      delete FinalFileName;
+      delete [] NormalizedData;
+      delete [] FinalFileName;
     }
 
-  // Normalize an array -----------------------------------------------------------------------------------------------
+  // Save an array to disk as a binary trace ---------------------------------------------------------------------------
   //   Notes:
-  //     Normalizes an array of type "fftw_real".
+  //     Much smaller and faster than SaveArray for long arrays.  The trace has one column called "value" and a row
+  //       rate of SamplingRate, and tt-trace turns any part of it back into text.
   // ------------------------------------------------------------------------------------------------------------------
 
-    void Normalize (fftw_real *In, fftw_real *Out, int Length)
+    void SaveArrayAsTrace (fftw_real *Data, int Length, int SamplingRate, char *FileName, char *OutputDirectory)
     {
-      // Find the largest element's absolute value.
-      fftw_real Largest = fabs (In [0]);
-      fftw_real Current;
+      char *FinalFileName = new char [strlen (OutputDirectory) + strlen ("/") + strlen (FileName) + strlen (".trace") + 1];
+      const char *ColumnNames [1] = { "value" };
 
-      for (int Loop = 1; Loop < Length; Loop++) {
-	Current = fabs (In [Loop]);
+      strcpy (FinalFileName, OutputDirectory);
+      strcat (FinalFileName, "/");
+      strcat (FinalFileName, FileName);
+      strcat (FinalFileName, ".trace");
 
-	if (Largest < Current) {
-	  Largest = Current;
-	}
-      }
+      DSPlibTraceWriter *Trace = new DSPlibTraceWriter (FinalFileName, 1, ColumnNames, SamplingRate, NULL);
 
-      // Now divide all the elements by the largest.
       for (int Loop = 0; Loop < Length; Loop++) {
-	Out [Loop] = In [Loop] / Largest;
+        Trace->PutRow (&Data [Loop]);
+      }
+
+      Trace->Flush ();
+
+      if (!Trace->IsGood ()) {
+        printf ("Couldn't write %s\n", FinalFileName);
       }
+
+      delete Trace;
+      delete [] FinalFileName;
+    }
+
+  // Normalize an array -----------------------------------------------------------------------------------------------
+  //   Notes:
+  //     Normalizes an array of type "fftw_real".
+  // ------------------------------------------------------------------------------------------------------------------
+
+    void Normalize (fftw_real *In, fftw_real *Out, int Length)
+    {
+      // Find the largest element's absolute value (one branch-free vector pass).
+      fftw_real Largest = DSPlibArrayKernels->MaxAbs (In, Length);
+
+      // Now divide all the elements by the largest.
+      DSPlibArrayKernels->DivideArray (In, Largest, Out, Length);
     }
 
   // Calculate a power spectrum and perform band-pass filtering -------------------------------------------------------
   //   Notes:
-  //     Two separate functions.  These functions have not been tested in a VERY long time.  This comment will be
-  //     updated when I know they are both working.
+  //     Two separate functions.  Both work on rfftw's halfcomplex output (the real parts of buckets 0 to N / 2 in
+  //     order, then the imaginary parts of buckets N / 2 - 1 back down to 1).  CalculatePowerSpectrum is what
+  //     DSPlibSpectrum uses for tt-dec's FFT engine.
   //
   //     The band-pass filter is not an FIR or IIR.  It works on frequency domain data and is simply an iterative
   //     approach to removing the necessary FFT buckets.
@@ -233,15 +249,21 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
 
     void BandPassFilter (fftw_real *Data, int Start, int End, int SamplingRate, int FFTSize)
     {
-      int BucketSize = FFTSize / SamplingRate;
-
-      // Start the loop after the DC coefficient (element 0)
-      for (int Loop = 1; Loop < Start / BucketSize; Loop++) {
-        Data [Loop] = 0;
-      }
-
-      for (int Loop = End / BucketSize; Loop < FFTSize; Loop++) {
-        Data [Loop] = 0;
+      // The width of a bucket in Hz.  This has to be a double (and the right way up), an int is 0 for any FFT
+      // shorter than a second.
+      double BucketSize = (double) SamplingRate / (double) FFTSize;
+      int StartBucket = (int) ceil ((double) Start / BucketSize);
+      int EndBucket   = (int) floor ((double) End / BucketSize);
+
+      // Start the loop after the DC coefficient (element 0) and clear both halves of every bucket outside the band
+      for (int Loop = 1; Loop <= FFTSize / 2; Loop++) {
+        if ((Loop < StartBucket) || (Loop > EndBucket)) {
+          Data [Loop] = 0;
+
+          if (Loop < (FFTSize + 1) / 2) {
+            Data [FFTSize - Loop] = 0;
+          }
+        }
       }
     }
 
@@ -252,23 +274,16 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
 
     void InvertArray (fftw_real *Data, int Length)
     {
-      for (int Loop = 0; Loop < Length; Loop++) {
-        Data [Loop] = -Data [Loop];
-      }
+      DSPlibArrayKernels->InvertArray (Data, Length);
     }
 
   // Copy array -------------------------------------------------------------------------------------------------------
   //   Notes:
-  //     None.
-  //
-  //   Future improvements:
-  //     Use memcpy.
+  //     Just memcpy.  The C library already picks the widest copy the CPU can do.
   // ------------------------------------------------------------------------------------------------------------------
     void CopyArray (fftw_real *Source, fftw_real *Destination, int Length)
     {
-      for (int Loop = 0; Loop < Length; Loop++) {
-        Destination [Loop] = Source [Loop];
-      }
+      memcpy (Destination, Source, Length * sizeof (fftw_real));
     }
 
 // Soundcard related functions ----------------------------------------------------------------------------------------
@@ -336,19 +351,24 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
   {
     SDL_AudioSpec BasicAudioInfo;
     SDL_AudioSpec *ReturnSample;
+    Uint32 Length = 0;
 
     // We want signed 16-bit samples in the system's endianness, one channel at DesiredRate.
     BasicAudioInfo.format   = SDL_AUDIO_DESIRED_FORMAT;
     BasicAudioInfo.channels = SDL_AUDIO_DESIRED_CHANNELS;
     BasicAudioInfo.freq     = DesiredRate;
 
-    ReturnSample = SDL_LoadWAV (FileName, &BasicAudioInfo, AudioBuffer, (Uint32 *) AudioBufferLength);
+    // SDL hands back the spec we gave it, which lives on our stack, so the caller gets a copy of it once we're done.
+    // The length is a Uint32 to SDL no matter how big an unsigned long is.
+    ReturnSample = SDL_LoadWAV (FileName, &BasicAudioInfo, AudioBuffer, &Length);
 
     // Make sure the return sample is valid!
     if (ReturnSample == NULL) {
       return ReturnSample;
     }
-    
+
+    (*AudioBufferLength) = Length;
+
     // If we don't care about the rate just use the one that is returned.
     if (DesiredRate == DSPLIB_ANY_RATE) DesiredRate = ReturnSample->freq;
 
@@ -392,7 +412,7 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
       // It matches, do nothing.
     }
 
-    return ReturnSample;
+    return (ReturnSample != NULL) ? new SDL_AudioSpec (*ReturnSample) : NULL;
   }
 
 // Conversion functions -----------------------------------------------------------------------------------------------
@@ -409,14 +429,13 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
   //     This converts an array of type "fftw_real" to an array of type "short".
   //
   //   Notes:
-  //     No checking is performed to avoid clipping.  It is left up to coersion by the compiler.
+  //     Values outside of the range of a short are clipped to -32768 and 32767.  Everything else is truncated
+  //       towards zero like a plain cast.
   // ------------------------------------------------------------------------------------------------------------------
 
   void ConvertToInts (fftw_real *Input, short *Output, int Length)
   {
-    for (int Loop = 0; Loop < Length; Loop++) {
-      Output [Loop] = (short) Input [Loop];
-    }
+    DSPlibArrayKernels->ConvertToInts (Input, Output, Length);
   }
 
   // Convert to reals from integers -----------------------------------------------------------------------------------
@@ -429,9 +448,7 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
 
   void ConvertToReals (short *Input, fftw_real *Output, int Length)
   {
-    for (int Loop = 0; Loop < Length; Loop++) {
-      Output [Loop] = (fftw_real) Input [Loop];
-    }
+    DSPlibArrayKernels->ConvertToReals (Input, Output, Length);
   }
 
 // Filter creation functions ------------------------------------------------------------------------------------------
@@ -442,15 +459,175 @@ void GenerateCosine (fftw_real *Out, int Length, double Frequency, double Amplit
 //     None.
 // --------------------------------------------------------------------------------------------------------------------
 
+  // Create a window ------------------------------------------------------------------------------------------------
+  //   Description:
+  //     Fills Out with one of the DSPLIB_WINDOW_* shapes for tapering a block before an FFT.
+  //
+  //   Notes:
+  //     These are the "periodic" versions (they'd repeat seamlessly every Length samples), which is what you want
+  //       for spectral analysis.
+  // ------------------------------------------------------------------------------------------------------------------
+
+  void CreateWindow (fftw_real *Out, int Length, int Type)
+  {
+    double Phase;
+
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Phase = 2.0 * DSPLIB_PI * (double) Loop / (double) Length;
+
+      switch (Type) {
+        case DSPLIB_WINDOW_HANN:     Out [Loop] = 0.5 - 0.5 * cos (Phase); break;
+        case DSPLIB_WINDOW_HAMMING:  Out [Loop] = 0.54 - 0.46 * cos (Phase); break;
+        case DSPLIB_WINDOW_BLACKMAN: Out [Loop] = 0.42 - 0.5 * cos (Phase) + 0.08 * cos (2.0 * Phase); break;
+        default:                     Out [Loop] = 1.0; break;
+      }
+    }
+  }
+
+  // Kaiser window helpers --------------------------------------------------------------------------------------------
+  //   Description:
+  //     The band pass filters are windowed sincs with a Kaiser window.  The window has one knob (Beta) that trades
+  //       the width of the transition band for stopband attenuation, and Kaiser worked out formulas that go from the
+  //       attenuation you want to Beta and from the transition width you want to the number of taps.  So instead of
+  //       guessing at a filter length we can ask for the shortest filter that does the job.
+  //
+  //   Notes:
+  //     Attenuations are in dB (positive), widths and frequencies are in Hz.
+  // ------------------------------------------------------------------------------------------------------------------
+
+  // The zeroth order modified Bessel function of the first kind.  The series converges quickly for the Betas we use.
+  static double BesselI0 (double X)
+  {
+    double Sum = 1.0, Term = 1.0;
+    double HalfX = X / 2.0;
+
+    for (int K = 1; K < 100; K++) {
+      Term *= (HalfX / (double) K) * (HalfX / (double) K);
+      Sum  += Term;
+
+      if (Term < (Sum * 1e-16)) {
+	break;
+      }
+    }
+
+    return Sum;
+  }
+
+  // The Beta that gives the requested stopband attenuation
+  static double KaiserBeta (double Attenuation)
+  {
+    if (Attenuation > 50.0) {
+      return 0.1102 * (Attenuation - 8.7);
+    }
+    else if (Attenuation >= 21.0) {
+      return (0.5842 * pow (Attenuation - 21.0, 0.4)) + (0.07886 * (Attenuation - 21.0));
+    }
+
+    // Below 21 dB a rectangular window is already good enough
+    return 0.0;
+  }
+
+  int KaiserTapCount (double TransitionWidth, double Attenuation, int SamplingRate)
+  {
+    double Width = TransitionWidth / (double) SamplingRate;
+    int Taps;
+
+    // Kaiser's estimate of the filter order, plus one for the number of taps.  It only holds above 21 dB.  Below that
+    // the window's rectangular (see KaiserBeta) and its transition band is 0.9222 / Taps wide whatever's asked for.
+    if (Attenuation > 21.0) {
+      Taps = (int) ceil ((Attenuation - 7.95) / (14.36 * Width)) + 1;
+    }
+    else {
+      Taps = (int) ceil (0.9222 / Width) + 1;
+    }
+
+    // Keep it odd so the filter has a whole sample of delay and is symmetric around a tap
+    if ((Taps % 2) == 0) {
+      Taps++;
+    }
+
+    if (Taps < 3) {
+      Taps = 3;
+    }
+
+    return Taps;
+  }
+
+  // Fill Out with a Kaiser windowed band pass between LowCutoff and HighCutoff, scaled so the gain at the middle
+  // of the band is exactly one.
+  static void KaiserBandPass (double LowCutoff, double HighCutoff, double Beta, int SamplingRate, int Taps, fftw_real *Out)
+  {
+    double Middle = (double) (Taps - 1) / 2.0;
+    double Low = LowCutoff / (double) SamplingRate, High = HighCutoff / (double) SamplingRate;
+    double Center = (Low + High) / 2.0;
+    double Window, Ideal, Offset, Re = 0.0, Im = 0.0, Gain;
+
+    for (int Loop = 0; Loop < Taps; Loop++) {
+      Offset = (double) Loop - Middle;
+
+      // The ideal band pass is the difference of two low passes
+      if (Offset == 0.0) {
+	Ideal = 2.0 * (High - Low);
+      }
+      else {
+	Ideal = (sin (2.0 * DSPLIB_PI * High * Offset) - sin (2.0 * DSPLIB_PI * Low * Offset)) / (DSPLIB_PI * Offset);
+      }
+
+      Window = BesselI0 (Beta * sqrt (1.0 - ((Offset / Middle) * (Offset / Middle)))) / BesselI0 (Beta);
+
+      Out [Loop] = Ideal * Window;
+
+      // Keep track of the response at the center of the band
+      Re += Out [Loop] * cos (2.0 * DSPLIB_PI * Center * Offset);
+      Im += Out [Loop] * sin (2.0 * DSPLIB_PI * Center * Offset);
+    }
+
+    Gain = sqrt ((Re * Re) + (Im * Im));
+
+    for (int Loop = 0; Loop < Taps; Loop++) {
+      Out [Loop] /= Gain;
+    }
+  }
+
   // Create a band pass filter ----------------------------------------------------------------------------------------
   //   Description:
-  //     This function creates a band pass filter automatically calculating the parameters based on the "Taps" and
-  //       "SamplingRate" parameters.
+  //     These functions create a band pass filter and allocate *Out for the caller (who has to delete [] it).  The
+  //       first one uses the number of taps it's given and puts the -6 dB points Width apart around CenterFreq with a
+  //       DSPLIB_DEFAULT_ATTENUATION window, and returns false (with *Out NULL) if there are fewer than two.  The
+  //       second one is given the edges of the pass band and of the stop band on either side and works out the fewest
+  //       taps (returned in *Taps) that meet them.
   //
   //   Notes:
-  //     Not implemented yet.  Yay!
+  //     The transition band is the same width on both sides of a windowed sinc, so the narrower side sets the
+  //       length and the wider side just ends up steeper than it had to be.
   // ------------------------------------------------------------------------------------------------------------------
 
-  //void CreateBandPassFilter (double CenterFreq, double Width, int SamplingRate, int Taps, fftw_real **Out)
-  //{
-  //}
+  bool CreateBandPassFilter (double CenterFreq, double Width, int SamplingRate, int Taps, fftw_real **Out)
+  {
+    // The window's worked out from each tap's distance from the middle over half the length, which a single tap
+    // hasn't got
+    if (Taps < 2) {
+      *Out = NULL;
+      return false;
+    }
+
+    *Out = new fftw_real [Taps];
+
+    KaiserBandPass (CenterFreq - (Width / 2.0), CenterFreq + (Width / 2.0), KaiserBeta (DSPLIB_DEFAULT_ATTENUATION),
+		    SamplingRate, Taps, *Out);
+
+    return true;
+  }
+
+  void CreateBandPassFilter (double LowStop, double LowPass, double HighPass, double HighStop, double Attenuation,
+			     int SamplingRate, int *Taps, fftw_real **Out)
+  {
+    double Transition = ((LowPass - LowStop) < (HighStop - HighPass)) ? (LowPass - LowStop) : (HighStop - HighPass);
+
+    *Taps = KaiserTapCount (Transition, Attenuation, SamplingRate);
+    *Out  = new fftw_real [*Taps];
+
+    // Put the cutoffs in the middle of each transition band
+    KaiserBandPass ((LowStop + LowPass) / 2.0, (HighPass + HighStop) / 2.0, KaiserBeta (Attenuation), SamplingRate,
+		    *Taps, *Out);
+  }
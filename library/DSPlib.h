@@ -14,28 +14,44 @@ void MultiplyArrays (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
 void MultiplyArrays (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length);
 void SaveArray (fftw_real *Data, int Length, char *FileName, char *OutputDirectory);					// Save an array to a file.
 void SaveArrayForSoX (fftw_real *Data, int Length, int SamplingRate, char *FileName, char *OutputDirectory);		// Save an array to a file (playable by SoX).
+void SaveArrayAsTrace (fftw_real *Data, int Length, int SamplingRate, char *FileName, char *OutputDirectory);		// Save an array to a binary trace (see DSPlibTrace.h).
 void Normalize (fftw_real *In, fftw_real *Out, int Length);								// Normalize an array of type "fftw_real".
 void InvertArray (fftw_real *Data, int Length);										// Flip an array upside down (for processing IFFTs that come out inverted).
 void CopyArray (fftw_real *Source, fftw_real *Destination, int Length);							// Copy an array to another array.
 
+// Spectrum related functions.  These work on rfftw halfcomplex arrays.
+void CalculatePowerSpectrum (fftw_real *Series, fftw_real *PowerSpectrum, int DataSize);				// Get the power in buckets 0 to DataSize / 2.
+void BandPassFilter (fftw_real *Data, int Start, int End, int SamplingRate, int FFTSize);				// Clear every bucket outside Start to End Hz.
+
 // Soundcard related functions.
 int ConfigureSoundCard (int Channels, int Bits, int Rate, char *DeviceFile, int IOType);				// Get a handle to the soundcard.
 int SyncSoundCard (int SoundCardHandle);										// Call IOCTL to sync the soundcard (used before writing).
 
 // File related functions.
 SDL_AudioSpec *GetSoundDataFromWAV (char *FileName, int DesiredRate,
-		                    unsigned char **AudioBuffer, unsigned long *AudioBufferLength);			// Get data from a file, decode with SDL, and return at the desired rate.
+		                    unsigned char **AudioBuffer, unsigned long *AudioBufferLength);			// Get data from a file, decode with SDL, and return at the desired rate (delete the spec when done).
 
 // Conversion functions.
 void ConvertToInts (fftw_real *Input, short *Output, int Length);							// Convert from reals to ints.
 void ConvertToReals (short *Input, fftw_real *Output, int Length);							// Convert from ints to reals.
 
 // Filter creation functions.
-void CreateBandPassFilter (double CenterFreq, double Width, int SamplingRate, int Taps, fftw_real **Out);
+void CreateWindow (fftw_real *Out, int Length, int Type);								// Make a DSPLIB_WINDOW_* window for an FFT.
+bool CreateBandPassFilter (double CenterFreq, double Width, int SamplingRate, int Taps, fftw_real **Out);		// Create a Kaiser windowed band pass filter (allocates *Out, false if Taps < 2).
+void CreateBandPassFilter (double LowStop, double LowPass, double HighPass, double HighStop, double Attenuation,
+			   int SamplingRate, int *Taps, fftw_real **Out);						// Same, with the length worked out from the band edges.
+int  KaiserTapCount (double TransitionWidth, double Attenuation, int SamplingRate);					// Fewest taps for a transition width (Hz) and stopband attenuation (dB).
 
 // Defines needed to do our job.
 #define		DSPLIB_CURRENT_DIRECTORY	"."
 
+#define		DSPLIB_DEFAULT_ATTENUATION	40.0		// Stopband attenuation (dB) for filters made without a spec
+
+#define		DSPLIB_WINDOW_RECTANGULAR	0		// Window shapes for CreateWindow
+#define		DSPLIB_WINDOW_HANN		1
+#define		DSPLIB_WINDOW_HAMMING		2
+#define		DSPLIB_WINDOW_BLACKMAN		3
+
 #define		SDL_AUDIO_BUFFER_SIZE		(2 << 31)
 #define		SDL_AUDIO_DESIRED_CHANNELS	1
 
@@ -103,6 +103,8 @@ long      DSPlibFilter::PutSample  (fftw_real Sample)
   else {
     this->BufferedSamples [this->BufferedSamplePos++] = (Sample / 32768.0);
   }
+
+  return this->BufferedSamplePos;
 }
 
 void DSPlibFilter::Filter ()
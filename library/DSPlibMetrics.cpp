@@ -0,0 +1,654 @@
+// <BEHOLD the GPL!>
+// ntheory's DSPlibMetrics, live counters and histograms to complement DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "DSPlibMetrics.h"
+
+// What every thread's copy is lined up on (a cache line)
+#define		DSPLIB_METRICS_ALIGNMENT	64
+
+// The longest request we read, and how long we wait for the rest of one before answering anyway
+#define		DSPLIB_METRICS_REQUEST_BYTES	4096
+#define		DSPLIB_METRICS_REQUEST_MS	1000
+
+__thread int DSPlibMetricsThread = 0;
+
+// How many threads have counted something in any registry
+static int MetricsThreadCount = 0;
+
+struct DSPlibMetricType {
+  int    Type;
+  char  *Name, *Labels, *Help;
+  double Scale;
+};
+
+// A server: the socket it listens on, and a pipe that wakes its thread up to stop it
+struct DSPlibMetricsServerType {
+  int        Listener;
+  int        Wake [2];
+  char      *SocketName;
+  pthread_t  Thread;
+};
+
+static char *CopyString (const char *String)
+{
+  char *Copy = new char [strlen (String) + 1];
+
+  strcpy (Copy, String);
+
+  return Copy;
+}
+
+DSPlibMetrics::DSPlibMetrics ()
+{
+  this->MetricCount = 0;
+  this->CopySize    = 0;
+  this->Server      = NULL;
+
+  memset (this->Gauges, 0, sizeof (this->Gauges));
+
+  for (int Thread = 0; Thread < DSPLIB_METRICS_MAX_THREADS; Thread++) {
+    this->Copies [Thread] = NULL;
+  }
+}
+
+DSPlibMetrics::~DSPlibMetrics ()
+{
+  this->StopServing ();
+
+  for (int Thread = 0; Thread < DSPLIB_METRICS_MAX_THREADS; Thread++) {
+    free (this->Copies [Thread]);
+  }
+
+  for (int Metric = 0; Metric < this->MetricCount; Metric++) {
+    delete [] this->Metrics [Metric]->Name;
+    delete [] this->Metrics [Metric]->Labels;
+    delete [] this->Metrics [Metric]->Help;
+    delete this->Metrics [Metric];
+  }
+}
+
+static int AddMetric (DSPlibMetricType **Metrics, int *MetricCount, int *Offsets, long *CopySize, int Type,
+		      const char *Name, const char *Labels, const char *Help, double Scale)
+{
+  DSPlibMetricType *Metric;
+
+  if (*MetricCount == DSPLIB_METRICS_MAX_METRICS) {
+    return -1;
+  }
+
+  Metric = new DSPlibMetricType;
+
+  Metric->Type   = Type;
+  Metric->Name   = CopyString (Name);
+  Metric->Labels = CopyString ((Labels != NULL) ? Labels : "");
+  Metric->Help   = CopyString (Help);
+  Metric->Scale  = Scale;
+
+  // A counter is one long in every thread's copy, a histogram is its buckets and then its sum, and a gauge is only
+  // ever set so there's just the one
+  Offsets [*MetricCount] = *CopySize;
+
+  if (Type == DSPLIB_METRICS_COUNTER) {
+    *CopySize += 1;
+  }
+  else if (Type == DSPLIB_METRICS_HISTOGRAM) {
+    *CopySize += DSPLIB_METRICS_BUCKETS + 1;
+  }
+
+  Metrics [*MetricCount] = Metric;
+
+  return (*MetricCount)++;
+}
+
+int DSPlibMetrics::AddCounter (const char *Name, const char *Labels, const char *Help)
+{
+  return AddMetric (this->Metrics, &this->MetricCount, this->Offsets, &this->CopySize, DSPLIB_METRICS_COUNTER, Name,
+		    Labels, Help, 1.0);
+}
+
+int DSPlibMetrics::AddGauge (const char *Name, const char *Labels, const char *Help)
+{
+  return AddMetric (this->Metrics, &this->MetricCount, this->Offsets, &this->CopySize, DSPLIB_METRICS_GAUGE, Name,
+		    Labels, Help, 1.0);
+}
+
+int DSPlibMetrics::AddHistogram (const char *Name, const char *Labels, const char *Help, double Scale)
+{
+  return AddMetric (this->Metrics, &this->MetricCount, this->Offsets, &this->CopySize, DSPLIB_METRICS_HISTOGRAM, Name,
+		    Labels, Help, Scale);
+}
+
+// A thread's copy -----------------------------------------------------------------------------------------------------
+//   Description:
+//     Gives the calling thread its number the first time it counts anything (in any registry) and its copy of this
+//       registry's metrics the first time it counts something in it.
+//
+//   Notes:
+//     Only the thread a copy belongs to ever sets its pointer, but whatever reads the metrics can be looking at the
+//       pointers at the same time, so it's published with a release and read back with an acquire after the copy has
+//       been cleared.  The shared copy is made by whichever thread gets there first.
+// ---------------------------------------------------------------------------------------------------------------------
+
+long *DSPlibMetrics::CreateCopy ()
+{
+  long *Copy, *Expected = NULL;
+  int Thread;
+  void *Memory;
+
+  if (DSPlibMetricsThread == 0) {
+    Thread = __atomic_add_fetch (&MetricsThreadCount, 1, __ATOMIC_RELAXED);
+
+    DSPlibMetricsThread = (Thread < DSPLIB_METRICS_MAX_THREADS) ? Thread : DSPLIB_METRICS_MAX_THREADS;
+  }
+
+  Thread = DSPlibMetricsThread - 1;
+  Copy   = __atomic_load_n (&this->Copies [Thread], __ATOMIC_ACQUIRE);
+
+  if (Copy != NULL) {
+    return Copy;
+  }
+
+  if (posix_memalign (&Memory, DSPLIB_METRICS_ALIGNMENT, ((this->CopySize > 0) ? this->CopySize : 1) * sizeof (long)) != 0) {
+    printf ("Couldn't make room for the metrics.\n");
+    exit (0);
+  }
+
+  Copy = (long *) Memory;
+
+  memset (Copy, 0, this->CopySize * sizeof (long));
+
+  if (!__atomic_compare_exchange_n (&this->Copies [Thread], &Expected, Copy, false, __ATOMIC_RELEASE,
+				    __ATOMIC_ACQUIRE)) {
+    free (Copy);
+    Copy = Expected;
+  }
+
+  return Copy;
+}
+
+void DSPlibMetrics::Gather (int Metric, long *Counts, int Length)
+{
+  long *Copy;
+
+  memset (Counts, 0, Length * sizeof (long));
+
+  for (int Thread = 0; Thread < DSPLIB_METRICS_MAX_THREADS; Thread++) {
+    if ((Copy = __atomic_load_n (&this->Copies [Thread], __ATOMIC_ACQUIRE)) == NULL) {
+      continue;
+    }
+
+    Copy = &Copy [this->Offsets [Metric]];
+
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Counts [Loop] += __atomic_load_n (&Copy [Loop], __ATOMIC_RELAXED);
+    }
+  }
+}
+
+long DSPlibMetrics::GetLowest (int Bucket)
+{
+  int Shift = Bucket / DSPLIB_METRICS_SUB_BUCKETS - 1;
+
+  if (Bucket < (2 * DSPLIB_METRICS_SUB_BUCKETS)) {
+    return Bucket;
+  }
+
+  return (long) (Bucket - Shift * DSPLIB_METRICS_SUB_BUCKETS) << Shift;
+}
+
+long DSPlibMetrics::GetHighest (int Bucket)
+{
+  int Shift = Bucket / DSPLIB_METRICS_SUB_BUCKETS - 1;
+
+  if (Bucket < (2 * DSPLIB_METRICS_SUB_BUCKETS)) {
+    return Bucket;
+  }
+
+  return GetLowest (Bucket) + ((1L << Shift) - 1);
+}
+
+long DSPlibMetrics::GetCount (int Metric)
+{
+  long Buckets [DSPLIB_METRICS_BUCKETS + 1];
+  long Count = 0;
+
+  switch (this->Metrics [Metric]->Type) {
+    case DSPLIB_METRICS_COUNTER:
+      this->Gather (Metric, &Count, 1);
+      break;
+    case DSPLIB_METRICS_HISTOGRAM:
+      this->Gather (Metric, Buckets, DSPLIB_METRICS_BUCKETS);
+
+      for (int Bucket = 0; Bucket < DSPLIB_METRICS_BUCKETS; Bucket++) {
+	Count += Buckets [Bucket];
+      }
+      break;
+  }
+
+  return Count;
+}
+
+double DSPlibMetrics::GetValue (int Metric)
+{
+  long Buckets [DSPLIB_METRICS_BUCKETS + 1];
+  long Bits;
+  double Value = 0.0;
+
+  switch (this->Metrics [Metric]->Type) {
+    case DSPLIB_METRICS_COUNTER:
+      Value = (double) this->GetCount (Metric);
+      break;
+    case DSPLIB_METRICS_GAUGE:
+      Bits = __atomic_load_n (&this->Gauges [Metric], __ATOMIC_RELAXED);
+      memcpy (&Value, &Bits, sizeof (Value));
+      break;
+    case DSPLIB_METRICS_HISTOGRAM:
+      this->Gather (Metric, Buckets, DSPLIB_METRICS_BUCKETS + 1);
+      Value = (double) Buckets [DSPLIB_METRICS_BUCKETS] * this->Metrics [Metric]->Scale;
+      break;
+  }
+
+  return Value;
+}
+
+double DSPlibMetrics::GetQuantile (int Metric, double Quantile)
+{
+  long Buckets [DSPLIB_METRICS_BUCKETS];
+  long Count = 0, Total = 0;
+
+  this->Gather (Metric, Buckets, DSPLIB_METRICS_BUCKETS);
+
+  for (int Bucket = 0; Bucket < DSPLIB_METRICS_BUCKETS; Bucket++) {
+    Count += Buckets [Bucket];
+  }
+
+  for (int Bucket = 0; Bucket < DSPLIB_METRICS_BUCKETS; Bucket++) {
+    Total += Buckets [Bucket];
+
+    if ((Total > 0) && ((double) Total >= (Quantile * (double) Count))) {
+      return (double) GetHighest (Bucket) * this->Metrics [Metric]->Scale;
+    }
+  }
+
+  return 0.0;
+}
+
+// Prometheus' text format ---------------------------------------------------------------------------------------------
+//   Description:
+//     Every family (the metrics with the same name) gets its help and type once, followed by each of its metrics.  A
+//       histogram's buckets are cumulative and each one says the largest value it counts ("le"), which for ours is
+//       the largest value that lands in the bucket, scaled.
+//
+//   Notes:
+//     Writing out all of a histogram's buckets would be hundreds of lines, so only every DSPLIB_METRICS_WRITE_STEP'th
+//       boundary goes out (four to a power of two), from the one below the smallest value so far to the one above
+//       the largest.  The boundaries are the same from one request to the next, there are just more of them once
+//       there's a wider spread of values.
+// ---------------------------------------------------------------------------------------------------------------------
+
+static void WriteLabels (FILE *File, const char *Labels, const char *Extra)
+{
+  if ((Labels [0] == '\0') && (Extra == NULL)) {
+    return;
+  }
+
+  fprintf (File, "{%s%s%s}", Labels, ((Labels [0] != '\0') && (Extra != NULL)) ? "," : "", (Extra != NULL) ? Extra : "");
+}
+
+void DSPlibMetrics::Write (FILE *File)
+{
+  static const char *TypeNames [] = { "counter", "gauge", "histogram" };
+  long Buckets [DSPLIB_METRICS_BUCKETS + 1];
+  char Bound [64];
+  int First, Last;
+  long Total;
+  bool Seen;
+
+  for (int Family = 0; Family < this->MetricCount; Family++) {
+    DSPlibMetricType *Head = this->Metrics [Family];
+
+    // Families come out where their first metric was added
+    Seen = false;
+
+    for (int Metric = 0; (Metric < Family) && !Seen; Metric++) {
+      Seen = (strcmp (this->Metrics [Metric]->Name, Head->Name) == 0);
+    }
+
+    if (Seen) {
+      continue;
+    }
+
+    fprintf (File, "# HELP %s %s\n", Head->Name, Head->Help);
+    fprintf (File, "# TYPE %s %s\n", Head->Name, TypeNames [Head->Type]);
+
+    for (int Metric = Family; Metric < this->MetricCount; Metric++) {
+      DSPlibMetricType *This = this->Metrics [Metric];
+
+      if (strcmp (This->Name, Head->Name) != 0) {
+	continue;
+      }
+
+      if (This->Type != DSPLIB_METRICS_HISTOGRAM) {
+	fprintf (File, "%s", This->Name);
+	WriteLabels (File, This->Labels, NULL);
+
+	if (This->Type == DSPLIB_METRICS_COUNTER) {
+	  fprintf (File, " %ld\n", this->GetCount (Metric));
+	}
+	else {
+	  fprintf (File, " %.17g\n", this->GetValue (Metric));
+	}
+
+	continue;
+      }
+
+      this->Gather (Metric, Buckets, DSPLIB_METRICS_BUCKETS + 1);
+
+      for (First = 0; (First < DSPLIB_METRICS_BUCKETS) && (Buckets [First] == 0); First++);
+      for (Last = DSPLIB_METRICS_BUCKETS - 1; (Last >= 0) && (Buckets [Last] == 0); Last--);
+
+      // Round out to the boundaries that get written
+      First = (First / DSPLIB_METRICS_WRITE_STEP) * DSPLIB_METRICS_WRITE_STEP;
+      Last  = (Last / DSPLIB_METRICS_WRITE_STEP + 1) * DSPLIB_METRICS_WRITE_STEP - 1;
+      Total = 0;
+
+      for (int Bucket = 0; Bucket < DSPLIB_METRICS_BUCKETS; Bucket++) {
+	Total += Buckets [Bucket];
+
+	if ((Bucket < First) || (Bucket > Last) || (((Bucket + 1) % DSPLIB_METRICS_WRITE_STEP) != 0)) {
+	  continue;
+	}
+
+	snprintf (Bound, sizeof (Bound), "le=\"%.6g\"", (double) GetHighest (Bucket) * This->Scale);
+
+	fprintf (File, "%s_bucket", This->Name);
+	WriteLabels (File, This->Labels, Bound);
+	fprintf (File, " %ld\n", Total);
+      }
+
+      fprintf (File, "%s_bucket", This->Name);
+      WriteLabels (File, This->Labels, "le=\"+Inf\"");
+      fprintf (File, " %ld\n", Total);
+
+      fprintf (File, "%s_sum", This->Name);
+      WriteLabels (File, This->Labels, NULL);
+      fprintf (File, " %.17g\n", (double) Buckets [DSPLIB_METRICS_BUCKETS] * This->Scale);
+
+      fprintf (File, "%s_count", This->Name);
+      WriteLabels (File, This->Labels, NULL);
+      fprintf (File, " %ld\n", Total);
+    }
+  }
+}
+
+long DSPlibMetrics::GetTime ()
+{
+  struct timespec Time;
+
+  clock_gettime (CLOCK_MONOTONIC, &Time);
+
+  return (long) Time.tv_sec * 1000000000L + (long) Time.tv_nsec;
+}
+
+// Serving the metrics -------------------------------------------------------------------------------------------------
+//   Description:
+//     A port number listens on 127.0.0.1 only, so nothing off the machine can ask.  Anything else is the name of a
+//       Unix socket, which is what to use when the machine's other users shouldn't be able to either.
+//
+//     Every connection gets one answer and is closed: the metrics for a GET of / or /metrics, 404 for any other path,
+//       and the metrics anyway if nothing that looks like a request turns up within DSPLIB_METRICS_REQUEST_MS (so
+//       "socat - UNIX-CONNECT:name" works as well as curl).
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool DSPlibMetrics::Serve (const char *Address)
+{
+  DSPlibMetricsServerType *Server;
+  struct sockaddr_in Internet;
+  struct sockaddr_un Local;
+  struct stat Status;
+  const char *Digit;
+  int Yes = 1;
+
+  if (this->Server != NULL) {
+    return false;
+  }
+
+  for (Digit = Address; (*Digit >= '0') && (*Digit <= '9'); Digit++);
+
+  Server = new DSPlibMetricsServerType;
+  Server->SocketName = NULL;
+  Server->Wake [0]   = -1;
+  Server->Wake [1]   = -1;
+
+  if ((*Digit == '\0') && (Digit != Address)) {
+    memset (&Internet, 0, sizeof (Internet));
+
+    Internet.sin_family      = AF_INET;
+    Internet.sin_port        = htons (atoi (Address));
+    Internet.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+    Server->Listener = socket (AF_INET, SOCK_STREAM, 0);
+
+    if (Server->Listener >= 0) {
+      setsockopt (Server->Listener, SOL_SOCKET, SO_REUSEADDR, &Yes, sizeof (Yes));
+
+      if (bind (Server->Listener, (struct sockaddr *) &Internet, sizeof (Internet)) != 0) {
+	close (Server->Listener);
+	Server->Listener = -1;
+      }
+    }
+  }
+  else {
+    memset (&Local, 0, sizeof (Local));
+
+    Local.sun_family = AF_UNIX;
+
+    // Only a socket someone left behind gets replaced
+    if ((strlen (Address) >= sizeof (Local.sun_path)) ||
+	((lstat (Address, &Status) == 0) && (!S_ISSOCK (Status.st_mode) || (unlink (Address) != 0)))) {
+      Server->Listener = -1;
+    }
+    else {
+      strcpy (Local.sun_path, Address);
+
+      Server->Listener = socket (AF_UNIX, SOCK_STREAM, 0);
+
+      if ((Server->Listener >= 0) && (bind (Server->Listener, (struct sockaddr *) &Local, sizeof (Local)) != 0)) {
+	close (Server->Listener);
+	Server->Listener = -1;
+      }
+
+      if (Server->Listener >= 0) {
+	Server->SocketName = CopyString (Address);
+      }
+    }
+  }
+
+  if ((Server->Listener < 0) || (listen (Server->Listener, 16) != 0) || (pipe (Server->Wake) != 0)) {
+    if (Server->Listener >= 0) {
+      close (Server->Listener);
+    }
+
+    if (Server->SocketName != NULL) {
+      unlink (Server->SocketName);
+      delete [] Server->SocketName;
+    }
+
+    delete Server;
+    return false;
+  }
+
+  this->Server = Server;
+
+  if (pthread_create (&Server->Thread, NULL, RunServer, this) != 0) {
+    this->Server = NULL;
+
+    close (Server->Listener);
+    close (Server->Wake [0]);
+    close (Server->Wake [1]);
+
+    if (Server->SocketName != NULL) {
+      unlink (Server->SocketName);
+      delete [] Server->SocketName;
+    }
+
+    delete Server;
+    return false;
+  }
+
+  pthread_setname_np (Server->Thread, "metrics");
+
+  return true;
+}
+
+void DSPlibMetrics::StopServing ()
+{
+  DSPlibMetricsServerType *Server = this->Server;
+  char Wake = 0;
+
+  if (Server == NULL) {
+    return;
+  }
+
+  if (write (Server->Wake [1], &Wake, 1) != 1) {
+    pthread_cancel (Server->Thread);
+  }
+
+  pthread_join (Server->Thread, NULL);
+
+  close (Server->Listener);
+  close (Server->Wake [0]);
+  close (Server->Wake [1]);
+
+  if (Server->SocketName != NULL) {
+    unlink (Server->SocketName);
+    delete [] Server->SocketName;
+  }
+
+  delete Server;
+  this->Server = NULL;
+}
+
+void *DSPlibMetrics::RunServer (void *Argument)
+{
+  DSPlibMetrics *This = (DSPlibMetrics *) Argument;
+  struct pollfd Waiting [2];
+  int Connection;
+
+  Waiting [0].fd     = This->Server->Listener;
+  Waiting [0].events = POLLIN;
+  Waiting [1].fd     = This->Server->Wake [0];
+  Waiting [1].events = POLLIN;
+
+  for (;;) {
+    if (poll (Waiting, 2, -1) < 0) {
+      continue;
+    }
+
+    if (Waiting [1].revents != 0) {
+      break;
+    }
+
+    if ((Waiting [0].revents & POLLIN) && ((Connection = accept (This->Server->Listener, NULL, NULL)) >= 0)) {
+      This->Answer (Connection);
+      close (Connection);
+    }
+  }
+
+  return NULL;
+}
+
+void DSPlibMetrics::Answer (int Connection)
+{
+  char Request [DSPLIB_METRICS_REQUEST_BYTES + 1], Header [256];
+  struct pollfd Waiting;
+  long Length = 0, Sent, Count;
+  char *Body = NULL, *Path, *Reply;
+  size_t BodyLength = 0;
+  bool Found = true;
+  FILE *File;
+
+  // Read the request line and headers, up to the blank line after them
+  Waiting.fd     = Connection;
+  Waiting.events = POLLIN;
+
+  while ((Length < DSPLIB_METRICS_REQUEST_BYTES) && (poll (&Waiting, 1, DSPLIB_METRICS_REQUEST_MS) > 0)) {
+    if ((Count = read (Connection, &Request [Length], DSPLIB_METRICS_REQUEST_BYTES - Length)) <= 0) {
+      break;
+    }
+
+    Length += Count;
+    Request [Length] = '\0';
+
+    if (strstr (Request, "\r\n\r\n") != NULL) {
+      break;
+    }
+  }
+
+  Request [Length] = '\0';
+
+  if (strncmp (Request, "GET ", 4) == 0) {
+    Path  = &Request [4];
+    Found = ((strncmp (Path, "/ ", 2) == 0) || (strncmp (Path, "/metrics ", 9) == 0) ||
+	     (strncmp (Path, "/metrics?", 9) == 0) || (strncmp (Path, "/?", 2) == 0));
+  }
+
+  if (Found) {
+    if ((File = open_memstream (&Body, &BodyLength)) == NULL) {
+      return;
+    }
+
+    this->Write (File);
+    fclose (File);
+
+    snprintf (Header, sizeof (Header), "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+	      "Content-Length: %lu\r\nConnection: close\r\n\r\n", (unsigned long) BodyLength);
+  }
+  else {
+    snprintf (Header, sizeof (Header), "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+  }
+
+  // Whoever asked might have gone already, which mustn't take the whole program down with a SIGPIPE
+  for (int Part = 0; Part < 2; Part++) {
+    Reply  = (Part == 0) ? Header : Body;
+    Length = (Part == 0) ? (long) strlen (Header) : (long) BodyLength;
+
+    for (Sent = 0; (Reply != NULL) && (Sent < Length); Sent += Count) {
+      if ((Count = send (Connection, &Reply [Sent], Length - Sent, MSG_NOSIGNAL)) <= 0) {
+	break;
+      }
+    }
+  }
+
+  free (Body);
+}
@@ -0,0 +1,166 @@
+// DSPlibMetrics.h
+//
+// An extension to DSPlib to keep count of what a long running program is
+// doing (samples read, windows looked at, how long things took) and let
+// anything that can read Prometheus' text format watch it while it runs.
+//
+// A registry holds counters, gauges and histograms, each with a name, its
+// labels (already in Prometheus' form, say "protocol=\"dtmf\"") and a line
+// of help.  Metrics with the same name and different labels are one family.
+//
+// Counting has to be cheap enough to do every block without thinking about
+// it, so every thread that counts gets its own copy of every counter and
+// histogram, made the first time it counts anything and lined up on a cache
+// line.  Add and Observe are a load and a store to memory nothing else
+// writes to: no locks and no locked instructions, so the threads never wait
+// on each other or pass cache lines back and forth.  Whatever reads the
+// metrics adds up every thread's copy.  Only the first
+// DSPLIB_METRICS_MAX_THREADS - 1 threads get one of their own; the rest share
+// the last one, which they add to with atomic instructions instead.
+//
+// The histograms are HDR style.  Values are whole numbers (nanoseconds,
+// say) and land in buckets DSPLIB_METRICS_SUB_BUCKETS to a power of two, so
+// every value is kept to within 1 / DSPLIB_METRICS_SUB_BUCKETS of itself
+// from one up to the largest long there is, and the values below
+// 2 * DSPLIB_METRICS_SUB_BUCKETS are kept exactly.  Scale turns them into
+// the histogram's unit (1e-9 for nanoseconds counted in seconds) when
+// they're written out.
+//
+// Serve answers HTTP requests for the metrics on a loopback port or a Unix
+// socket, on a thread of its own ("metrics" in top -H).
+
+// The most metrics in one registry, and the most threads that get copies of their own
+#define		DSPLIB_METRICS_MAX_METRICS	64
+#define		DSPLIB_METRICS_MAX_THREADS	64
+
+// A histogram's buckets per power of two (a power of two itself), how many of them go between each bucket boundary
+// that gets written out, and how many buckets it takes to cover every long
+#define		DSPLIB_METRICS_SUB_BITS		4
+#define		DSPLIB_METRICS_SUB_BUCKETS	(1 << DSPLIB_METRICS_SUB_BITS)
+#define		DSPLIB_METRICS_WRITE_STEP	4
+#define		DSPLIB_METRICS_BUCKETS		((64 - DSPLIB_METRICS_SUB_BITS) * DSPLIB_METRICS_SUB_BUCKETS)
+
+// The kinds of metric
+#define		DSPLIB_METRICS_COUNTER		0
+#define		DSPLIB_METRICS_GAUGE		1
+#define		DSPLIB_METRICS_HISTOGRAM	2
+
+// The calling thread's place in every registry's copies (1 up, 0 until it first counts something)
+extern __thread int DSPlibMetricsThread;
+
+typedef struct DSPlibMetricType DSPlibMetricType;
+typedef struct DSPlibMetricsServerType DSPlibMetricsServerType;
+
+class DSPlibMetrics {
+  public:
+    // Basic constructor.  Makes an empty registry.
+    DSPlibMetrics ();
+
+    // Destructor (stops serving if it still is)
+    ~DSPlibMetrics ();
+
+    // Add a metric.  Returns its number, or -1 if the registry is full.
+    // Every metric has to be added before anything is counted.
+    int AddCounter   (const char *Name, const char *Labels, const char *Help);
+    int AddGauge     (const char *Name, const char *Labels, const char *Help);
+    int AddHistogram (const char *Name, const char *Labels, const char *Help, double Scale);
+
+    // Add Value to a counter, set a gauge, or put Value in a histogram.
+    inline void Add (int Metric, long Value) {
+      Bump (&this->GetCopy () [this->Offsets [Metric]], Value);
+    }
+
+    inline void Set (int Metric, double Value) {
+      union { double Value; long Bits; } Gauge;
+
+      Gauge.Value = Value;
+      __atomic_store_n (&this->Gauges [Metric], Gauge.Bits, __ATOMIC_RELAXED);
+    }
+
+    inline void Observe (int Metric, long Value) {
+      long *Buckets = &this->GetCopy () [this->Offsets [Metric]];
+
+      Bump (&Buckets [GetBucket (Value)], 1);
+      Bump (&Buckets [DSPLIB_METRICS_BUCKETS], Value);
+    }
+
+    // A counter's total (or how many values a histogram has had), a gauge's
+    // value (or a histogram's sum, scaled), and the value (scaled) a
+    // histogram's values are at or below Quantile of the time, to within a
+    // bucket.
+    long   GetCount    (int Metric);
+    double GetValue    (int Metric);
+    double GetQuantile (int Metric, double Quantile);
+
+    // Write every metric in Prometheus' text format.
+    void Write (FILE *File);
+
+    // Answer requests for the metrics at Address: a port number on the
+    // loopback address, or the name of a Unix socket (which replaces a
+    // socket that's already there, but nothing else).  Returns false if it
+    // couldn't.
+    bool Serve (const char *Address);
+    void StopServing ();
+
+    // The time on the monotonic clock in nanoseconds, for timing what goes
+    // in a histogram.
+    static long GetTime ();
+
+  private:
+    DSPlibMetricType *Metrics [DSPLIB_METRICS_MAX_METRICS];
+    int               MetricCount;
+    int               Offsets [DSPLIB_METRICS_MAX_METRICS];
+    long              Gauges  [DSPLIB_METRICS_MAX_METRICS];
+
+    // Every thread's copy of the counters and histograms (NULL until it counts something), and how many longs one is
+    long *Copies [DSPLIB_METRICS_MAX_THREADS];
+    long  CopySize;
+
+    DSPlibMetricsServerType *Server;
+
+    // The calling thread's copy
+    inline long *GetCopy () {
+      long *Copy;
+
+      if ((DSPlibMetricsThread > 0) && ((Copy = this->Copies [DSPlibMetricsThread - 1]) != NULL)) {
+	return Copy;
+      }
+
+      return this->CreateCopy ();
+    }
+
+    long *CreateCopy ();
+
+    // Add to a thread's copy.  The shared copy is the only one that can have more than one thread writing to it.
+    static inline void Bump (long *Count, long Value) {
+      if (DSPlibMetricsThread < DSPLIB_METRICS_MAX_THREADS) {
+	__atomic_store_n (Count, __atomic_load_n (Count, __ATOMIC_RELAXED) + Value, __ATOMIC_RELAXED);
+      }
+      else {
+	__atomic_fetch_add (Count, Value, __ATOMIC_RELAXED);
+      }
+    }
+
+    // The bucket a value goes in, and the smallest and largest values that go in a bucket
+    static inline int GetBucket (long Value) {
+      int Shift;
+
+      if (Value < (2 * DSPLIB_METRICS_SUB_BUCKETS)) {
+	return (Value > 0) ? (int) Value : 0;
+      }
+
+      Shift = 63 - __builtin_clzl (Value) - DSPLIB_METRICS_SUB_BITS;
+
+      return Shift * DSPLIB_METRICS_SUB_BUCKETS + (int) (Value >> Shift);
+    }
+
+    static long GetLowest  (int Bucket);
+    static long GetHighest (int Bucket);
+
+    // Add up every thread's copy of a metric
+    void Gather (int Metric, long *Counts, int Length);
+
+    // The thread that answers the requests
+    static void *RunServer (void *Metrics);
+    void Answer (int Connection);
+};
@@ -0,0 +1,328 @@
+// <BEHOLD the GPL!>
+// ntheory's DSPlibOscillator, a bank of sine wave generators to complement DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+// </BEHOLD>
+
+#include <rfftw.h>
+#include <string.h>
+#include <math.h>
+#include "DSPlibOscillator.h"
+#include "DSPlibSIMD.h"
+
+#define		DSPLIB_TWO_PI			6.28318530717958647693
+
+// Run the lanes of one tone ------------------------------------------------------------------------------------------
+//   Description:
+//     Lane "Lane" holds the phasor for samples Lane, Lane + LANES, Lane + 2 * LANES, etc.  Every pass writes one
+//       sample from each lane and then rotates all of them by LANES samples' worth of phase.
+//
+//   Notes:
+//     Width is how many doubles fit in a register.  The lanes are kept in LANES / Width of GCC's vector types and
+//       the whole thing gets built once per instruction set below, then picked with DSPlibGetISA like the array
+//       kernels.  It's always inlined into those so it gets compiled for their instruction set.
+// --------------------------------------------------------------------------------------------------------------------
+
+template <int Width>
+static inline __attribute__ ((always_inline)) void RunLanes (double *StartRe, double *StartIm, double StepRe, double StepIm,
+							    double Amplitude, fftw_real *Out, int Length, bool Add)
+{
+  typedef double VectorType __attribute__ ((vector_size (Width * sizeof (double))));
+
+  const int Count = DSPLIB_OSCILLATOR_LANES / Width;
+  VectorType Re [Count], Im [Count], NextRe, Samples;
+  double Lanes [DSPLIB_OSCILLATOR_LANES];
+  int Loop = 0;
+
+  memcpy (Re, StartRe, sizeof (Re));
+  memcpy (Im, StartIm, sizeof (Im));
+
+  for (; Loop + DSPLIB_OSCILLATOR_LANES <= Length; Loop += DSPLIB_OSCILLATOR_LANES) {
+    for (int Vector = 0; Vector < Count; Vector++) {
+      Samples = Im [Vector] * Amplitude;
+
+#ifdef FFTW_ENABLE_FLOAT
+      for (int Lane = 0; Lane < Width; Lane++) {
+	if (Add) Out [Loop + Vector * Width + Lane] += (fftw_real) Samples [Lane];
+	else     Out [Loop + Vector * Width + Lane]  = (fftw_real) Samples [Lane];
+      }
+#else
+      if (Add) {
+	VectorType Previous;
+
+	memcpy (&Previous, &Out [Loop + Vector * Width], sizeof (Previous));
+	Samples += Previous;
+      }
+
+      memcpy (&Out [Loop + Vector * Width], &Samples, sizeof (Samples));
+#endif
+
+      NextRe      = Re [Vector] * StepRe - Im [Vector] * StepIm;
+      Im [Vector] = Re [Vector] * StepIm + Im [Vector] * StepRe;
+      Re [Vector] = NextRe;
+    }
+  }
+
+  // Whatever is left is less than one row
+  memcpy (Lanes, Im, sizeof (Lanes));
+
+  for (int Lane = 0; Loop + Lane < Length; Lane++) {
+    if (Add) Out [Loop + Lane] += Amplitude * Lanes [Lane];
+    else     Out [Loop + Lane]  = Amplitude * Lanes [Lane];
+  }
+}
+
+typedef void (*RunLanesType) (double *StartRe, double *StartIm, double StepRe, double StepIm, double Amplitude,
+			      fftw_real *Out, int Length, bool Add);
+
+static void RunLanesScalar (double *StartRe, double *StartIm, double StepRe, double StepIm, double Amplitude,
+			    fftw_real *Out, int Length, bool Add)
+{
+  RunLanes <1> (StartRe, StartIm, StepRe, StepIm, Amplitude, Out, Length, Add);
+}
+
+#if defined (__x86_64__) || defined (__i386__)
+
+__attribute__ ((target ("sse2")))
+static void RunLanesSSE2 (double *StartRe, double *StartIm, double StepRe, double StepIm, double Amplitude,
+			  fftw_real *Out, int Length, bool Add)
+{
+  RunLanes <2> (StartRe, StartIm, StepRe, StepIm, Amplitude, Out, Length, Add);
+}
+
+__attribute__ ((target ("avx2")))
+static void RunLanesAVX2 (double *StartRe, double *StartIm, double StepRe, double StepIm, double Amplitude,
+			  fftw_real *Out, int Length, bool Add)
+{
+  RunLanes <4> (StartRe, StartIm, StepRe, StepIm, Amplitude, Out, Length, Add);
+}
+
+__attribute__ ((target ("avx512f")))
+static void RunLanesAVX512 (double *StartRe, double *StartIm, double StepRe, double StepIm, double Amplitude,
+			    fftw_real *Out, int Length, bool Add)
+{
+  RunLanes <8> (StartRe, StartIm, StepRe, StepIm, Amplitude, Out, Length, Add);
+}
+
+static RunLanesType RunLanesKernels [DSPLIB_ISA_COUNT] = { RunLanesScalar, RunLanesSSE2, RunLanesAVX2, RunLanesAVX512 };
+
+#else
+
+static RunLanesType RunLanesKernels [DSPLIB_ISA_COUNT] = { RunLanesScalar, RunLanesScalar, RunLanesScalar, RunLanesScalar };
+
+#endif
+
+// Basic constructor
+DSPlibOscillatorBank::DSPlibOscillatorBank (int ToneCount, double *Frequencies, double *Amplitudes, double *Phases,
+					    int SamplingRate)
+{
+  this->ToneCount    = ToneCount;
+  this->SamplingRate = SamplingRate;
+
+  this->Frequencies = new double [ToneCount];
+  this->Amplitudes  = new double [ToneCount];
+  this->StartCycles = new double [ToneCount];
+  this->Cycles      = new double [ToneCount];
+  this->CyclesLow   = new double [ToneCount];
+
+  this->Increment    = new double [ToneCount];
+  this->IncrementLow = new double [ToneCount];
+
+  this->LaneRe = new double [ToneCount * DSPLIB_OSCILLATOR_LANES];
+  this->LaneIm = new double [ToneCount * DSPLIB_OSCILLATOR_LANES];
+  this->StepRe = new double [ToneCount];
+  this->StepIm = new double [ToneCount];
+
+  for (int Tone = 0; Tone < ToneCount; Tone++) {
+    this->Frequencies [Tone] = Frequencies [Tone];
+    this->Amplitudes  [Tone] = (Amplitudes == NULL) ? 1.0 : Amplitudes [Tone];
+
+    // Keep the phase in cycles so it can be wrapped exactly
+    this->StartCycles [Tone] = (Phases == NULL) ? 0.0 : Phases [Tone] / 360.0;
+    this->StartCycles [Tone] -= floor (this->StartCycles [Tone]);
+
+    this->SetupTone (Tone);
+  }
+
+  this->Reset ();
+}
+
+DSPlibOscillatorBank::~DSPlibOscillatorBank ()
+{
+  delete [] this->Frequencies;
+  delete [] this->Amplitudes;
+  delete [] this->StartCycles;
+  delete [] this->Cycles;
+  delete [] this->CyclesLow;
+
+  delete [] this->Increment;
+  delete [] this->IncrementLow;
+
+  delete [] this->LaneRe;
+  delete [] this->LaneIm;
+  delete [] this->StepRe;
+  delete [] this->StepIm;
+}
+
+// ----------------------------------------------------------------------------
+// Generation functions:
+//   - Generate
+//   - GenerateMix
+//
+// ----------------------------------------------------------------------------
+
+void DSPlibOscillatorBank::Generate (fftw_real **Out, int Length)
+{
+  int Done = 0, Block;
+
+  while (Done < Length) {
+    Block = Length - Done;
+    if (Block > DSPLIB_OSCILLATOR_BLOCK) Block = DSPLIB_OSCILLATOR_BLOCK;
+
+    for (int Tone = 0; Tone < this->ToneCount; Tone++) {
+      this->Run (Tone, &Out [Tone][Done], Block, false);
+    }
+
+    this->Advance (Block);
+    Done += Block;
+  }
+}
+
+void DSPlibOscillatorBank::GenerateMix (fftw_real *Out, int Length)
+{
+  int Done = 0, Block;
+
+  while (Done < Length) {
+    Block = Length - Done;
+    if (Block > DSPLIB_OSCILLATOR_BLOCK) Block = DSPLIB_OSCILLATOR_BLOCK;
+
+    // The first tone sets the block and the rest are added on top
+    for (int Tone = 0; Tone < this->ToneCount; Tone++) {
+      this->Run (Tone, &Out [Done], Block, Tone > 0);
+    }
+
+    if (this->ToneCount == 0) {
+      memset (&Out [Done], 0, Block * sizeof (fftw_real));
+    }
+
+    this->Advance (Block);
+    Done += Block;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Tone control functions:
+//   - SetTone
+//   - Reset
+//   - GetPosition
+//
+// ----------------------------------------------------------------------------
+
+void DSPlibOscillatorBank::SetTone (int Tone, double Frequency, double Amplitude)
+{
+  this->Frequencies [Tone] = Frequency;
+  this->Amplitudes  [Tone] = Amplitude;
+
+  this->SetupTone (Tone);
+}
+
+void DSPlibOscillatorBank::Reset ()
+{
+  memcpy (this->Cycles, this->StartCycles, this->ToneCount * sizeof (double));
+  memset (this->CyclesLow, 0, this->ToneCount * sizeof (double));
+
+  this->Position = 0;
+}
+
+long DSPlibOscillatorBank::GetPosition ()
+{
+  return this->Position;
+}
+
+// ----------------------------------------------------------------------------
+// Internal functions:
+//   - SetupTone
+//   - Run
+//   - Advance
+//
+// ----------------------------------------------------------------------------
+
+void DSPlibOscillatorBank::SetupTone (int Tone)
+{
+  double Omega = DSPLIB_TWO_PI * this->Frequencies [Tone] / (double) this->SamplingRate;
+
+  // The fma gives us exactly what the division rounded off, so the pair is good to about twice double precision
+  this->Increment    [Tone] = this->Frequencies [Tone] / (double) this->SamplingRate;
+  this->IncrementLow [Tone] = fma (-this->Increment [Tone], (double) this->SamplingRate, this->Frequencies [Tone]) /
+			      (double) this->SamplingRate;
+
+  // The offset of each lane from the first sample of a row, straight from libm so they're as good as they get
+  for (int Lane = 0; Lane < DSPLIB_OSCILLATOR_LANES; Lane++) {
+    this->LaneRe [Tone * DSPLIB_OSCILLATOR_LANES + Lane] = cos (Omega * Lane);
+    this->LaneIm [Tone * DSPLIB_OSCILLATOR_LANES + Lane] = sin (Omega * Lane);
+  }
+
+  // And the rotation from one row to the next
+  this->StepRe [Tone] = cos (Omega * DSPLIB_OSCILLATOR_LANES);
+  this->StepIm [Tone] = sin (Omega * DSPLIB_OSCILLATOR_LANES);
+}
+
+void DSPlibOscillatorBank::Run (int Tone, fftw_real *Out, int Length, bool Add)
+{
+  double Re [DSPLIB_OSCILLATOR_LANES], Im [DSPLIB_OSCILLATOR_LANES];
+  double *OffsetRe = &this->LaneRe [Tone * DSPLIB_OSCILLATOR_LANES];
+  double *OffsetIm = &this->LaneIm [Tone * DSPLIB_OSCILLATOR_LANES];
+  double Theta = DSPLIB_TWO_PI * (this->Cycles [Tone] + this->CyclesLow [Tone]);
+  double BaseRe = cos (Theta), BaseIm = sin (Theta);
+
+  // Reseed every lane from the exact phase at the start of this block
+  for (int Lane = 0; Lane < DSPLIB_OSCILLATOR_LANES; Lane++) {
+    Re [Lane] = BaseRe * OffsetRe [Lane] - BaseIm * OffsetIm [Lane];
+    Im [Lane] = BaseRe * OffsetIm [Lane] + BaseIm * OffsetRe [Lane];
+  }
+
+  RunLanesKernels [DSPlibGetISA ()] (Re, Im, this->StepRe [Tone], this->StepIm [Tone], this->Amplitudes [Tone], Out, Length, Add);
+}
+
+void DSPlibOscillatorBank::Advance (int Length)
+{
+  double High, Low, Sum, Error, Whole;
+
+  // Move the phases along in cycles and throw away the whole ones.  Everything is done in high/low pairs (the usual
+  // "two sum" trick) because a plain double loses a little of the step every block, always in the same direction,
+  // and after a few hours of samples that adds up to a visible phase error.
+  for (int Tone = 0; Tone < this->ToneCount; Tone++) {
+    // The step, Increment * Length, with the product's rounding error folded into the low part
+    High = this->Increment [Tone] * (double) Length;
+    Low  = fma (this->Increment [Tone], (double) Length, -High) + this->IncrementLow [Tone] * (double) Length;
+
+    // Add the step's high part to the phase and keep what the add rounded off
+    Sum   = this->Cycles [Tone] + High;
+    Error = Sum - this->Cycles [Tone];
+    Error = (this->Cycles [Tone] - (Sum - Error)) + (High - Error);
+
+    Low += Error + this->CyclesLow [Tone];
+
+    // Put it back together, then drop the whole cycles (taking off the integer part of a double is exact)
+    this->Cycles    [Tone] = Sum + Low;
+    this->CyclesLow [Tone] = Low - (this->Cycles [Tone] - Sum);
+
+    Whole = floor (this->Cycles [Tone]);
+    this->Cycles [Tone] -= Whole;
+  }
+
+  this->Position += Length;
+}
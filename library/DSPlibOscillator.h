@@ -0,0 +1,73 @@
+// DSPlibOscillator.h
+//
+// An extension to DSPlib to generate a bank of sine waves at once without
+// calling sin () for every sample.
+//
+// Each tone is a complex phasor that gets rotated by a fixed amount every
+// sample.  The samples are worked on in DSPLIB_OSCILLATOR_LANES interleaved
+// lanes so the rotations vectorize, and the phasors are reseeded from an
+// exact phase every DSPLIB_OSCILLATOR_BLOCK samples so rounding error never
+// gets the chance to build up (no matter how long the table is).
+
+// The number of samples each tone works on side by side.
+#define		DSPLIB_OSCILLATOR_LANES		8
+
+// How many samples we run the recurrence for before reseeding it.
+#define		DSPLIB_OSCILLATOR_BLOCK		256
+
+class DSPlibOscillatorBank {
+  public:
+    // Basic constructor.  Phases are in degrees like GenerateSine.  Amplitudes
+    // and Phases can be NULL for all ones and all zeros.
+    DSPlibOscillatorBank (int ToneCount, double *Frequencies, double *Amplitudes, double *Phases, int SamplingRate);
+
+    // Destructor
+    ~DSPlibOscillatorBank ();
+
+    // Generate the next Length samples of every tone.  Generate puts each
+    // tone in its own array (Out [Tone]), GenerateMix adds them all up into
+    // one.  Calling these again carries on where the last call left off.
+    void Generate    (fftw_real **Out, int Length);
+    void GenerateMix (fftw_real *Out, int Length);
+
+    // Change a tone's frequency or amplitude.  The phase carries on from
+    // wherever it is so there's no click.
+    void SetTone (int Tone, double Frequency, double Amplitude);
+
+    // Go back to sample zero and the starting phases.
+    void Reset ();
+
+    // How many samples have been generated so far.
+    long GetPosition ();
+
+  private:
+    int ToneCount;
+    int SamplingRate;
+
+    double *Frequencies;
+    double *Amplitudes;
+    double *StartCycles;
+
+    // Frequency / SamplingRate for each tone, split into a high and a low part
+    // so the low bits the division rounds off aren't lost.
+    double *Increment, *IncrementLow;
+
+    // The phase (in cycles, 0 to 1) of each tone at the current position,
+    // also kept as a high and a low part so it never drifts.
+    double *Cycles, *CyclesLow;
+
+    // The rotation for one sample in each lane, and for a whole row of lanes.
+    double *LaneRe, *LaneIm;
+    double *StepRe, *StepIm;
+
+    long Position;
+
+    // Work out the rotations for a tone.
+    void SetupTone (int Tone);
+
+    // Run one tone for up to DSPLIB_OSCILLATOR_BLOCK samples.
+    void Run (int Tone, fftw_real *Out, int Length, bool Add);
+
+    // Move every tone's phase along by Length samples.
+    void Advance (int Length);
+};
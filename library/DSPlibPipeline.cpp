@@ -0,0 +1,490 @@
+// <BEHOLD the GPL!>
+// ntheory's DSPlibPipeline, pull driven processing stages to complement DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include "DSPlib.h"
+#include "DSPlibSIMD.h"
+#include "DSPlibPipeline.h"
+
+// How much input the decimator keeps on top of its filter
+#define		DSPLIB_DECIMATOR_BUFFER		8192
+
+// A stage, and the queue after it if it has one.  Its thread fills the queue's blocks in turn: block n % Count once
+// the one that was in it has been released.  Filled, Taken and Released count blocks from the start, so the queue is
+// full when Filled - Released is Count (the block the next stage has is still in use) and empty when Taken is Filled.
+struct DSPlibStageType {
+  const char          *Name;
+  DSPlibStageFunction  Function;
+  void                *State;
+  long                 ItemSize, Capacity;
+
+  DSPlibBlockType      Block;
+  DSPlibStageStatsType Stats;
+  double               Pulled;							// Time the current call spent in Pull
+
+  int                  Count;							// Blocks in the queue (0 when there isn't one)
+  DSPlibBlockType     *Queue;
+  long                 Filled, Taken, Released;
+  bool                 Held, Ended, Stopping, Running;
+
+  DSPlibPipeline      *Pipeline;
+  int                  Number;
+  pthread_t            Thread;
+  pthread_mutex_t      Lock;
+  pthread_cond_t       Ready, Room;
+};
+
+static double Now ()
+{
+  struct timespec Time;
+
+  clock_gettime (CLOCK_MONOTONIC, &Time);
+
+  return (double) Time.tv_sec + (double) Time.tv_nsec / 1e9;
+}
+
+static void CreateBlock (DSPlibBlockType *Block, long ItemSize, long Capacity)
+{
+  Block->Data     = NULL;
+  Block->Capacity = Capacity;
+  Block->Length   = 0;
+  Block->Position = 0;
+
+  if ((ItemSize * Capacity) > 0) {
+    if (posix_memalign (&Block->Data, DSPLIB_PIPELINE_ALIGNMENT, ItemSize * Capacity) != 0) {
+      printf ("Couldn't allocate a pipeline block.\n");
+      exit (0);
+    }
+
+    memset (Block->Data, 0, ItemSize * Capacity);
+  }
+}
+
+// Basic constructor
+DSPlibPipeline::DSPlibPipeline ()
+{
+  this->StageCount = 0;
+}
+
+DSPlibPipeline::~DSPlibPipeline ()
+{
+  this->Stop ();
+
+  for (int Stage = 0; Stage < this->StageCount; Stage++) {
+    DSPlibStageType *This = this->Stages [Stage];
+
+    free (This->Block.Data);
+
+    for (int Block = 0; Block < This->Count; Block++) {
+      free (This->Queue [Block].Data);
+    }
+
+    delete [] This->Queue;
+
+    pthread_mutex_destroy (&This->Lock);
+    pthread_cond_destroy  (&This->Ready);
+    pthread_cond_destroy  (&This->Room);
+
+    delete This;
+  }
+}
+
+int DSPlibPipeline::AddStage (const char *Name, DSPlibStageFunction Function, void *State, long ItemSize, long Capacity)
+{
+  DSPlibStageType *This;
+
+  if (this->StageCount == DSPLIB_PIPELINE_MAX_STAGES) {
+    printf ("Too many pipeline stages.\n");
+    exit (0);
+  }
+
+  This = new DSPlibStageType;
+  memset (&This->Stats, 0, sizeof (This->Stats));
+
+  This->Name     = Name;
+  This->Function = Function;
+  This->State    = State;
+  This->ItemSize = ItemSize;
+  This->Capacity = Capacity;
+  This->Pulled   = 0.0;
+  This->Count    = 0;
+  This->Queue    = NULL;
+  This->Filled   = 0;
+  This->Taken    = 0;
+  This->Released = 0;
+  This->Held     = false;
+  This->Ended    = false;
+  This->Stopping = false;
+  This->Running  = false;
+  This->Pipeline = this;
+  This->Number   = this->StageCount;
+
+  This->Stats.Name = Name;
+
+  CreateBlock (&This->Block, ItemSize, Capacity);
+
+  pthread_mutex_init (&This->Lock, NULL);
+  pthread_cond_init  (&This->Ready, NULL);
+  pthread_cond_init  (&This->Room, NULL);
+
+  this->Stages [this->StageCount] = This;
+
+  return this->StageCount++;
+}
+
+void DSPlibPipeline::AddQueue (int Depth)
+{
+  DSPlibStageType *This = this->Stages [this->StageCount - 1];
+
+  // Depth blocks waiting and the one the next stage is using
+  This->Count = ((Depth > 0) ? Depth : 1) + 1;
+  This->Queue = new DSPlibBlockType [This->Count];
+
+  for (int Block = 0; Block < This->Count; Block++) {
+    CreateBlock (&This->Queue [Block], This->ItemSize, This->Capacity);
+  }
+}
+
+bool DSPlibPipeline::Start ()
+{
+  char Name [16];
+
+  for (int Stage = 0; Stage < this->StageCount; Stage++) {
+    DSPlibStageType *This = this->Stages [Stage];
+
+    if (This->Count == 0) {
+      continue;
+    }
+
+    if (pthread_create (&This->Thread, NULL, RunQueue, This) != 0) {
+      return false;
+    }
+
+    This->Running = true;
+
+    // Thread names can only be 15 characters
+    snprintf (Name, sizeof (Name), "%s", This->Name);
+    pthread_setname_np (This->Thread, Name);
+  }
+
+  return true;
+}
+
+void DSPlibPipeline::Stop ()
+{
+  // Tell every thread first, since one can be waiting on the one before it
+  for (int Stage = 0; Stage < this->StageCount; Stage++) {
+    DSPlibStageType *This = this->Stages [Stage];
+
+    pthread_mutex_lock (&This->Lock);
+    This->Stopping = true;
+    pthread_cond_broadcast (&This->Ready);
+    pthread_cond_broadcast (&This->Room);
+    pthread_mutex_unlock (&This->Lock);
+  }
+
+  for (int Stage = 0; Stage < this->StageCount; Stage++) {
+    if (this->Stages [Stage]->Running) {
+      pthread_join (this->Stages [Stage]->Thread, NULL);
+      this->Stages [Stage]->Running = false;
+    }
+  }
+}
+
+bool DSPlibPipeline::Fill (int Stage, DSPlibBlockType *Out)
+{
+  DSPlibStageType *This = this->Stages [Stage];
+  double Start = Now ();
+  bool More;
+
+  Out->Length = 0;
+  More        = This->Function (this, Stage, This->State, Out);
+
+  // What it spent pulling is the earlier stages' time
+  This->Stats.Busy += (Now () - Start) - This->Pulled;
+  This->Pulled      = 0.0;
+
+  if (More) {
+    This->Stats.Blocks++;
+    This->Stats.Items += Out->Length;
+  }
+
+  return More;
+}
+
+DSPlibBlockType *DSPlibPipeline::Pull (int Stage)
+{
+  DSPlibStageType *This = this->Stages [Stage];
+  DSPlibStageType *Next = ((Stage + 1) < this->StageCount) ? this->Stages [Stage + 1] : NULL;
+  DSPlibBlockType *Block = NULL;
+  double Start = Now (), Waited;
+
+  if (This->Count == 0) {
+    Block = this->Fill (Stage, &This->Block) ? &This->Block : NULL;
+  }
+  else {
+    pthread_mutex_lock (&This->Lock);
+
+    // The block we had last time can be filled again
+    if (This->Held) {
+      This->Released++;
+      This->Held = false;
+      pthread_cond_signal (&This->Room);
+    }
+
+    while ((This->Taken == This->Filled) && !This->Ended && !This->Stopping) {
+      pthread_cond_wait (&This->Ready, &This->Lock);
+    }
+
+    if ((This->Taken < This->Filled) && !This->Stopping) {
+      Block = &This->Queue [This->Taken % This->Count];
+      This->Taken++;
+      This->Held = true;
+    }
+
+    pthread_mutex_unlock (&This->Lock);
+
+    if (Next != NULL) {
+      Next->Stats.Waiting += Now () - Start;
+    }
+  }
+
+  Waited = Now () - Start;
+
+  if (Next != NULL) {
+    Next->Pulled += Waited;
+  }
+
+  return Block;
+}
+
+void *DSPlibPipeline::RunQueue (void *Argument)
+{
+  DSPlibStageType *This = (DSPlibStageType *) Argument;
+  DSPlibBlockType *Block;
+  double Start;
+  bool More = true;
+
+  while (More) {
+    Start = Now ();
+
+    pthread_mutex_lock (&This->Lock);
+
+    while (((This->Filled - This->Released) == This->Count) && !This->Stopping) {
+      pthread_cond_wait (&This->Room, &This->Lock);
+    }
+
+    Block = &This->Queue [This->Filled % This->Count];
+    More  = !This->Stopping;
+
+    pthread_mutex_unlock (&This->Lock);
+
+    This->Stats.Waiting += Now () - Start;
+
+    if (More) {
+      More = This->Pipeline->Fill (This->Number, Block);
+    }
+
+    pthread_mutex_lock (&This->Lock);
+
+    if (More) {
+      This->Filled++;
+    }
+    else {
+      This->Ended = true;
+    }
+
+    pthread_cond_signal (&This->Ready);
+    pthread_mutex_unlock (&This->Lock);
+  }
+
+  return NULL;
+}
+
+int DSPlibPipeline::GetStageCount ()
+{
+  return this->StageCount;
+}
+
+void DSPlibPipeline::GetStats (int Stage, DSPlibStageStatsType *Stats)
+{
+  *Stats = this->Stages [Stage]->Stats;
+}
+
+void DSPlibPipeline::PrintStats (FILE *File)
+{
+  fprintf (File, "%-12s %8s %12s %10s %10s %14s\n", "stage", "blocks", "items", "busy s", "waiting s", "items/s");
+
+  for (int Stage = 0; Stage < this->StageCount; Stage++) {
+    DSPlibStageStatsType *Stats = &this->Stages [Stage]->Stats;
+
+    fprintf (File, "%-12s %8ld %12ld %10.3f %10.3f %14.0f\n", Stats->Name, Stats->Blocks, Stats->Items, Stats->Busy,
+	     Stats->Waiting, (Stats->Busy > 0.0) ? ((double) Stats->Items / Stats->Busy) : 0.0);
+
+    // Everything above a queue was on a thread of its own
+    if (this->Stages [Stage]->Count > 0) {
+      fprintf (File, "%-12s (%d blocks)\n", "  queue", this->Stages [Stage]->Count - 1);
+    }
+  }
+}
+
+// The decimator ------------------------------------------------------------------------------------------------------
+//   Notes:
+//     The filter is a Kaiser windowed band pass from 0 Hz (a low pass), with its stop band starting at the new Nyquist
+//       frequency.  It's symmetric around its middle tap, so lining output n up with input n * Factor is just a matter
+//       of starting half the filter early.
+//
+//     The input's kept as reals so every output is one DotProduct from DSPlibSIMD over the buffer, as wide as the
+//       CPU goes.
+// ---------------------------------------------------------------------------------------------------------------------
+
+DSPlibDecimator::DSPlibDecimator (int Factor, int Rate, double PassBand, long First, long Last)
+{
+  double Nyquist    = (double) Rate / (2.0 * (double) Factor);
+  double Transition = Nyquist - PassBand;
+
+  this->Factor = Factor;
+
+  CreateBandPassFilter (-Transition / 2.0, Transition / 2.0, PassBand, Nyquist, DSPLIB_DECIMATOR_ATTENUATION, Rate,
+			&this->TapCount, &this->Taps);
+
+  this->Next = First;
+  this->Last = Last;
+
+  this->BufferSize   = this->TapCount + DSPLIB_DECIMATOR_BUFFER;
+  this->Buffer       = new fftw_real [this->BufferSize];
+  this->BufferStart  = this->GetFirstInput ();
+  this->BufferLength = 0;
+
+  this->Input     = NULL;
+  this->InputUsed = 0;
+  this->InputDone = false;
+}
+
+DSPlibDecimator::~DSPlibDecimator ()
+{
+  delete [] this->Taps;
+  delete [] this->Buffer;
+}
+
+long DSPlibDecimator::GetFirstInput ()
+{
+  return this->Next * this->Factor - (this->TapCount - 1) / 2;
+}
+
+long DSPlibDecimator::GetLastInput ()
+{
+  return (this->Last - 1) * this->Factor + (this->TapCount - 1) / 2 + 1;
+}
+
+void DSPlibDecimator::Fill (DSPlibPipeline *Pipeline, int Stage, long End)
+{
+  long KeepFrom = this->GetFirstInput (), Wanted, Position, Count;
+
+  while (!this->InputDone && ((this->BufferStart + this->BufferLength) < End)) {
+    // Make room by dropping what the next output doesn't need
+    if (this->BufferLength == this->BufferSize) {
+      Count = KeepFrom - this->BufferStart;
+
+      memmove (this->Buffer, &this->Buffer [Count], (this->BufferLength - Count) * sizeof (fftw_real));
+
+      this->BufferStart   = KeepFrom;
+      this->BufferLength -= Count;
+    }
+
+    if ((this->Input == NULL) || (this->InputUsed == this->Input->Length)) {
+      this->Input     = Pipeline->Pull (Stage - 1);
+      this->InputUsed = 0;
+
+      if (this->Input == NULL) {
+	this->InputDone = true;
+	break;
+      }
+    }
+
+    Wanted   = this->BufferStart + this->BufferLength;
+    Position = this->Input->Position + this->InputUsed;
+
+    if (Position < Wanted) {
+      // Already past these
+      Count = this->Input->Length - this->InputUsed;
+      Count = ((Wanted - Position) < Count) ? (Wanted - Position) : Count;
+
+      this->InputUsed += Count;
+    }
+    else if (Position > Wanted) {
+      // The stream hasn't started yet
+      Count = this->BufferSize - this->BufferLength;
+      Count = ((Position - Wanted) < Count) ? (Position - Wanted) : Count;
+
+      memset (&this->Buffer [this->BufferLength], 0, Count * sizeof (fftw_real));
+
+      this->BufferLength += Count;
+    }
+    else {
+      Count = this->Input->Length - this->InputUsed;
+      Count = ((this->BufferSize - this->BufferLength) < Count) ? (this->BufferSize - this->BufferLength) : Count;
+
+      ConvertToReals (&((short *) this->Input->Data) [this->InputUsed], &this->Buffer [this->BufferLength], Count);
+
+      this->BufferLength += Count;
+      this->InputUsed    += Count;
+    }
+  }
+}
+
+bool DSPlibDecimator::Stage (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out)
+{
+  DSPlibDecimator *This    = (DSPlibDecimator *) State;
+  short           *Samples = (short *) Out->Data;
+  long Count = 0, First, Offset, Have;
+  fftw_real Sum;
+
+  while ((Count < Out->Capacity) && (This->Next < This->Last)) {
+    First = This->GetFirstInput ();
+
+    // The buffer never starts after the first sample this output needs
+    if (First > (This->BufferStart + This->BufferLength)) {
+      This->BufferStart  = First;
+      This->BufferLength = 0;
+    }
+
+    This->Fill (Pipeline, Stage, First + This->TapCount);
+
+    // Whatever's missing at the end is silence
+    Offset = First - This->BufferStart;
+    Have   = This->BufferLength - Offset;
+    Have   = (Have < This->TapCount) ? Have : This->TapCount;
+    Sum    = floor (DSPlibArrayKernels->DotProduct (This->Taps, &This->Buffer [Offset], Have) + 0.5);
+
+    Samples [Count++] = (short) ((Sum > 32767.0) ? 32767.0 : (Sum < -32768.0) ? -32768.0 : Sum);
+    This->Next++;
+  }
+
+  Out->Position = This->Next - Count;
+  Out->Length   = Count;
+
+  return (Count > 0);
+}
@@ -0,0 +1,148 @@
+// DSPlibPipeline.h
+//
+// An extension to DSPlib to chain processing steps (read, convert, decimate,
+// analyze, decide...) together as stages instead of writing one loop that
+// does them all.
+//
+// A pipeline is pulled from the end.  Asking the last stage for a block
+// makes it ask the stage before it for as many blocks as it needs, and so on
+// back to the first stage, which makes its blocks out of nothing (a file,
+// say).  Each stage is a function and whatever it keeps between calls, so a
+// stage can take one block in for every ten it puts out or the other way
+// round.
+//
+// Every stage gets its blocks made once, when it's added: Capacity items of
+// ItemSize bytes, lined up on DSPLIB_PIPELINE_ALIGNMENT bytes.  Nothing is
+// allocated per block.  A stage can be given a different block to fill every
+// time it's called, so anything it needs from the last call goes in its own
+// state, not in the block.
+//
+// AddQueue puts the stages added so far (back to the last queue) on a thread
+// of their own, which fills up to Depth blocks ahead of the stage after it.
+// The threads are named after their last stage, so they show up under their
+// own names in top -H and perf.  Every stage keeps count of its blocks and
+// items and the time it spent on them (not counting the stages it pulled
+// from) and waiting on a queue, which PrintStats lays out side by side.
+
+// What every block's data is lined up on (a cache line, and an AVX-512 register)
+#define		DSPLIB_PIPELINE_ALIGNMENT	64
+
+// The most stages in one pipeline
+#define		DSPLIB_PIPELINE_MAX_STAGES	16
+
+// One block: Length items starting with item Position of the stage's stream.  Data is NULL when the stage's items
+// have no size (a stage that only says which items it's done).
+typedef struct {
+  void *Data;
+  long  Capacity;
+  long  Length;
+  long  Position;
+} DSPlibBlockType;
+
+class DSPlibPipeline;
+
+// A stage's work: fill Out with its next block (pulling from Stage - 1 if it needs to) and return true, or return
+// false when there's nothing more.
+typedef bool (*DSPlibStageFunction) (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out);
+
+// What a stage has done.  Busy is the seconds spent in the stage's own function and Waiting is the seconds its
+// thread spent waiting on a queue: for a block to come in if it's pulling from one, or for room if it's filling one.
+typedef struct {
+  const char *Name;
+  long        Blocks, Items;
+  double      Busy, Waiting;
+} DSPlibStageStatsType;
+
+typedef struct DSPlibStageType DSPlibStageType;
+
+class DSPlibPipeline {
+  public:
+    // Basic constructor.  Makes an empty pipeline.
+    DSPlibPipeline ();
+
+    // Destructor (stops the threads if they're still going)
+    ~DSPlibPipeline ();
+
+    // Add a stage after the last one.  Returns its number.
+    int AddStage (const char *Name, DSPlibStageFunction Function, void *State, long ItemSize, long Capacity);
+
+    // Run the stages added so far on a thread of their own, Depth blocks
+    // ahead of the next stage.  Has to come after a stage and before Start.
+    void AddQueue (int Depth);
+
+    // Start the threads.  Returns false if one couldn't be started.
+    bool Start ();
+
+    // The next block out of Stage, or NULL at the end.  Only the stage after
+    // it (or the caller, for the last stage) pulls from a stage, and the
+    // block stays as it is until it pulls again.
+    DSPlibBlockType *Pull (int Stage);
+
+    // Stop the threads, even if they aren't finished (so the caller can stop
+    // pulling early).
+    void Stop ();
+
+    // How many stages there are, and what one of them has done.
+    int  GetStageCount ();
+    void GetStats (int Stage, DSPlibStageStatsType *Stats);
+
+    // Print every stage's stats (and its items per second) as a table.
+    void PrintStats (FILE *File);
+
+  private:
+    DSPlibStageType *Stages [DSPLIB_PIPELINE_MAX_STAGES];
+    int              StageCount;
+
+    // Run one stage's function into Out and count it
+    bool Fill (int Stage, DSPlibBlockType *Out);
+
+    // The threads that fill the queues
+    static void *RunQueue (void *Stage);
+};
+
+// The decimator's stopband attenuation
+#define		DSPLIB_DECIMATOR_ATTENUATION	60.0
+
+// A stage that low pass filters 16 bit samples (from a stage that puts out
+// 16 bit samples) and keeps every Factor'th one.  Output n is centered on
+// input n * Factor, so nothing is delayed, and input from before the start
+// or after the end of the stream counts as silence.  Positions are item
+// numbers: the stage before has to set Position to where its samples are in
+// the input, and this one puts out outputs First to Last - 1.
+class DSPlibDecimator {
+  public:
+    // Basic constructor.  Rate is the input's rate.  Everything up to
+    // PassBand Hz gets through and everything from the new Nyquist frequency
+    // up is at least DSPLIB_DECIMATOR_ATTENUATION dB down.
+    DSPlibDecimator (int Factor, int Rate, double PassBand, long First, long Last);
+
+    // Destructor
+    ~DSPlibDecimator ();
+
+    // The first input sample output First needs, and one past the last one
+    // output Last - 1 needs (so the stage before knows what to read).
+    long GetFirstInput ();
+    long GetLastInput  ();
+
+    // The stage function.  State is the decimator.
+    static bool Stage (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out);
+
+  private:
+    int        Factor;
+    int        TapCount;
+    fftw_real *Taps;
+
+    long Next, Last;
+
+    // The input around the next output, starting at input sample BufferStart
+    fftw_real *Buffer;
+    long       BufferSize, BufferStart, BufferLength;
+
+    // The block being read from, and how much of it has been used
+    DSPlibBlockType *Input;
+    long             InputUsed;
+    bool             InputDone;
+
+    // Make sure the buffer goes up to input sample End (if there is one)
+    void Fill (DSPlibPipeline *Pipeline, int Stage, long End);
+};
@@ -0,0 +1,239 @@
+// <BEHOLD the GPL!>
+// ntheory's DSPlibResonator, a bank of IIR tone detectors to complement DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+// </BEHOLD>
+
+#include <rfftw.h>
+#include <string.h>
+#include <math.h>
+#include "DSPlibResonator.h"
+#include "DSPlibSIMD.h"
+
+#define		DSPLIB_TWO_PI			6.28318530717958647693
+
+// Anything smaller than this in the state gets flushed to zero after every run so a long stretch of silence can't
+// leave the resonators grinding through denormals.
+#define		DSPLIB_RESONATOR_FLUSH		1e-20f
+
+// Run one group of resonators ----------------------------------------------------------------------------------------
+//   Description:
+//     Runs Length samples through DSPLIB_RESONATOR_LANES resonators and writes every lane's output for a sample
+//       before moving on to the next one.  Per lane and sample that's:
+//
+//         Re' = PoleRe * Re - PoleIm * Im + Gain * Input
+//         Im' = PoleIm * Re + PoleRe * Im
+//
+//       and Re' is the output.
+//
+//   Notes:
+//     Width is how many floats fit in a register, built once per instruction set and picked with DSPlibGetISA just
+//       like the oscillator bank.  AVX-512 gets the AVX2 width since there are only eight lanes to go around.
+//
+//     The AVX2 group isn't built for FMA.  DSPlibDetectISA picks AVX2 without checking for it, and multiply-adds that
+//       got fused would round differently from the other levels.
+// --------------------------------------------------------------------------------------------------------------------
+
+template <int Width>
+static inline __attribute__ ((always_inline)) void RunGroup (float *PoleRe, float *PoleIm, float *Gain,
+							    float *StateRe, float *StateIm,
+							    fftw_real *In, int Length, float *Out)
+{
+  typedef float VectorType __attribute__ ((vector_size (Width * sizeof (float))));
+
+  const int Count = DSPLIB_RESONATOR_LANES / Width;
+  VectorType Re [Count], Im [Count], PRe [Count], PIm [Count], G [Count], NextRe;
+
+  memcpy (Re,  StateRe, sizeof (Re));
+  memcpy (Im,  StateIm, sizeof (Im));
+  memcpy (PRe, PoleRe,  sizeof (PRe));
+  memcpy (PIm, PoleIm,  sizeof (PIm));
+  memcpy (G,   Gain,    sizeof (G));
+
+  for (int Loop = 0; Loop < Length; Loop++) {
+    float Sample = (float) In [Loop];
+
+    for (int Vector = 0; Vector < Count; Vector++) {
+      NextRe      = PRe [Vector] * Re [Vector] - PIm [Vector] * Im [Vector] + G [Vector] * Sample;
+      Im [Vector] = PIm [Vector] * Re [Vector] + PRe [Vector] * Im [Vector];
+      Re [Vector] = NextRe;
+
+      memcpy (&Out [Loop * DSPLIB_RESONATOR_LANES + Vector * Width], &Re [Vector], sizeof (VectorType));
+    }
+  }
+
+  memcpy (StateRe, Re, sizeof (Re));
+  memcpy (StateIm, Im, sizeof (Im));
+}
+
+typedef void (*RunGroupType) (float *PoleRe, float *PoleIm, float *Gain, float *StateRe, float *StateIm,
+			      fftw_real *In, int Length, float *Out);
+
+static void RunGroupScalar (float *PoleRe, float *PoleIm, float *Gain, float *StateRe, float *StateIm,
+			    fftw_real *In, int Length, float *Out)
+{
+  RunGroup <1> (PoleRe, PoleIm, Gain, StateRe, StateIm, In, Length, Out);
+}
+
+#if defined (__x86_64__) || defined (__i386__)
+
+__attribute__ ((target ("sse2")))
+static void RunGroupSSE2 (float *PoleRe, float *PoleIm, float *Gain, float *StateRe, float *StateIm,
+			  fftw_real *In, int Length, float *Out)
+{
+  RunGroup <4> (PoleRe, PoleIm, Gain, StateRe, StateIm, In, Length, Out);
+}
+
+__attribute__ ((target ("avx2")))
+static void RunGroupAVX2 (float *PoleRe, float *PoleIm, float *Gain, float *StateRe, float *StateIm,
+			  fftw_real *In, int Length, float *Out)
+{
+  RunGroup <8> (PoleRe, PoleIm, Gain, StateRe, StateIm, In, Length, Out);
+}
+
+static RunGroupType RunGroupKernels [DSPLIB_ISA_COUNT] = { RunGroupScalar, RunGroupSSE2, RunGroupAVX2, RunGroupAVX2 };
+
+#else
+
+static RunGroupType RunGroupKernels [DSPLIB_ISA_COUNT] = { RunGroupScalar, RunGroupScalar, RunGroupScalar, RunGroupScalar };
+
+#endif
+
+// Basic constructor
+DSPlibResonatorBank::DSPlibResonatorBank (int ToneCount, double *Frequencies, double *Bandwidths, int SamplingRate)
+{
+  int Lanes;
+
+  this->ToneCount  = ToneCount;
+  this->GroupCount = (ToneCount + DSPLIB_RESONATOR_LANES - 1) / DSPLIB_RESONATOR_LANES;
+
+  Lanes = this->GroupCount * DSPLIB_RESONATOR_LANES;
+
+  this->PoleRe  = new float [Lanes];
+  this->PoleIm  = new float [Lanes];
+  this->Gain    = new float [Lanes];
+  this->StateRe = new float [Lanes];
+  this->StateIm = new float [Lanes];
+
+  this->Scratch = new float [DSPLIB_RESONATOR_BLOCK * DSPLIB_RESONATOR_LANES];
+
+  for (int Lane = 0; Lane < Lanes; Lane++) {
+    double Radius, Omega, PRe, PIm;
+    double CRe, CIm, Denominator, HRe = 0.0, HIm = 0.0;
+
+    if (Lane >= ToneCount) {
+      this->PoleRe [Lane] = this->PoleIm [Lane] = this->Gain [Lane] = 0.0f;
+      continue;
+    }
+
+    // A pole this far in from the unit circle gives a -3 dB width of Bandwidths [Lane]
+    Radius = exp (-(DSPLIB_TWO_PI / 2.0) * Bandwidths [Lane] / (double) SamplingRate);
+    Omega  = DSPLIB_TWO_PI * Frequencies [Lane] / (double) SamplingRate;
+
+    PRe = Radius * cos (Omega);
+    PIm = Radius * sin (Omega);
+
+    // The real part of the output is half of the pole's response plus half of its mirror image's, so add up
+    // 1 / (1 - P e^-jw) for both at the tone's own frequency and scale the input by one over the size of that.
+    // The 32768 takes the input from 16 bit samples to the -1 to 1 range.
+    for (int Image = 0; Image < 2; Image++) {
+      double Im = (Image == 0) ? PIm : -PIm;
+
+      CRe = 1.0 - (PRe * cos (Omega) + Im * sin (Omega));
+      CIm = -(Im * cos (Omega) - PRe * sin (Omega));
+
+      Denominator = (CRe * CRe) + (CIm * CIm);
+
+      HRe += 0.5 * CRe / Denominator;
+      HIm -= 0.5 * CIm / Denominator;
+    }
+
+    this->PoleRe [Lane] = (float) PRe;
+    this->PoleIm [Lane] = (float) PIm;
+    this->Gain   [Lane] = (float) (1.0 / (sqrt ((HRe * HRe) + (HIm * HIm)) * 32768.0));
+  }
+
+  this->Reset ();
+}
+
+DSPlibResonatorBank::~DSPlibResonatorBank ()
+{
+  delete [] this->PoleRe;
+  delete [] this->PoleIm;
+  delete [] this->Gain;
+  delete [] this->StateRe;
+  delete [] this->StateIm;
+  delete [] this->Scratch;
+}
+
+void DSPlibResonatorBank::Filter (fftw_real *In, int Length, fftw_real **Out)
+{
+  RunGroupType RunGroup = RunGroupKernels [DSPlibGetISA ()];
+  int Block, Tone, Last;
+
+  for (int Offset = 0; Offset < Length; Offset += DSPLIB_RESONATOR_BLOCK) {
+    Block = ((Length - Offset) < DSPLIB_RESONATOR_BLOCK) ? (Length - Offset) : DSPLIB_RESONATOR_BLOCK;
+
+    for (int Group = 0; Group < this->GroupCount; Group++) {
+      Tone = Group * DSPLIB_RESONATOR_LANES;
+      Last = ((this->ToneCount - Tone) < DSPLIB_RESONATOR_LANES) ? (this->ToneCount - Tone) : DSPLIB_RESONATOR_LANES;
+
+      RunGroup (&this->PoleRe [Tone], &this->PoleIm [Tone], &this->Gain [Tone], &this->StateRe [Tone], &this->StateIm [Tone],
+		&In [Offset], Block, this->Scratch);
+
+      // Unscramble the lanes into the caller's arrays
+      for (int Lane = 0; Lane < Last; Lane++) {
+	for (int Loop = 0; Loop < Block; Loop++) {
+	  Out [Tone + Lane][Offset + Loop] = this->Scratch [Loop * DSPLIB_RESONATOR_LANES + Lane];
+	}
+      }
+    }
+  }
+
+  for (int Lane = 0; Lane < this->GroupCount * DSPLIB_RESONATOR_LANES; Lane++) {
+    if ((fabsf (this->StateRe [Lane]) + fabsf (this->StateIm [Lane])) < DSPLIB_RESONATOR_FLUSH) {
+      this->StateRe [Lane] = this->StateIm [Lane] = 0.0f;
+    }
+  }
+}
+
+void DSPlibResonatorBank::Filter (fftw_real Sample, fftw_real *Out)
+{
+  RunGroupType RunGroup = RunGroupKernels [DSPlibGetISA ()];
+  int Tone, Last;
+
+  for (int Group = 0; Group < this->GroupCount; Group++) {
+    Tone = Group * DSPLIB_RESONATOR_LANES;
+    Last = ((this->ToneCount - Tone) < DSPLIB_RESONATOR_LANES) ? (this->ToneCount - Tone) : DSPLIB_RESONATOR_LANES;
+
+    RunGroup (&this->PoleRe [Tone], &this->PoleIm [Tone], &this->Gain [Tone], &this->StateRe [Tone], &this->StateIm [Tone],
+	      &Sample, 1, this->Scratch);
+
+    for (int Lane = 0; Lane < Last; Lane++) {
+      Out [Tone + Lane] = this->Scratch [Lane];
+
+      if ((fabsf (this->StateRe [Tone + Lane]) + fabsf (this->StateIm [Tone + Lane])) < DSPLIB_RESONATOR_FLUSH) {
+	this->StateRe [Tone + Lane] = this->StateIm [Tone + Lane] = 0.0f;
+      }
+    }
+  }
+}
+
+void DSPlibResonatorBank::Reset ()
+{
+  memset (this->StateRe, 0, this->GroupCount * DSPLIB_RESONATOR_LANES * sizeof (float));
+  memset (this->StateIm, 0, this->GroupCount * DSPLIB_RESONATOR_LANES * sizeof (float));
+}
@@ -0,0 +1,53 @@
+// DSPlibResonator.h
+//
+// An extension to DSPlib to pick tones out with a bank of second order IIR
+// resonators instead of FIRs.
+//
+// Each resonator is a complex one pole filter (a "coupled form" biquad): the
+// state is rotated by the tone's frequency and shrunk a little every sample,
+// and the input is added to the real part.  That costs about five multiply
+// adds per tone per sample no matter what the sampling rate is, and unlike
+// the textbook direct form it stays put in single precision even when the
+// pole is right up against the unit circle (low tones at high rates).
+//
+// The tones are run DSPLIB_RESONATOR_LANES at a time side by side in floats
+// so a whole group of eight fits in one AVX register.
+
+// The number of tones run side by side.
+#define		DSPLIB_RESONATOR_LANES		8
+
+// The most samples run through the kernel in one go (the size of the scratch
+// buffer the results are unscrambled from).
+#define		DSPLIB_RESONATOR_BLOCK		256
+
+class DSPlibResonatorBank {
+  public:
+    // Basic constructor.  Bandwidths are the -3 dB widths in Hz.
+    DSPlibResonatorBank (int ToneCount, double *Frequencies, double *Bandwidths, int SamplingRate);
+
+    // Destructor
+    ~DSPlibResonatorBank ();
+
+    // Run samples through every resonator.  The input is in the same 16 bit
+    // range DSPlibFilter takes and each resonator has a gain of one at its
+    // own frequency.  The first one puts Length samples of each tone in
+    // Out [Tone], the second one does a single sample and puts each tone's
+    // output in Out [Tone].
+    void Filter (fftw_real *In, int Length, fftw_real **Out);
+    void Filter (fftw_real Sample, fftw_real *Out);
+
+    // Forget everything that has gone in so far.
+    void Reset ();
+
+  private:
+    int ToneCount;
+    int GroupCount;
+
+    // The pole, input gain and state for every lane of every group.  Lanes
+    // past ToneCount have a pole and gain of zero so they stay at zero.
+    float *PoleRe, *PoleIm, *Gain;
+    float *StateRe, *StateIm;
+
+    // Where the kernel puts its output, one sample of every lane after another.
+    float *Scratch;
+};
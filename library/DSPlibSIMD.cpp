@@ -0,0 +1,753 @@
+// <BEHOLD the GPL!>
+// ntheory's DSPlibSIMD, vectorized array primitives to complement DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+// </BEHOLD>
+
+#include <rfftw.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "DSPlibSIMD.h"
+
+// The vector kernels are written for the default (double precision) FFTW.  A single precision FFTW build just gets
+// the scalar kernels at every level.
+#if (defined (__x86_64__) || defined (__i386__)) && !defined (FFTW_ENABLE_FLOAT)
+#define		DSPLIB_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// The limits of a short, as reals, for the saturating conversion.
+#define		DSPLIB_SHORT_MIN		-32768.0
+#define		DSPLIB_SHORT_MAX		32767.0
+
+// Scalar kernels -----------------------------------------------------------------------------------------------------
+//   Description:
+//     The plain loops DSPlib has always used.  These are also used to finish off whatever is left over at the end of
+//       an array after the vector kernels have done as many full vectors as they can.
+//
+//   Notes:
+//     ConvertToInts saturates now instead of leaving it up to the compiler.
+// --------------------------------------------------------------------------------------------------------------------
+
+  static void MixArrays2Scalar (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
+  {
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Out [Loop] = (In1 [Loop] + In2 [Loop]) / 2;
+    }
+  }
+
+  static void MixArrays4Scalar (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
+  {
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Out [Loop] = (In1 [Loop] + In2 [Loop] + In3 [Loop] + In4 [Loop]) / 4;
+    }
+  }
+
+  static void MultiplyArrays2Scalar (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
+  {
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Out [Loop] = In1 [Loop] * In2 [Loop];
+    }
+  }
+
+  static void MultiplyArrays4Scalar (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
+  {
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Out [Loop] = In1 [Loop] * In2 [Loop] * In3 [Loop] * In4 [Loop];
+    }
+  }
+
+  static fftw_real MaxAbsScalar (fftw_real *In, int Length)
+  {
+    fftw_real Largest = 0.0;
+    fftw_real Current;
+
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Current = fabs (In [Loop]);
+
+      if (Largest < Current) {
+	Largest = Current;
+      }
+    }
+
+    return Largest;
+  }
+
+  static void DivideArrayScalar (fftw_real *In, fftw_real Divisor, fftw_real *Out, int Length)
+  {
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Out [Loop] = In [Loop] / Divisor;
+    }
+  }
+
+  static void InvertArrayScalar (fftw_real *Data, int Length)
+  {
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Data [Loop] = -Data [Loop];
+    }
+  }
+
+  static void ConvertToIntsScalar (fftw_real *Input, short *Output, int Length)
+  {
+    fftw_real Current;
+
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Current = Input [Loop];
+
+      if (Current < DSPLIB_SHORT_MIN) Current = DSPLIB_SHORT_MIN;
+      if (Current > DSPLIB_SHORT_MAX) Current = DSPLIB_SHORT_MAX;
+
+      Output [Loop] = (short) Current;
+    }
+  }
+
+  static void ConvertToRealsScalar (short *Input, fftw_real *Output, int Length)
+  {
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Output [Loop] = (fftw_real) Input [Loop];
+    }
+  }
+
+  static fftw_real DotProductScalar (fftw_real *In1, fftw_real *In2, int Length)
+  {
+    fftw_real Sum = 0.0;
+
+    for (int Loop = 0; Loop < Length; Loop++) {
+      Sum += In1 [Loop] * In2 [Loop];
+    }
+
+    return Sum;
+  }
+
+#ifdef DSPLIB_SIMD_X86
+
+// SSE2 kernels -------------------------------------------------------------------------------------------------------
+//   Description:
+//     Two doubles at a time.  Every x86-64 CPU has these.
+//
+//   Notes:
+//     Mixing multiplies by 1/2 and 1/4 instead of dividing.  Those are exact so the results match the scalar loops
+//       bit for bit (and so do all of the other kernels but DotProduct, which adds its products up in a different
+//       order and can come out a rounding away from the scalar sum).
+// --------------------------------------------------------------------------------------------------------------------
+
+  __attribute__ ((target ("sse2")))
+  static void MixArrays2SSE2 (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
+  {
+    __m128d Half = _mm_set1_pd (0.5);
+    int Loop = 0;
+
+    for (; Loop + 2 <= Length; Loop += 2) {
+      _mm_storeu_pd (&Out [Loop], _mm_mul_pd (_mm_add_pd (_mm_loadu_pd (&In1 [Loop]), _mm_loadu_pd (&In2 [Loop])), Half));
+    }
+
+    MixArrays2Scalar (&In1 [Loop], &In2 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("sse2")))
+  static void MixArrays4SSE2 (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
+  {
+    __m128d Quarter = _mm_set1_pd (0.25);
+    __m128d Sum;
+    int Loop = 0;
+
+    for (; Loop + 2 <= Length; Loop += 2) {
+      Sum = _mm_add_pd (_mm_loadu_pd (&In1 [Loop]), _mm_loadu_pd (&In2 [Loop]));
+      Sum = _mm_add_pd (Sum, _mm_loadu_pd (&In3 [Loop]));
+      Sum = _mm_add_pd (Sum, _mm_loadu_pd (&In4 [Loop]));
+
+      _mm_storeu_pd (&Out [Loop], _mm_mul_pd (Sum, Quarter));
+    }
+
+    MixArrays4Scalar (&In1 [Loop], &In2 [Loop], &In3 [Loop], &In4 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("sse2")))
+  static void MultiplyArrays2SSE2 (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
+  {
+    int Loop = 0;
+
+    for (; Loop + 2 <= Length; Loop += 2) {
+      _mm_storeu_pd (&Out [Loop], _mm_mul_pd (_mm_loadu_pd (&In1 [Loop]), _mm_loadu_pd (&In2 [Loop])));
+    }
+
+    MultiplyArrays2Scalar (&In1 [Loop], &In2 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("sse2")))
+  static void MultiplyArrays4SSE2 (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
+  {
+    __m128d Product;
+    int Loop = 0;
+
+    for (; Loop + 2 <= Length; Loop += 2) {
+      Product = _mm_mul_pd (_mm_loadu_pd (&In1 [Loop]), _mm_loadu_pd (&In2 [Loop]));
+      Product = _mm_mul_pd (Product, _mm_loadu_pd (&In3 [Loop]));
+      Product = _mm_mul_pd (Product, _mm_loadu_pd (&In4 [Loop]));
+
+      _mm_storeu_pd (&Out [Loop], Product);
+    }
+
+    MultiplyArrays4Scalar (&In1 [Loop], &In2 [Loop], &In3 [Loop], &In4 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("sse2")))
+  static fftw_real MaxAbsSSE2 (fftw_real *In, int Length)
+  {
+    __m128d SignMask = _mm_set1_pd (-0.0);
+    __m128d Largest  = _mm_setzero_pd ();
+    fftw_real Lanes [2];
+    fftw_real Tail;
+    int Loop = 0;
+
+    for (; Loop + 2 <= Length; Loop += 2) {
+      Largest = _mm_max_pd (Largest, _mm_andnot_pd (SignMask, _mm_loadu_pd (&In [Loop])));
+    }
+
+    _mm_storeu_pd (Lanes, Largest);
+
+    Tail = MaxAbsScalar (&In [Loop], Length - Loop);
+
+    if (Lanes [0] < Lanes [1]) Lanes [0] = Lanes [1];
+    if (Lanes [0] < Tail)      Lanes [0] = Tail;
+
+    return Lanes [0];
+  }
+
+  __attribute__ ((target ("sse2")))
+  static void DivideArraySSE2 (fftw_real *In, fftw_real Divisor, fftw_real *Out, int Length)
+  {
+    __m128d VectorDivisor = _mm_set1_pd (Divisor);
+    int Loop = 0;
+
+    for (; Loop + 2 <= Length; Loop += 2) {
+      _mm_storeu_pd (&Out [Loop], _mm_div_pd (_mm_loadu_pd (&In [Loop]), VectorDivisor));
+    }
+
+    DivideArrayScalar (&In [Loop], Divisor, &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("sse2")))
+  static void InvertArraySSE2 (fftw_real *Data, int Length)
+  {
+    __m128d SignMask = _mm_set1_pd (-0.0);
+    int Loop = 0;
+
+    for (; Loop + 2 <= Length; Loop += 2) {
+      _mm_storeu_pd (&Data [Loop], _mm_xor_pd (_mm_loadu_pd (&Data [Loop]), SignMask));
+    }
+
+    InvertArrayScalar (&Data [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("sse2")))
+  static void ConvertToIntsSSE2 (fftw_real *Input, short *Output, int Length)
+  {
+    __m128d Minimum = _mm_set1_pd (DSPLIB_SHORT_MIN);
+    __m128d Maximum = _mm_set1_pd (DSPLIB_SHORT_MAX);
+    __m128i Low, High;
+    int Loop = 0;
+
+    // Clamp in double first.  cvttpd turns anything outside of the int range into INT_MIN, which the saturating
+    // pack would then happily turn into -32768 even for huge positive values.
+    for (; Loop + 4 <= Length; Loop += 4) {
+      Low  = _mm_cvttpd_epi32 (_mm_min_pd (_mm_max_pd (_mm_loadu_pd (&Input [Loop]),     Minimum), Maximum));
+      High = _mm_cvttpd_epi32 (_mm_min_pd (_mm_max_pd (_mm_loadu_pd (&Input [Loop + 2]), Minimum), Maximum));
+
+      Low = _mm_unpacklo_epi64 (Low, High);
+
+      _mm_storel_epi64 ((__m128i *) &Output [Loop], _mm_packs_epi32 (Low, Low));
+    }
+
+    ConvertToIntsScalar (&Input [Loop], &Output [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("sse2")))
+  static void ConvertToRealsSSE2 (short *Input, fftw_real *Output, int Length)
+  {
+    __m128i Shorts, Ints;
+    int Loop = 0;
+
+    for (; Loop + 4 <= Length; Loop += 4) {
+      // Sign extend four shorts to ints (put each one in the top half and shift it back down).
+      Shorts = _mm_loadl_epi64 ((__m128i *) &Input [Loop]);
+      Ints   = _mm_srai_epi32 (_mm_unpacklo_epi16 (Shorts, Shorts), 16);
+
+      _mm_storeu_pd (&Output [Loop],     _mm_cvtepi32_pd (Ints));
+      _mm_storeu_pd (&Output [Loop + 2], _mm_cvtepi32_pd (_mm_srli_si128 (Ints, 8)));
+    }
+
+    ConvertToRealsScalar (&Input [Loop], &Output [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("sse2")))
+  static fftw_real DotProductSSE2 (fftw_real *In1, fftw_real *In2, int Length)
+  {
+    __m128d Sum1 = _mm_setzero_pd ();
+    __m128d Sum2 = _mm_setzero_pd ();
+    fftw_real Lanes [2];
+    int Loop = 0;
+
+    for (; Loop + 4 <= Length; Loop += 4) {
+      Sum1 = _mm_add_pd (Sum1, _mm_mul_pd (_mm_loadu_pd (&In1 [Loop]),     _mm_loadu_pd (&In2 [Loop])));
+      Sum2 = _mm_add_pd (Sum2, _mm_mul_pd (_mm_loadu_pd (&In1 [Loop + 2]), _mm_loadu_pd (&In2 [Loop + 2])));
+    }
+
+    _mm_storeu_pd (Lanes, _mm_add_pd (Sum1, Sum2));
+
+    return Lanes [0] + Lanes [1] + DotProductScalar (&In1 [Loop], &In2 [Loop], Length - Loop);
+  }
+
+// AVX2 kernels -------------------------------------------------------------------------------------------------------
+//   Description:
+//     Four doubles at a time.
+//
+//   Notes:
+//     None.
+// --------------------------------------------------------------------------------------------------------------------
+
+  __attribute__ ((target ("avx2")))
+  static void MixArrays2AVX2 (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
+  {
+    __m256d Half = _mm256_set1_pd (0.5);
+    int Loop = 0;
+
+    for (; Loop + 4 <= Length; Loop += 4) {
+      _mm256_storeu_pd (&Out [Loop], _mm256_mul_pd (_mm256_add_pd (_mm256_loadu_pd (&In1 [Loop]), _mm256_loadu_pd (&In2 [Loop])), Half));
+    }
+
+    MixArrays2Scalar (&In1 [Loop], &In2 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx2")))
+  static void MixArrays4AVX2 (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
+  {
+    __m256d Quarter = _mm256_set1_pd (0.25);
+    __m256d Sum;
+    int Loop = 0;
+
+    for (; Loop + 4 <= Length; Loop += 4) {
+      Sum = _mm256_add_pd (_mm256_loadu_pd (&In1 [Loop]), _mm256_loadu_pd (&In2 [Loop]));
+      Sum = _mm256_add_pd (Sum, _mm256_loadu_pd (&In3 [Loop]));
+      Sum = _mm256_add_pd (Sum, _mm256_loadu_pd (&In4 [Loop]));
+
+      _mm256_storeu_pd (&Out [Loop], _mm256_mul_pd (Sum, Quarter));
+    }
+
+    MixArrays4Scalar (&In1 [Loop], &In2 [Loop], &In3 [Loop], &In4 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx2")))
+  static void MultiplyArrays2AVX2 (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
+  {
+    int Loop = 0;
+
+    for (; Loop + 4 <= Length; Loop += 4) {
+      _mm256_storeu_pd (&Out [Loop], _mm256_mul_pd (_mm256_loadu_pd (&In1 [Loop]), _mm256_loadu_pd (&In2 [Loop])));
+    }
+
+    MultiplyArrays2Scalar (&In1 [Loop], &In2 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx2")))
+  static void MultiplyArrays4AVX2 (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
+  {
+    __m256d Product;
+    int Loop = 0;
+
+    for (; Loop + 4 <= Length; Loop += 4) {
+      Product = _mm256_mul_pd (_mm256_loadu_pd (&In1 [Loop]), _mm256_loadu_pd (&In2 [Loop]));
+      Product = _mm256_mul_pd (Product, _mm256_loadu_pd (&In3 [Loop]));
+      Product = _mm256_mul_pd (Product, _mm256_loadu_pd (&In4 [Loop]));
+
+      _mm256_storeu_pd (&Out [Loop], Product);
+    }
+
+    MultiplyArrays4Scalar (&In1 [Loop], &In2 [Loop], &In3 [Loop], &In4 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx2")))
+  static fftw_real MaxAbsAVX2 (fftw_real *In, int Length)
+  {
+    __m256d SignMask = _mm256_set1_pd (-0.0);
+    __m256d Largest  = _mm256_setzero_pd ();
+    __m128d Half;
+    fftw_real Lanes [2];
+    fftw_real Tail;
+    int Loop = 0;
+
+    for (; Loop + 4 <= Length; Loop += 4) {
+      Largest = _mm256_max_pd (Largest, _mm256_andnot_pd (SignMask, _mm256_loadu_pd (&In [Loop])));
+    }
+
+    Half = _mm_max_pd (_mm256_castpd256_pd128 (Largest), _mm256_extractf128_pd (Largest, 1));
+    _mm_storeu_pd (Lanes, Half);
+
+    Tail = MaxAbsScalar (&In [Loop], Length - Loop);
+
+    if (Lanes [0] < Lanes [1]) Lanes [0] = Lanes [1];
+    if (Lanes [0] < Tail)      Lanes [0] = Tail;
+
+    return Lanes [0];
+  }
+
+  __attribute__ ((target ("avx2")))
+  static void DivideArrayAVX2 (fftw_real *In, fftw_real Divisor, fftw_real *Out, int Length)
+  {
+    __m256d VectorDivisor = _mm256_set1_pd (Divisor);
+    int Loop = 0;
+
+    for (; Loop + 4 <= Length; Loop += 4) {
+      _mm256_storeu_pd (&Out [Loop], _mm256_div_pd (_mm256_loadu_pd (&In [Loop]), VectorDivisor));
+    }
+
+    DivideArrayScalar (&In [Loop], Divisor, &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx2")))
+  static void InvertArrayAVX2 (fftw_real *Data, int Length)
+  {
+    __m256d SignMask = _mm256_set1_pd (-0.0);
+    int Loop = 0;
+
+    for (; Loop + 4 <= Length; Loop += 4) {
+      _mm256_storeu_pd (&Data [Loop], _mm256_xor_pd (_mm256_loadu_pd (&Data [Loop]), SignMask));
+    }
+
+    InvertArrayScalar (&Data [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx2")))
+  static void ConvertToIntsAVX2 (fftw_real *Input, short *Output, int Length)
+  {
+    __m256d Minimum = _mm256_set1_pd (DSPLIB_SHORT_MIN);
+    __m256d Maximum = _mm256_set1_pd (DSPLIB_SHORT_MAX);
+    __m128i Low, High;
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      Low  = _mm256_cvttpd_epi32 (_mm256_min_pd (_mm256_max_pd (_mm256_loadu_pd (&Input [Loop]),     Minimum), Maximum));
+      High = _mm256_cvttpd_epi32 (_mm256_min_pd (_mm256_max_pd (_mm256_loadu_pd (&Input [Loop + 4]), Minimum), Maximum));
+
+      _mm_storeu_si128 ((__m128i *) &Output [Loop], _mm_packs_epi32 (Low, High));
+    }
+
+    ConvertToIntsScalar (&Input [Loop], &Output [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx2")))
+  static void ConvertToRealsAVX2 (short *Input, fftw_real *Output, int Length)
+  {
+    __m256i Ints;
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      Ints = _mm256_cvtepi16_epi32 (_mm_loadu_si128 ((__m128i *) &Input [Loop]));
+
+      _mm256_storeu_pd (&Output [Loop],     _mm256_cvtepi32_pd (_mm256_castsi256_si128 (Ints)));
+      _mm256_storeu_pd (&Output [Loop + 4], _mm256_cvtepi32_pd (_mm256_extracti128_si256 (Ints, 1)));
+    }
+
+    ConvertToRealsScalar (&Input [Loop], &Output [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx2")))
+  static fftw_real DotProductAVX2 (fftw_real *In1, fftw_real *In2, int Length)
+  {
+    __m256d Sum1 = _mm256_setzero_pd ();
+    __m256d Sum2 = _mm256_setzero_pd ();
+    fftw_real Lanes [4];
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      Sum1 = _mm256_add_pd (Sum1, _mm256_mul_pd (_mm256_loadu_pd (&In1 [Loop]),     _mm256_loadu_pd (&In2 [Loop])));
+      Sum2 = _mm256_add_pd (Sum2, _mm256_mul_pd (_mm256_loadu_pd (&In1 [Loop + 4]), _mm256_loadu_pd (&In2 [Loop + 4])));
+    }
+
+    _mm256_storeu_pd (Lanes, _mm256_add_pd (Sum1, Sum2));
+
+    return (Lanes [0] + Lanes [1]) + (Lanes [2] + Lanes [3]) +
+	   DotProductScalar (&In1 [Loop], &In2 [Loop], Length - Loop);
+  }
+
+// AVX-512 kernels ----------------------------------------------------------------------------------------------------
+//   Description:
+//     Eight doubles at a time.
+//
+//   Notes:
+//     Only AVX512F is needed.  The int16 conversion uses the saturating down-convert instead of a pack.
+// --------------------------------------------------------------------------------------------------------------------
+
+  __attribute__ ((target ("avx512f")))
+  static void MixArrays2AVX512 (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
+  {
+    __m512d Half = _mm512_set1_pd (0.5);
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      _mm512_storeu_pd (&Out [Loop], _mm512_mul_pd (_mm512_add_pd (_mm512_loadu_pd (&In1 [Loop]), _mm512_loadu_pd (&In2 [Loop])), Half));
+    }
+
+    MixArrays2Scalar (&In1 [Loop], &In2 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx512f")))
+  static void MixArrays4AVX512 (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
+  {
+    __m512d Quarter = _mm512_set1_pd (0.25);
+    __m512d Sum;
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      Sum = _mm512_add_pd (_mm512_loadu_pd (&In1 [Loop]), _mm512_loadu_pd (&In2 [Loop]));
+      Sum = _mm512_add_pd (Sum, _mm512_loadu_pd (&In3 [Loop]));
+      Sum = _mm512_add_pd (Sum, _mm512_loadu_pd (&In4 [Loop]));
+
+      _mm512_storeu_pd (&Out [Loop], _mm512_mul_pd (Sum, Quarter));
+    }
+
+    MixArrays4Scalar (&In1 [Loop], &In2 [Loop], &In3 [Loop], &In4 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx512f")))
+  static void MultiplyArrays2AVX512 (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length)
+  {
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      _mm512_storeu_pd (&Out [Loop], _mm512_mul_pd (_mm512_loadu_pd (&In1 [Loop]), _mm512_loadu_pd (&In2 [Loop])));
+    }
+
+    MultiplyArrays2Scalar (&In1 [Loop], &In2 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx512f")))
+  static void MultiplyArrays4AVX512 (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length)
+  {
+    __m512d Product;
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      Product = _mm512_mul_pd (_mm512_loadu_pd (&In1 [Loop]), _mm512_loadu_pd (&In2 [Loop]));
+      Product = _mm512_mul_pd (Product, _mm512_loadu_pd (&In3 [Loop]));
+      Product = _mm512_mul_pd (Product, _mm512_loadu_pd (&In4 [Loop]));
+
+      _mm512_storeu_pd (&Out [Loop], Product);
+    }
+
+    MultiplyArrays4Scalar (&In1 [Loop], &In2 [Loop], &In3 [Loop], &In4 [Loop], &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx512f")))
+  static fftw_real MaxAbsAVX512 (fftw_real *In, int Length)
+  {
+    __m512d Largest = _mm512_setzero_pd ();
+    fftw_real Vector, Tail;
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      Largest = _mm512_max_pd (Largest, _mm512_abs_pd (_mm512_loadu_pd (&In [Loop])));
+    }
+
+    Vector = _mm512_reduce_max_pd (Largest);
+    Tail   = MaxAbsScalar (&In [Loop], Length - Loop);
+
+    return (Vector < Tail) ? Tail : Vector;
+  }
+
+  __attribute__ ((target ("avx512f")))
+  static void DivideArrayAVX512 (fftw_real *In, fftw_real Divisor, fftw_real *Out, int Length)
+  {
+    __m512d VectorDivisor = _mm512_set1_pd (Divisor);
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      _mm512_storeu_pd (&Out [Loop], _mm512_div_pd (_mm512_loadu_pd (&In [Loop]), VectorDivisor));
+    }
+
+    DivideArrayScalar (&In [Loop], Divisor, &Out [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx512f")))
+  static void InvertArrayAVX512 (fftw_real *Data, int Length)
+  {
+    __m512i SignMask = _mm512_set1_epi64 (0x8000000000000000LL);
+    int Loop = 0;
+
+    for (; Loop + 8 <= Length; Loop += 8) {
+      _mm512_storeu_pd (&Data [Loop],
+	                _mm512_castsi512_pd (_mm512_xor_si512 (_mm512_castpd_si512 (_mm512_loadu_pd (&Data [Loop])), SignMask)));
+    }
+
+    InvertArrayScalar (&Data [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx512f")))
+  static void ConvertToIntsAVX512 (fftw_real *Input, short *Output, int Length)
+  {
+    __m512d Minimum = _mm512_set1_pd (DSPLIB_SHORT_MIN);
+    __m512d Maximum = _mm512_set1_pd (DSPLIB_SHORT_MAX);
+    __m256i Low, High;
+    int Loop = 0;
+
+    for (; Loop + 16 <= Length; Loop += 16) {
+      Low  = _mm512_cvttpd_epi32 (_mm512_min_pd (_mm512_max_pd (_mm512_loadu_pd (&Input [Loop]),     Minimum), Maximum));
+      High = _mm512_cvttpd_epi32 (_mm512_min_pd (_mm512_max_pd (_mm512_loadu_pd (&Input [Loop + 8]), Minimum), Maximum));
+
+      _mm256_storeu_si256 ((__m256i *) &Output [Loop],
+	                   _mm512_cvtsepi32_epi16 (_mm512_inserti64x4 (_mm512_castsi256_si512 (Low), High, 1)));
+    }
+
+    ConvertToIntsScalar (&Input [Loop], &Output [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx512f")))
+  static void ConvertToRealsAVX512 (short *Input, fftw_real *Output, int Length)
+  {
+    __m512i Ints;
+    int Loop = 0;
+
+    for (; Loop + 16 <= Length; Loop += 16) {
+      Ints = _mm512_cvtepi16_epi32 (_mm256_loadu_si256 ((__m256i *) &Input [Loop]));
+
+      _mm512_storeu_pd (&Output [Loop],     _mm512_cvtepi32_pd (_mm512_castsi512_si256 (Ints)));
+      _mm512_storeu_pd (&Output [Loop + 8], _mm512_cvtepi32_pd (_mm512_extracti64x4_epi64 (Ints, 1)));
+    }
+
+    ConvertToRealsScalar (&Input [Loop], &Output [Loop], Length - Loop);
+  }
+
+  __attribute__ ((target ("avx512f")))
+  static fftw_real DotProductAVX512 (fftw_real *In1, fftw_real *In2, int Length)
+  {
+    __m512d Sum1 = _mm512_setzero_pd ();
+    __m512d Sum2 = _mm512_setzero_pd ();
+    int Loop = 0;
+
+    for (; Loop + 16 <= Length; Loop += 16) {
+      Sum1 = _mm512_add_pd (Sum1, _mm512_mul_pd (_mm512_loadu_pd (&In1 [Loop]),     _mm512_loadu_pd (&In2 [Loop])));
+      Sum2 = _mm512_add_pd (Sum2, _mm512_mul_pd (_mm512_loadu_pd (&In1 [Loop + 8]), _mm512_loadu_pd (&In2 [Loop + 8])));
+    }
+
+    return _mm512_reduce_add_pd (_mm512_add_pd (Sum1, Sum2)) +
+	   DotProductScalar (&In1 [Loop], &In2 [Loop], Length - Loop);
+  }
+
+#endif
+
+// Kernel tables and dispatch -----------------------------------------------------------------------------------------
+//   Description:
+//     One table per level.  DSPlibArrayKernels points at the one in use; it starts out at the best level the CPU
+//       supports (or whatever DSPLIB_ISA_ENVIRONMENT caps it to).
+//
+//   Notes:
+//     __builtin_cpu_supports already checks that the OS saves the AVX/AVX-512 registers.
+// --------------------------------------------------------------------------------------------------------------------
+
+  static DSPlibArrayKernelsType DSPlibKernelTables [DSPLIB_ISA_COUNT] = {
+    { "scalar",
+      MixArrays2Scalar, MixArrays4Scalar, MultiplyArrays2Scalar, MultiplyArrays4Scalar,
+      MaxAbsScalar, DivideArrayScalar, InvertArrayScalar, ConvertToIntsScalar, ConvertToRealsScalar,
+      DotProductScalar },
+#ifdef DSPLIB_SIMD_X86
+    { "sse2",
+      MixArrays2SSE2, MixArrays4SSE2, MultiplyArrays2SSE2, MultiplyArrays4SSE2,
+      MaxAbsSSE2, DivideArraySSE2, InvertArraySSE2, ConvertToIntsSSE2, ConvertToRealsSSE2,
+      DotProductSSE2 },
+    { "avx2",
+      MixArrays2AVX2, MixArrays4AVX2, MultiplyArrays2AVX2, MultiplyArrays4AVX2,
+      MaxAbsAVX2, DivideArrayAVX2, InvertArrayAVX2, ConvertToIntsAVX2, ConvertToRealsAVX2,
+      DotProductAVX2 },
+    { "avx512",
+      MixArrays2AVX512, MixArrays4AVX512, MultiplyArrays2AVX512, MultiplyArrays4AVX512,
+      MaxAbsAVX512, DivideArrayAVX512, InvertArrayAVX512, ConvertToIntsAVX512, ConvertToRealsAVX512,
+      DotProductAVX512 }
+#endif
+  };
+
+  static const char *DSPlibISANames [DSPLIB_ISA_COUNT] = { "scalar", "sse2", "avx2", "avx512" };
+
+  static int DSPlibCurrentISA = DSPLIB_ISA_SCALAR;
+
+  DSPlibArrayKernelsType *DSPlibArrayKernels = &DSPlibKernelTables [DSPLIB_ISA_SCALAR];
+
+  int DSPlibDetectISA ()
+  {
+    int Best = DSPLIB_ISA_SCALAR;
+    char *Cap;
+
+#ifdef DSPLIB_SIMD_X86
+    __builtin_cpu_init ();
+
+    if (__builtin_cpu_supports ("sse2"))    Best = DSPLIB_ISA_SSE2;
+    if (__builtin_cpu_supports ("avx2"))    Best = DSPLIB_ISA_AVX2;
+    if (__builtin_cpu_supports ("avx512f")) Best = DSPLIB_ISA_AVX512;
+#endif
+
+    // Let the environment hold us back (handy for comparing levels without a different machine).
+    if ((Cap = getenv (DSPLIB_ISA_ENVIRONMENT)) != NULL) {
+      for (int Loop = 0; Loop < DSPLIB_ISA_COUNT; Loop++) {
+	if ((strcmp (Cap, DSPlibISANames [Loop]) == 0) && (Loop < Best)) {
+	  Best = Loop;
+	}
+      }
+    }
+
+    return Best;
+  }
+
+  int DSPlibGetISA ()
+  {
+    return DSPlibCurrentISA;
+  }
+
+  int DSPlibSetISA (int ISA)
+  {
+    int Best = DSPlibDetectISA ();
+
+    if (ISA > Best) ISA = Best;
+    if (ISA < DSPLIB_ISA_SCALAR) ISA = DSPLIB_ISA_SCALAR;
+
+    DSPlibCurrentISA   = ISA;
+    DSPlibArrayKernels = DSPlibGetArrayKernels (ISA);
+
+    return ISA;
+  }
+
+  const char *DSPlibISAName (int ISA)
+  {
+    if ((ISA < DSPLIB_ISA_SCALAR) || (ISA >= DSPLIB_ISA_COUNT)) {
+      return "unknown";
+    }
+
+    return DSPlibISANames [ISA];
+  }
+
+  DSPlibArrayKernelsType *DSPlibGetArrayKernels (int ISA)
+  {
+#ifdef DSPLIB_SIMD_X86
+    if ((ISA > DSPLIB_ISA_SCALAR) && (ISA <= DSPlibDetectISA ())) {
+      return &DSPlibKernelTables [ISA];
+    }
+#endif
+
+    return &DSPlibKernelTables [DSPLIB_ISA_SCALAR];
+  }
+
+  // Pick the best level once at startup.
+  static int DSPlibStartupISA = DSPlibSetISA (DSPlibDetectISA ());
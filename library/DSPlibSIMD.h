@@ -0,0 +1,46 @@
+// DSPlibSIMD.h
+//
+// An extension to DSPlib that provides SSE2, AVX2 and AVX-512 versions of the
+// array primitives and picks the best one the CPU supports at run time.
+//
+// The DSPlib array functions (MixArrays, Normalize, ConvertToInts, etc.) call
+// through DSPlibArrayKernels so nothing else has to change to use them.
+
+// The instruction set levels we know about, from slowest to fastest.
+#define		DSPLIB_ISA_SCALAR		0
+#define		DSPLIB_ISA_SSE2			1
+#define		DSPLIB_ISA_AVX2			2
+#define		DSPLIB_ISA_AVX512		3
+
+#define		DSPLIB_ISA_COUNT		4
+
+// Set this environment variable to "scalar", "sse2", "avx2" or "avx512" to
+// cap the level that gets picked at startup.
+#define		DSPLIB_ISA_ENVIRONMENT		"DSPLIB_ISA"
+
+// One set of array kernels.  Every level has a complete set so callers never
+// have to check for a NULL.
+typedef struct {
+  const char *Name;
+
+  void      (*MixArrays2)      (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length);
+  void      (*MixArrays4)      (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length);
+  void      (*MultiplyArrays2) (fftw_real *In1, fftw_real *In2, fftw_real *Out, int Length);
+  void      (*MultiplyArrays4) (fftw_real *In1, fftw_real *In2, fftw_real *In3, fftw_real *In4, fftw_real *Out, int Length);
+  fftw_real (*MaxAbs)          (fftw_real *In, int Length);
+  void      (*DivideArray)     (fftw_real *In, fftw_real Divisor, fftw_real *Out, int Length);
+  void      (*InvertArray)     (fftw_real *Data, int Length);
+  void      (*ConvertToInts)   (fftw_real *Input, short *Output, int Length);
+  void      (*ConvertToReals)  (short *Input, fftw_real *Output, int Length);
+  fftw_real (*DotProduct)      (fftw_real *In1, fftw_real *In2, int Length);
+} DSPlibArrayKernelsType;
+
+// The kernels currently in use.
+extern DSPlibArrayKernelsType *DSPlibArrayKernels;
+
+int  DSPlibDetectISA ();			// The best level this CPU (and OS) can run.
+int  DSPlibGetISA ();				// The level currently in use.
+int  DSPlibSetISA (int ISA);			// Force a level.  Returns the level actually used (capped at DSPlibDetectISA).
+const char *DSPlibISAName (int ISA);		// Printable name of a level.
+
+DSPlibArrayKernelsType *DSPlibGetArrayKernels (int ISA);	// Get a specific set of kernels (for benchmarks).
@@ -0,0 +1,106 @@
+// <BEHOLD the GPL!>
+// ntheory's DSPlibSpectrum, block FFT tone measurement to complement DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+// </BEHOLD>
+
+#include <rfftw.h>
+#include <math.h>
+#include "DSPlib.h"
+#include "DSPlibSpectrum.h"
+
+// Basic constructor
+DSPlibSpectrum::DSPlibSpectrum (int Size, int WindowType, int SamplingRate)
+{
+  this->Size         = Size;
+  this->SamplingRate = SamplingRate;
+
+  this->Window        = new fftw_real [Size];
+  this->Windowed      = new fftw_real [Size];
+  this->Transformed   = new fftw_real [Size];
+  this->PowerSpectrum = new fftw_real [(Size / 2) + 1];
+
+  // Plan once, transform every block with the same plan
+  this->Plan = rfftw_create_plan (Size, FFTW_REAL_TO_COMPLEX, FFTW_ESTIMATE);
+
+  // Fold the 16 bit scaling into the window so Analyze is one multiply per sample
+  CreateWindow (this->Window, Size, WindowType);
+
+  this->WindowGain = 0.0;
+
+  for (int Loop = 0; Loop < Size; Loop++) {
+    this->WindowGain   += this->Window [Loop];
+    this->Window [Loop] /= 32768.0;
+  }
+
+  // A sine wave puts half its amplitude times the sum of the window into its bucket
+  this->WindowGain /= 2.0;
+
+  for (int Loop = 0; Loop <= Size / 2; Loop++) {
+    this->PowerSpectrum [Loop] = 0.0;
+  }
+}
+
+DSPlibSpectrum::~DSPlibSpectrum ()
+{
+  rfftw_destroy_plan (this->Plan);
+
+  delete [] this->Window;
+  delete [] this->Windowed;
+  delete [] this->Transformed;
+  delete [] this->PowerSpectrum;
+}
+
+void DSPlibSpectrum::Analyze (short *In)
+{
+  for (int Loop = 0; Loop < this->Size; Loop++) {
+    this->Windowed [Loop] = (fftw_real) In [Loop] * this->Window [Loop];
+  }
+
+  rfftw_one (this->Plan, this->Windowed, this->Transformed);
+
+  CalculatePowerSpectrum (this->Transformed, this->PowerSpectrum, this->Size);
+}
+
+void DSPlibSpectrum::Analyze (fftw_real *In)
+{
+  MultiplyArrays (In, this->Window, this->Windowed, this->Size);
+
+  rfftw_one (this->Plan, this->Windowed, this->Transformed);
+
+  CalculatePowerSpectrum (this->Transformed, this->PowerSpectrum, this->Size);
+}
+
+int DSPlibSpectrum::GetBucket (double Frequency)
+{
+  return (int) floor ((Frequency * (double) this->Size / (double) this->SamplingRate) + 0.5);
+}
+
+fftw_real DSPlibSpectrum::GetPower (double Frequency)
+{
+  int Bucket = this->GetBucket (Frequency);
+
+  if ((Bucket < 0) || (Bucket > this->Size / 2)) {
+    return 0.0;
+  }
+
+  return this->PowerSpectrum [Bucket];
+}
+
+fftw_real DSPlibSpectrum::GetAmplitude (double Frequency)
+{
+  return sqrt (this->GetPower (Frequency)) / this->WindowGain;
+}
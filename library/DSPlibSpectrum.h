@@ -0,0 +1,47 @@
+// DSPlibSpectrum.h
+//
+// An extension to DSPlib to measure tones from one real FFT per block instead
+// of running a filter per tone.
+//
+// The plan, the window and every buffer are made once in the constructor and
+// reused for every block, so Analyze is just a multiply, rfftw_one and
+// CalculatePowerSpectrum.  After that any number of frequencies can be read
+// out of the same spectrum.
+
+class DSPlibSpectrum {
+  public:
+    // Basic constructor.  WindowType is one of the DSPLIB_WINDOW_* shapes.
+    DSPlibSpectrum (int Size, int WindowType, int SamplingRate);
+
+    // Destructor
+    ~DSPlibSpectrum ();
+
+    // Window and transform Size samples.  The input is in the same 16 bit
+    // range DSPlibFilter takes.
+    void Analyze (short *In);
+    void Analyze (fftw_real *In);
+
+    // Read the last block's spectrum at the bucket nearest to Frequency.
+    // GetPower is the raw power in the bucket, GetAmplitude is the peak
+    // amplitude (-1 to 1 is full scale) of a sine wave sitting in it.  Both
+    // are zero above the Nyquist frequency.
+    fftw_real GetPower     (double Frequency);
+    fftw_real GetAmplitude (double Frequency);
+
+    // The bucket nearest to Frequency.
+    int GetBucket (double Frequency);
+
+  private:
+    int Size;
+    int SamplingRate;
+
+    rfftw_plan Plan;
+
+    fftw_real *Window;
+    fftw_real *Windowed;
+    fftw_real *Transformed;
+    fftw_real *PowerSpectrum;
+
+    // What a sine wave of amplitude one comes out as in its bucket
+    double WindowGain;
+};
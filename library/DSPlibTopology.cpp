@@ -0,0 +1,317 @@
+// <BEHOLD the GPL!>
+// ntheory's DSPlibTopology, CPU and NUMA layout and thread pinning to complement DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sched.h>
+#include <pthread.h>
+#include "DSPlibTopology.h"
+
+#define		DSPLIB_TOPOLOGY_CPU_PATH	"/sys/devices/system/cpu"
+
+// Read a number out of a file in /sys.  Returns Default if it isn't there.
+static int GetNumber (int CPU, const char *Name, int Default)
+{
+  char FileName [256];
+  FILE *File;
+  int Number;
+
+  snprintf (FileName, sizeof (FileName), DSPLIB_TOPOLOGY_CPU_PATH "/cpu%d/topology/%s", CPU, Name);
+
+  if ((File = fopen (FileName, "r")) == NULL) {
+    return Default;
+  }
+
+  if (fscanf (File, "%d", &Number) != 1) {
+    Number = Default;
+  }
+
+  fclose (File);
+
+  return Number;
+}
+
+// A CPU's directory has a "nodeN" link to the node it's on.  Machines without NUMA don't have one.
+static int GetNodeOf (int CPU)
+{
+  char DirectoryName [256];
+  struct dirent *Entry;
+  DIR *Directory;
+  int Node = 0;
+
+  snprintf (DirectoryName, sizeof (DirectoryName), DSPLIB_TOPOLOGY_CPU_PATH "/cpu%d", CPU);
+
+  if ((Directory = opendir (DirectoryName)) == NULL) {
+    return 0;
+  }
+
+  while ((Entry = readdir (Directory)) != NULL) {
+    if ((strncmp (Entry->d_name, "node", 4) == 0) && (sscanf (&Entry->d_name [4], "%d", &Node) == 1)) {
+      break;
+    }
+  }
+
+  closedir (Directory);
+
+  return Node;
+}
+
+// Basic constructor
+DSPlibTopology::DSPlibTopology ()
+{
+  int NodeOf [DSPLIB_TOPOLOGY_MAX_CPUS], CoreOf [DSPLIB_TOPOLOGY_MAX_CPUS];
+  cpu_set_t Allowed;
+  bool HaveMask;
+
+  this->CPUs        = new int  [DSPLIB_TOPOLOGY_MAX_CPUS];
+  this->Nodes       = new int  [DSPLIB_TOPOLOGY_MAX_CPUS];
+  this->Packages    = new int  [DSPLIB_TOPOLOGY_MAX_CPUS];
+  this->FirstOnCore = new bool [DSPLIB_TOPOLOGY_MAX_CPUS];
+  this->NodeNumbers = new int  [DSPLIB_TOPOLOGY_MAX_CPUS];
+
+  this->CPUCount     = 0;
+  this->NodeCount    = 0;
+  this->PackageCount = 0;
+
+  // Only the CPUs we're allowed on
+  CPU_ZERO (&Allowed);
+  HaveMask = (sched_getaffinity (0, sizeof (Allowed), &Allowed) == 0);
+
+  for (int CPU = 0; CPU < DSPLIB_TOPOLOGY_MAX_CPUS; CPU++) {
+    if (HaveMask ? !CPU_ISSET (CPU, &Allowed) : (CPU >= sysconf (_SC_NPROCESSORS_ONLN))) {
+      continue;
+    }
+
+    this->CPUs     [this->CPUCount] = CPU;
+    this->Packages [this->CPUCount] = GetNumber (CPU, "physical_package_id", 0);
+    NodeOf         [this->CPUCount] = GetNodeOf (CPU);
+    CoreOf         [this->CPUCount] = GetNumber (CPU, "core_id", CPU);
+
+    this->CPUCount++;
+  }
+
+  // Number the nodes in order and count the sockets
+  for (int Loop = 0; Loop < this->CPUCount; Loop++) {
+    int Node, Package;
+
+    for (Node = 0; (Node < this->NodeCount) && (this->NodeNumbers [Node] != NodeOf [Loop]); Node++);
+
+    if (Node == this->NodeCount) {
+      // Keep them sorted so node 0 comes first
+      for (Node = this->NodeCount; (Node > 0) && (this->NodeNumbers [Node - 1] > NodeOf [Loop]); Node--) {
+	this->NodeNumbers [Node] = this->NodeNumbers [Node - 1];
+      }
+
+      this->NodeNumbers [Node] = NodeOf [Loop];
+      this->NodeCount++;
+    }
+
+    for (Package = 0; (Package < Loop) && (this->Packages [Package] != this->Packages [Loop]); Package++);
+
+    if (Package == Loop) {
+      this->PackageCount++;
+    }
+  }
+
+  for (int Loop = 0; Loop < this->CPUCount; Loop++) {
+    for (int Node = 0; Node < this->NodeCount; Node++) {
+      if (this->NodeNumbers [Node] == NodeOf [Loop]) {
+	this->Nodes [Loop] = Node;
+      }
+    }
+  }
+
+  // A core is a socket and a core number.  The first CPU we see on each one is the one that gets a worker first.
+  for (int Loop = 0; Loop < this->CPUCount; Loop++) {
+    this->FirstOnCore [Loop] = true;
+
+    for (int Other = 0; Other < Loop; Other++) {
+      if ((this->Packages [Other] == this->Packages [Loop]) && (CoreOf [Other] == CoreOf [Loop])) {
+	this->FirstOnCore [Loop] = false;
+      }
+    }
+  }
+
+  this->Order ();
+}
+
+DSPlibTopology::~DSPlibTopology ()
+{
+  delete [] this->CPUs;
+  delete [] this->Nodes;
+  delete [] this->Packages;
+  delete [] this->FirstOnCore;
+  delete [] this->NodeNumbers;
+}
+
+void DSPlibTopology::Order ()
+{
+  int  *CPUs        = new int  [this->CPUCount];
+  int  *Nodes       = new int  [this->CPUCount];
+  int  *Packages    = new int  [this->CPUCount];
+  bool *FirstOnCore = new bool [this->CPUCount];
+  bool *Taken       = new bool [this->CPUCount];
+  int Count = 0;
+
+  memset (Taken, 0, this->CPUCount * sizeof (bool));
+
+  // First a CPU from every core, then the rest.  Each time round the nodes take one each.
+  for (int Pass = 0; Pass < 2; Pass++) {
+    bool Found = true;
+
+    while (Found) {
+      Found = false;
+
+      for (int Node = 0; Node < this->NodeCount; Node++) {
+	for (int Loop = 0; Loop < this->CPUCount; Loop++) {
+	  if (!Taken [Loop] && (this->Nodes [Loop] == Node) && ((Pass == 1) || this->FirstOnCore [Loop])) {
+	    CPUs        [Count] = this->CPUs [Loop];
+	    Nodes       [Count] = this->Nodes [Loop];
+	    Packages    [Count] = this->Packages [Loop];
+	    FirstOnCore [Count] = this->FirstOnCore [Loop];
+
+	    Taken [Loop] = true;
+	    Found        = true;
+	    Count++;
+	    break;
+	  }
+	}
+      }
+    }
+  }
+
+  memcpy (this->CPUs,        CPUs,        Count * sizeof (int));
+  memcpy (this->Nodes,       Nodes,       Count * sizeof (int));
+  memcpy (this->Packages,    Packages,    Count * sizeof (int));
+  memcpy (this->FirstOnCore, FirstOnCore, Count * sizeof (bool));
+
+  delete [] CPUs;
+  delete [] Nodes;
+  delete [] Packages;
+  delete [] FirstOnCore;
+  delete [] Taken;
+}
+
+int DSPlibTopology::GetCPUCount ()
+{
+  return this->CPUCount;
+}
+
+int DSPlibTopology::GetNodeCount ()
+{
+  return this->NodeCount;
+}
+
+int DSPlibTopology::GetPackageCount ()
+{
+  return this->PackageCount;
+}
+
+int DSPlibTopology::GetCPU (int Index)
+{
+  return this->CPUs [Index];
+}
+
+int DSPlibTopology::GetNode (int Index)
+{
+  return this->Nodes [Index];
+}
+
+int DSPlibTopology::GetPackage (int Index)
+{
+  return this->Packages [Index];
+}
+
+bool DSPlibTopology::IsFirstOnCore (int Index)
+{
+  return this->FirstOnCore [Index];
+}
+
+int DSPlibTopology::GetNodeNumber (int Node)
+{
+  return this->NodeNumbers [Node];
+}
+
+bool DSPlibTopology::KeepNode (int Node)
+{
+  int Count = 0;
+
+  if ((Node < 0) || (Node >= this->NodeCount)) {
+    return false;
+  }
+
+  // The order stays the same, just without the other nodes' CPUs
+  for (int Loop = 0; Loop < this->CPUCount; Loop++) {
+    if (this->Nodes [Loop] == Node) {
+      this->CPUs        [Count] = this->CPUs [Loop];
+      this->Nodes       [Count] = this->Nodes [Loop];
+      this->Packages    [Count] = this->Packages [Loop];
+      this->FirstOnCore [Count] = this->FirstOnCore [Loop];
+      Count++;
+    }
+  }
+
+  this->CPUCount = Count;
+
+  // That node is the only one left, so it's node 0 now, and only its sockets count
+  this->NodeNumbers [0] = this->NodeNumbers [Node];
+  this->NodeCount       = 1;
+  this->PackageCount    = 0;
+
+  for (int Loop = 0; Loop < this->CPUCount; Loop++) {
+    int Package;
+
+    this->Nodes [Loop] = 0;
+
+    for (Package = 0; (Package < Loop) && (this->Packages [Package] != this->Packages [Loop]); Package++);
+
+    if (Package == Loop) {
+      this->PackageCount++;
+    }
+  }
+
+  return true;
+}
+
+bool DSPlibTopology::Pin (int Index)
+{
+  cpu_set_t Set;
+
+  CPU_ZERO (&Set);
+  CPU_SET (this->CPUs [Index], &Set);
+
+  return (pthread_setaffinity_np (pthread_self (), sizeof (Set), &Set) == 0);
+}
+
+int DSPlibTopology::GetCurrentNode ()
+{
+  int CPU = sched_getcpu ();
+
+  for (int Loop = 0; Loop < this->CPUCount; Loop++) {
+    if (this->CPUs [Loop] == CPU) {
+      return this->Nodes [Loop];
+    }
+  }
+
+  return -1;
+}
@@ -0,0 +1,71 @@
+// DSPlibTopology.h
+//
+// An extension to DSPlib to find out how the machine's CPUs are laid out
+// (which NUMA node, socket and core each one is on) and to pin threads to
+// them.
+//
+// On a machine with more than one socket, memory belongs to the node of the
+// thread that first writes to it.  A worker that's pinned to one CPU and
+// makes its own filters, histories and buffers gets all of them from its own
+// node, where an unpinned one can end up reading everything across the link
+// to the other socket.
+//
+// Everything comes from /sys/devices/system/cpu (only the CPUs this process
+// is allowed to run on count, so taskset and numactl still work).  If that
+// isn't there every CPU is its own core on one node and one socket.
+
+// The most CPUs we keep track of
+#define		DSPLIB_TOPOLOGY_MAX_CPUS	1024
+
+class DSPlibTopology {
+  public:
+    // Basic constructor.  Reads the layout.
+    DSPlibTopology ();
+
+    // Destructor
+    ~DSPlibTopology ();
+
+    // How many CPUs, NUMA nodes and sockets there are.
+    int GetCPUCount     ();
+    int GetNodeCount    ();
+    int GetPackageCount ();
+
+    // The CPUs are kept in the order workers should be put on them: one
+    // per physical core, taking turns between the nodes, and then the
+    // second hyperthread of each core in the same order.  Index is a place
+    // in that order.  GetNode is a node's place in the node list (0 to
+    // GetNodeCount () - 1), and GetNodeNumber turns that into the number
+    // the kernel gives it.
+    int  GetCPU        (int Index);
+    int  GetNode       (int Index);
+    int  GetPackage    (int Index);
+    bool IsFirstOnCore (int Index);
+    int  GetNodeNumber (int Node);
+
+    // Only keep the CPUs on one node (a place in the node list), which
+    // becomes the only node in the list.  Returns false (and keeps
+    // everything) if there isn't one.
+    bool KeepNode (int Node);
+
+    // Pin the calling thread to the CPU at Index.  Returns false if it
+    // couldn't be.
+    bool Pin (int Index);
+
+    // Where the calling thread is running: its node's place in the node
+    // list, or -1 if it's somewhere we don't know about.
+    int GetCurrentNode ();
+
+  private:
+    int  CPUCount;
+    int *CPUs;
+    int *Nodes;
+    int *Packages;
+    bool *FirstOnCore;
+
+    int  NodeCount;
+    int *NodeNumbers;
+    int  PackageCount;
+
+    // Put the CPUs in the order above
+    void Order ();
+};
@@ -0,0 +1,405 @@
+// <BEHOLD the GPL!>
+// ntheory's DSPlibTrace, binary traces to complement DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+// </BEHOLD>
+
+#include <rfftw.h>
+#include <stdio.h>
+#include <string.h>
+#include "DSPlibTrace.h"
+
+#define		DSPLIB_TRACE_MAGIC		"DSPT"
+#define		DSPLIB_TRACE_VERSION		1
+
+// Little endian helpers ----------------------------------------------------------------------------------------------
+//   Notes:
+//     The floats in a block are written with one fwrite straight from the buffer when the machine is little endian
+//       already, and byte swapped in place around the fwrite (or after the fread) when it isn't.
+// --------------------------------------------------------------------------------------------------------------------
+
+static bool IsLittleEndian ()
+{
+  unsigned int One = 1;
+
+  return (*(unsigned char *) &One == 1);
+}
+
+static void SwapWords (float *Values, long Count)
+{
+  unsigned char *Bytes = (unsigned char *) Values, Swap;
+
+  for (long Loop = 0; Loop < Count * 4; Loop += 4) {
+    Swap = Bytes [Loop];     Bytes [Loop]     = Bytes [Loop + 3]; Bytes [Loop + 3] = Swap;
+    Swap = Bytes [Loop + 1]; Bytes [Loop + 1] = Bytes [Loop + 2]; Bytes [Loop + 2] = Swap;
+  }
+}
+
+static bool PutWord (FILE *File, unsigned int Word)
+{
+  unsigned char Bytes [4] = { (unsigned char) Word, (unsigned char) (Word >> 8),
+			      (unsigned char) (Word >> 16), (unsigned char) (Word >> 24) };
+
+  return (fwrite (Bytes, 1, 4, File) == 4);
+}
+
+static bool GetWord (FILE *File, unsigned int *Word)
+{
+  unsigned char Bytes [4];
+
+  if (fread (Bytes, 1, 4, File) != 4) {
+    return false;
+  }
+
+  *Word = Bytes [0] | (Bytes [1] << 8) | (Bytes [2] << 16) | ((unsigned int) Bytes [3] << 24);
+
+  return true;
+}
+
+static bool PutString (FILE *File, const char *String)
+{
+  unsigned int Length = (String != NULL) ? strlen (String) : 0;
+
+  return PutWord (File, Length) && (fwrite (String, 1, Length, File) == Length);
+}
+
+static char *GetString (FILE *File)
+{
+  unsigned int Length;
+  char *String;
+
+  // Nothing in a header should be anywhere near this long
+  if (!GetWord (File, &Length) || (Length > 65536)) {
+    return NULL;
+  }
+
+  String = new char [Length + 1];
+
+  if (fread (String, 1, Length, File) != Length) {
+    delete [] String;
+    return NULL;
+  }
+
+  String [Length] = '\0';
+
+  return String;
+}
+
+// Basic constructor
+DSPlibTraceWriter::DSPlibTraceWriter (const char *FileName, int ColumnCount, const char **ColumnNames, double RowRate,
+				      const char *Comment)
+{
+  float Rate = (float) RowRate;
+  unsigned int Word;
+
+  this->ColumnCount  = ColumnCount;
+  this->Buffer       = new float [ColumnCount * DSPLIB_TRACE_BLOCK_ROWS];
+  this->BufferedRows = 0;
+
+  this->File = fopen (FileName, "wb");
+  this->Good = (this->File != NULL);
+
+  if (!this->Good) {
+    return;
+  }
+
+  memcpy (&Word, &Rate, sizeof (Word));
+
+  this->Good = (fwrite (DSPLIB_TRACE_MAGIC, 1, 4, this->File) == 4) &&
+	       PutWord (this->File, DSPLIB_TRACE_VERSION) && PutWord (this->File, Word) &&
+	       PutWord (this->File, ColumnCount);
+
+  for (int Column = 0; Column < ColumnCount; Column++) {
+    this->Good = this->Good && PutString (this->File, ColumnNames [Column]);
+  }
+
+  this->Good = this->Good && PutString (this->File, Comment);
+}
+
+DSPlibTraceWriter::~DSPlibTraceWriter ()
+{
+  if (this->File != NULL) {
+    this->Flush ();
+    fclose (this->File);
+  }
+
+  delete [] this->Buffer;
+}
+
+bool DSPlibTraceWriter::IsGood ()
+{
+  return this->Good;
+}
+
+void DSPlibTraceWriter::PutRow (fftw_real *Row)
+{
+  for (int Column = 0; Column < this->ColumnCount; Column++) {
+    this->Buffer [Column * DSPLIB_TRACE_BLOCK_ROWS + this->BufferedRows] = (float) Row [Column];
+  }
+
+  if (++this->BufferedRows == DSPLIB_TRACE_BLOCK_ROWS) {
+    this->Flush ();
+  }
+}
+
+void DSPlibTraceWriter::PutColumns (float **Columns, int Rows)
+{
+  int Done = 0, Count;
+
+  while (Done < Rows) {
+    Count = DSPLIB_TRACE_BLOCK_ROWS - this->BufferedRows;
+
+    if (Count > (Rows - Done)) {
+      Count = Rows - Done;
+    }
+
+    for (int Column = 0; Column < this->ColumnCount; Column++) {
+      memcpy (&this->Buffer [Column * DSPLIB_TRACE_BLOCK_ROWS + this->BufferedRows], &Columns [Column][Done],
+	      Count * sizeof (float));
+    }
+
+    Done += Count;
+
+    if ((this->BufferedRows += Count) == DSPLIB_TRACE_BLOCK_ROWS) {
+      this->Flush ();
+    }
+  }
+}
+
+void DSPlibTraceWriter::Flush ()
+{
+  if ((this->File == NULL) || (this->BufferedRows == 0)) {
+    return;
+  }
+
+  this->Good = this->Good && PutWord (this->File, this->BufferedRows);
+
+  for (int Column = 0; Column < this->ColumnCount; Column++) {
+    float *Values = &this->Buffer [Column * DSPLIB_TRACE_BLOCK_ROWS];
+
+    if (!IsLittleEndian ()) {
+      SwapWords (Values, this->BufferedRows);
+    }
+
+    this->Good = this->Good && (fwrite (Values, sizeof (float), this->BufferedRows, this->File) == (size_t) this->BufferedRows);
+  }
+
+  this->BufferedRows = 0;
+}
+
+// Basic constructor
+DSPlibTraceReader::DSPlibTraceReader (const char *FileName)
+{
+  char Magic [4];
+  unsigned int Version, Word;
+  long Offset, End;
+  float Rate;
+
+  this->ColumnCount  = 0;
+  this->ColumnNames  = NULL;
+  this->RowRate      = 0.0;
+  this->Comment      = NULL;
+  this->BlockCount   = 0;
+  this->BlockOffsets = NULL;
+  this->BlockRows    = NULL;
+  this->Buffer       = NULL;
+
+  this->File = fopen (FileName, "rb");
+  this->Good = false;
+
+  if (this->File == NULL) {
+    return;
+  }
+
+  if ((fread (Magic, 1, 4, this->File) != 4) || (memcmp (Magic, DSPLIB_TRACE_MAGIC, 4) != 0) ||
+      !GetWord (this->File, &Version) || (Version != DSPLIB_TRACE_VERSION) ||
+      !GetWord (this->File, &Word) || !GetWord (this->File, (unsigned int *) &this->ColumnCount) ||
+      (this->ColumnCount < 0) || (this->ColumnCount > 65536)) {
+    return;
+  }
+
+  memcpy (&Rate, &Word, sizeof (Rate));
+  this->RowRate = Rate;
+
+  this->ColumnNames = new char * [this->ColumnCount];
+
+  for (int Column = 0; Column < this->ColumnCount; Column++) {
+    this->ColumnNames [Column] = NULL;
+  }
+
+  for (int Column = 0; Column < this->ColumnCount; Column++) {
+    if ((this->ColumnNames [Column] = GetString (this->File)) == NULL) {
+      return;
+    }
+  }
+
+  if ((this->Comment = GetString (this->File)) == NULL) {
+    return;
+  }
+
+  // Walk the blocks twice (once to count them, once to fill in where they are) just reading their row counts.  A
+  // block that's been cut short (a trace that's still being written, say) and everything after it is left out.  A
+  // block with more rows than the writer ever puts in one isn't a trace at all, and GetRows couldn't read it anyway.
+  Offset = ftell (this->File);
+
+  fseek (this->File, 0, SEEK_END);
+  End = ftell (this->File);
+
+  for (int Pass = 0; Pass < 2; Pass++) {
+    long Position = Offset, Rows = 0;
+
+    this->BlockCount = 0;
+
+    while (true) {
+      fseek (this->File, Position, SEEK_SET);
+
+      if (!GetWord (this->File, &Word) || (Word == 0) ||
+	  ((Position + 4 + (long) Word * this->ColumnCount * (long) sizeof (float)) > End)) {
+	break;
+      }
+
+      if (Word > DSPLIB_TRACE_BLOCK_ROWS) {
+	return;
+      }
+
+      if (Pass == 1) {
+	this->BlockOffsets [this->BlockCount] = Position;
+	this->BlockRows    [this->BlockCount] = Rows;
+      }
+
+      this->BlockCount++;
+
+      Position += 4 + (long) Word * this->ColumnCount * (long) sizeof (float);
+      Rows     += Word;
+    }
+
+    if (Pass == 0) {
+      this->BlockOffsets = new long [this->BlockCount + 1];
+      this->BlockRows    = new long [this->BlockCount + 1];
+    }
+    else {
+      this->BlockOffsets [this->BlockCount] = Position;
+      this->BlockRows    [this->BlockCount] = Rows;
+    }
+  }
+
+  this->Buffer = new float [DSPLIB_TRACE_BLOCK_ROWS];
+  this->Good   = true;
+}
+
+DSPlibTraceReader::~DSPlibTraceReader ()
+{
+  if (this->File != NULL) {
+    fclose (this->File);
+  }
+
+  if (this->ColumnNames != NULL) {
+    for (int Column = 0; Column < this->ColumnCount; Column++) {
+      delete [] this->ColumnNames [Column];
+    }
+  }
+
+  delete [] this->ColumnNames;
+  delete [] this->Comment;
+  delete [] this->BlockOffsets;
+  delete [] this->BlockRows;
+  delete [] this->Buffer;
+}
+
+bool DSPlibTraceReader::IsGood ()
+{
+  return this->Good;
+}
+
+int DSPlibTraceReader::GetColumnCount ()
+{
+  return this->ColumnCount;
+}
+
+const char *DSPlibTraceReader::GetColumnName (int Column)
+{
+  return this->ColumnNames [Column];
+}
+
+int DSPlibTraceReader::FindColumn (const char *Name)
+{
+  for (int Column = 0; Column < this->ColumnCount; Column++) {
+    if (strcmp (this->ColumnNames [Column], Name) == 0) {
+      return Column;
+    }
+  }
+
+  return -1;
+}
+
+double DSPlibTraceReader::GetRowRate ()
+{
+  return this->RowRate;
+}
+
+const char *DSPlibTraceReader::GetComment ()
+{
+  return this->Comment;
+}
+
+long DSPlibTraceReader::GetRowCount ()
+{
+  return this->BlockRows [this->BlockCount];
+}
+
+long DSPlibTraceReader::GetRows (long FirstRow, long RowCount, float **Columns)
+{
+  long LastRow = FirstRow + RowCount, Rows, Start, Count;
+
+  if (FirstRow < 0) {
+    FirstRow = 0;
+  }
+
+  if (LastRow > this->GetRowCount ()) {
+    LastRow = this->GetRowCount ();
+  }
+
+  for (long Block = 0; Block < this->BlockCount; Block++) {
+    // Skip the blocks that are all before or after the slice
+    if ((this->BlockRows [Block + 1] <= FirstRow) || (this->BlockRows [Block] >= LastRow)) {
+      continue;
+    }
+
+    Rows  = this->BlockRows [Block + 1] - this->BlockRows [Block];
+    Start = ((FirstRow > this->BlockRows [Block]) ? FirstRow : this->BlockRows [Block]) - this->BlockRows [Block];
+    Count = (((LastRow < this->BlockRows [Block + 1]) ? LastRow : this->BlockRows [Block + 1]) - this->BlockRows [Block]) - Start;
+
+    for (int Column = 0; Column < this->ColumnCount; Column++) {
+      if (Columns [Column] == NULL) {
+	continue;
+      }
+
+      fseek (this->File, this->BlockOffsets [Block] + 4 + ((Column * Rows) + Start) * (long) sizeof (float), SEEK_SET);
+
+      if (fread (this->Buffer, sizeof (float), Count, this->File) != (size_t) Count) {
+	return 0;
+      }
+
+      if (!IsLittleEndian ()) {
+	SwapWords (this->Buffer, Count);
+      }
+
+      memcpy (&Columns [Column][this->BlockRows [Block] + Start - FirstRow], this->Buffer, Count * sizeof (float));
+    }
+  }
+
+  return (LastRow > FirstRow) ? (LastRow - FirstRow) : 0;
+}
@@ -0,0 +1,96 @@
+// DSPlibTrace.h
+//
+// An extension to DSPlib to save long runs of numbers (filter outputs, band
+// powers, decisions) in a compact binary file instead of one line of text
+// per sample, and to read any slice of them back.
+//
+// A trace is a table: a fixed set of named columns of 32 bit floats and as
+// many rows as get written.  The file is a header followed by blocks of up to
+// DSPLIB_TRACE_BLOCK_ROWS rows, each one a row count and then every column's
+// values for those rows one after another.  Everything is little endian:
+//
+//   "DSPT", version                              4 bytes, 32 bit integer
+//   row rate                                     32 bit float (rows per second, 0 if they aren't evenly spaced)
+//   column count, then each column's name        32 bit integer, then a 32 bit length and the characters
+//   comment                                      32 bit length and the characters
+//   blocks until the end of the file             32 bit row count, then the columns as 32 bit floats
+//
+// Rows go into a block sized buffer and only get written a whole block at a
+// time, so writing a trace costs about the same as copying the numbers.
+
+// The most rows in one block (and in the writer's buffer).
+#define		DSPLIB_TRACE_BLOCK_ROWS		4096
+
+class DSPlibTraceWriter {
+  public:
+    // Basic constructor.  Creates FileName and writes the header.  Comment
+    // can be NULL.
+    DSPlibTraceWriter (const char *FileName, int ColumnCount, const char **ColumnNames, double RowRate, const char *Comment);
+
+    // Destructor (writes whatever's still buffered and closes the file)
+    ~DSPlibTraceWriter ();
+
+    // False if the file couldn't be created or a write failed.
+    bool IsGood ();
+
+    // Add one row (a value for every column).
+    void PutRow (fftw_real *Row);
+
+    // Add Rows rows straight from columns (Columns [Column][Row]).
+    void PutColumns (float **Columns, int Rows);
+
+    // Write out whatever's buffered as a block.
+    void Flush ();
+
+  private:
+    FILE *File;
+    bool  Good;
+
+    int    ColumnCount;
+    float *Buffer;									// Buffer [Column * DSPLIB_TRACE_BLOCK_ROWS + Row]
+    int    BufferedRows;
+};
+
+class DSPlibTraceReader {
+  public:
+    // Basic constructor.  Reads the header and finds every block.
+    DSPlibTraceReader (const char *FileName);
+
+    // Destructor
+    ~DSPlibTraceReader ();
+
+    // False if the file couldn't be opened or isn't a trace.
+    bool IsGood ();
+
+    // What the writer said about the columns.  FindColumn returns -1 if
+    // there's no column called Name.
+    int         GetColumnCount ();
+    const char *GetColumnName  (int Column);
+    int         FindColumn     (const char *Name);
+    double      GetRowRate     ();
+    const char *GetComment     ();
+
+    long        GetRowCount    ();
+
+    // Read RowCount rows starting at FirstRow into Columns [Column][Row]
+    // (NULL to skip a column).  Only the blocks the rows are in get read.
+    // Returns how many rows there were.
+    long GetRows (long FirstRow, long RowCount, float **Columns);
+
+  private:
+    FILE *File;
+    bool  Good;
+
+    int    ColumnCount;
+    char **ColumnNames;
+    double RowRate;
+    char  *Comment;
+
+    // Where each block starts in the file and the number of its first row
+    // (there's one extra entry at the end with the total row count)
+    long  BlockCount;
+    long *BlockOffsets;
+    long *BlockRows;
+
+    float *Buffer;
+};
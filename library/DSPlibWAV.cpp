@@ -0,0 +1,256 @@
+// <BEHOLD the GPL!>
+// ntheory's DSPlibWAV, a seeking WAV reader to complement DSPlib
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+// </BEHOLD>
+
+#include <stdio.h>
+#include <string.h>
+#include "DSPlib.h"
+#include "DSPlibWAV.h"
+
+// The format tags for plain PCM and for the "extensible" header (which has the real tag at the start of its
+// sub-format GUID)
+#define		DSPLIB_WAV_PCM			0x0001
+#define		DSPLIB_WAV_EXTENSIBLE		0xFFFE
+
+// How many frames get read from the file at a time
+#define		DSPLIB_WAV_READ_FRAMES		4096
+
+static unsigned long GetLittleEndian (unsigned char *Bytes, int Count)
+{
+  unsigned long Value = 0;
+
+  for (int Loop = Count - 1; Loop >= 0; Loop--) {
+    Value = (Value << 8) | Bytes [Loop];
+  }
+
+  return Value;
+}
+
+// Basic constructor
+DSPlibWAVReader::DSPlibWAVReader (char *FileName)
+{
+  unsigned char Header [12], Chunk [8], Format [40];
+  unsigned long ChunkSize, DataSize = 0, FileSize;
+  long Position;
+  int Tag = 0, Bits = 0;
+  bool HaveFormat = false, HaveData = false;
+
+  this->FileName       = FileName;
+  this->Good           = false;
+  this->Rate           = 0;
+  this->Channels       = 0;
+  this->BytesPerSample = 0;
+  this->Direct         = false;
+  this->DataOffset     = 0;
+  this->SampleCount    = 0;
+  this->Loaded         = NULL;
+  this->Bytes          = NULL;
+  this->BytesLength    = 0;
+
+  this->File = fopen (FileName, "rb");
+
+  if (this->File == NULL) {
+    return;
+  }
+
+  fseek (this->File, 0, SEEK_END);
+  FileSize = ftell (this->File);
+  fseek (this->File, 0, SEEK_SET);
+
+  if ((fread (Header, 1, 12, this->File) != 12) || (memcmp (Header, "RIFF", 4) != 0) ||
+      (memcmp (&Header [8], "WAVE", 4) != 0)) {
+    return;
+  }
+
+  // Walk the chunks until we've seen the format and found the data.  Chunks are padded to an even length.
+  Position = 12;
+
+  while (!HaveData && (fread (Chunk, 1, 8, this->File) == 8)) {
+    ChunkSize = GetLittleEndian (&Chunk [4], 4);
+
+    if ((memcmp (Chunk, "fmt ", 4) == 0) && (ChunkSize >= 16)) {
+      memset (Format, 0, sizeof (Format));
+
+      if (fread (Format, 1, (ChunkSize < sizeof (Format)) ? ChunkSize : sizeof (Format), this->File) < 16) {
+	return;
+      }
+
+      Tag            = GetLittleEndian (&Format [0], 2);
+      this->Channels = GetLittleEndian (&Format [2], 2);
+      this->Rate     = GetLittleEndian (&Format [4], 4);
+      Bits           = GetLittleEndian (&Format [14], 2);
+
+      if ((Tag == DSPLIB_WAV_EXTENSIBLE) && (ChunkSize >= 26)) {
+	Tag = GetLittleEndian (&Format [24], 2);
+      }
+
+      HaveFormat = true;
+    }
+    else if (memcmp (Chunk, "data", 4) == 0) {
+      // A file that was still being written can have a size of zero (or anything else) here, so don't believe it if
+      // it goes past the end of the file.  One that's too big to say (DSPLIB_WAV_TO_END) goes to the end as well.
+      this->DataOffset = Position + 8;
+      DataSize         = ChunkSize;
+
+      if ((DataSize == 0) || (DataSize == DSPLIB_WAV_TO_END) || ((this->DataOffset + DataSize) > FileSize)) {
+	DataSize = FileSize - this->DataOffset;
+      }
+
+      HaveData = true;
+    }
+
+    Position += 8 + ChunkSize + (ChunkSize & 1);
+    fseek (this->File, Position, SEEK_SET);
+  }
+
+  if (!HaveFormat || !HaveData || (this->Channels < 1) || (this->Rate < 1)) {
+    return;
+  }
+
+  this->Direct = (Tag == DSPLIB_WAV_PCM) && ((Bits == 8) || (Bits == 16) || (Bits == 24) || (Bits == 32));
+
+  if (this->Direct) {
+    this->BytesPerSample = Bits / 8;
+    this->SampleCount    = DataSize / (this->BytesPerSample * this->Channels);
+    this->BytesLength    = DSPLIB_WAV_READ_FRAMES * this->BytesPerSample * this->Channels;
+    this->Bytes          = new unsigned char [this->BytesLength];
+  }
+  else {
+    // Let SDL decode the whole thing
+    SDL_AudioSpec *AudioSpec;
+    unsigned char *AudioBuffer = NULL;
+    unsigned long  AudioBufferLength = 0;
+
+    if ((AudioSpec = GetSoundDataFromWAV (FileName, DSPLIB_ANY_RATE, &AudioBuffer, &AudioBufferLength)) == NULL) {
+      return;
+    }
+
+    this->Rate        = AudioSpec->freq;
+    this->SampleCount = AudioBufferLength / sizeof (short);
+    this->Loaded      = new short [this->SampleCount + 1];
+
+    memcpy (this->Loaded, AudioBuffer, this->SampleCount * sizeof (short));
+
+    free (AudioBuffer);
+    delete AudioSpec;
+  }
+
+  this->Good = true;
+}
+
+DSPlibWAVReader::~DSPlibWAVReader ()
+{
+  if (this->File != NULL) {
+    fclose (this->File);
+  }
+
+  delete [] this->Loaded;
+  delete [] this->Bytes;
+}
+
+bool DSPlibWAVReader::IsGood ()
+{
+  return this->Good;
+}
+
+int DSPlibWAVReader::GetRate ()
+{
+  return this->Rate;
+}
+
+unsigned long DSPlibWAVReader::GetSampleCount ()
+{
+  return this->SampleCount;
+}
+
+long DSPlibWAVReader::Read (unsigned long First, long Count, short *Out)
+{
+  long Done = 0, Frames;
+
+  if (!this->Direct) {
+    return this->ReadFrames (First, Count, (unsigned char *) Out);
+  }
+
+  while (Done < Count) {
+    Frames = ((Count - Done) < DSPLIB_WAV_READ_FRAMES) ? (Count - Done) : DSPLIB_WAV_READ_FRAMES;
+    Frames = this->ReadFrames (First + Done, Frames, this->Bytes);
+
+    if (Frames == 0) {
+      break;
+    }
+
+    this->ConvertFrames (this->Bytes, Frames, &Out [Done]);
+
+    Done += Frames;
+  }
+
+  return Done;
+}
+
+int DSPlibWAVReader::GetFrameBytes ()
+{
+  // What SDL decoded is already 16 bit mono
+  return this->Direct ? (this->BytesPerSample * this->Channels) : sizeof (short);
+}
+
+long DSPlibWAVReader::ReadFrames (unsigned long First, long Count, unsigned char *Out)
+{
+  if (First >= this->SampleCount) {
+    return 0;
+  }
+
+  if (Count > (long) (this->SampleCount - First)) {
+    Count = this->SampleCount - First;
+  }
+
+  if (!this->Direct) {
+    memcpy (Out, &this->Loaded [First], Count * sizeof (short));
+    return Count;
+  }
+
+  fseek (this->File, this->DataOffset + First * this->GetFrameBytes (), SEEK_SET);
+
+  return fread (Out, this->GetFrameBytes (), Count, this->File);
+}
+
+void DSPlibWAVReader::ConvertFrames (unsigned char *Frames, long Count, short *Out)
+{
+  long FrameBytes = this->GetFrameBytes ();
+
+  if (!this->Direct) {
+    memcpy (Out, Frames, Count * sizeof (short));
+    return;
+  }
+
+  // Take each sample down to its top 16 bits (8 bit samples are unsigned) and average the channels
+  for (long Frame = 0; Frame < Count; Frame++) {
+    unsigned char *Sample = &Frames [Frame * FrameBytes];
+    long Sum = 0;
+
+    for (int Channel = 0; Channel < this->Channels; Channel++, Sample += this->BytesPerSample) {
+      if (this->BytesPerSample == 1) {
+	Sum += ((int) Sample [0] - 128) << 8;
+      }
+      else {
+	Sum += (short) (Sample [this->BytesPerSample - 2] | (Sample [this->BytesPerSample - 1] << 8));
+      }
+    }
+
+    Out [Frame] = (short) (Sum / this->Channels);
+  }
+}
@@ -0,0 +1,66 @@
+// DSPlibWAV.h
+//
+// An extension to DSPlib to read just part of a WAV file.
+//
+// GetSoundDataFromWAV loads (and converts) the whole file before anything
+// else can happen.  The reader only parses the header when it's made, then
+// seeks straight to the samples that are asked for in the data chunk, so
+// reading the first minute of a ten hour recording only reads a minute.
+//
+// Uncompressed PCM (8, 16, 24 or 32 bits, any number of channels) is read
+// directly.  Anything else SDL can decode (ADPCM, say) gets loaded whole
+// through GetSoundDataFromWAV when the reader is made, which still works but
+// costs the whole file.
+
+// The size a data chunk says it is when it goes on to the end of the file.  A WAV file over 4 GB can't say how big
+// it really is, so it says this instead.
+#define		DSPLIB_WAV_TO_END		0xFFFFFFFFUL
+
+class DSPlibWAVReader {
+  public:
+    // Basic constructor.  Reads the header.
+    DSPlibWAVReader (char *FileName);
+
+    // Destructor
+    ~DSPlibWAVReader ();
+
+    // False if the file couldn't be opened or isn't a WAV file.
+    bool IsGood ();
+
+    // The sampling rate and the number of samples (per channel) in the file.
+    int           GetRate        ();
+    unsigned long GetSampleCount ();
+
+    // Read Count samples starting at sample First as signed 16 bit mono
+    // (channels are averaged).  Returns how many there were.
+    long Read (unsigned long First, long Count, short *Out);
+
+    // Read does two things, which can be done separately (on different
+    // threads, say): ReadFrames reads Count frames (a sample for every
+    // channel) as they are in the file into Out, which has to have room for
+    // Count * GetFrameBytes () bytes, and returns how many there were.
+    // ConvertFrames turns Count of them into 16 bit mono.
+    int  GetFrameBytes ();
+    long ReadFrames    (unsigned long First, long Count, unsigned char *Out);
+    void ConvertFrames (unsigned char *Frames, long Count, short *Out);
+
+  private:
+    char *FileName;
+    FILE *File;
+    bool  Good;
+
+    int  Rate;
+    int  Channels;
+    int  BytesPerSample;
+    bool Direct;									// false when SDL has to decode it
+
+    long          DataOffset;
+    unsigned long SampleCount;
+
+    // The whole file as 16 bit mono once SDL has decoded it (only when Direct is false)
+    short *Loaded;
+
+    // Where the raw frames are read into
+    unsigned char *Bytes;
+    long           BytesLength;
+};
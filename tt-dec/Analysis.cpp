@@ -0,0 +1,685 @@
+// <BEHOLD the GPL!>
+// ntheory's tt-dec, a software-based, post processing style touch tone decoder
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include "../library/DSPlib.h"
+#include "../library/DSPlibFilter.h"
+#include "../library/DSPlibResonator.h"
+#include "../library/DSPlibSpectrum.h"
+#include "../library/DSPlibTopology.h"
+#include "../library/DSPlibTrace.h"
+
+#include "Protocols.h"
+#include "Analysis.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// How far down (in dB) a filter has to push the pass band of the tones next to it.  The filters are made just long
+// enough to get this much attenuation between the edges of neighbouring pass bands, which is why the DTMF row filters
+// (where the tones are close together) end up longer than the column filters.
+#define		STOPBAND_ATTENUATION		20.0
+
+// The FFT engine's window.  Its block length (205 samples at 8 kHz) puts all eight DTMF tones close to the middle of
+// a bucket, so a plain rectangular window doesn't leak one tone into its neighbour's bucket.
+#define		FFT_WINDOW			DSPLIB_WINDOW_RECTANGULAR
+
+// A touch tone is two pure sines.  Speech that happens to land on a DTMF frequency almost always has a strong second
+// harmonic, so the FFT engine ignores a tone whose second harmonic has more than this fraction of its power.  Rows 1
+// to 3 have their second harmonics right next to a column tone (1394, 1540 and 1704 Hz) so we can only check a
+// harmonic that's at least SECOND_HARMONIC_GUARD buckets away from every tone in the table.
+#define		SECOND_HARMONIC_RATIO		0.1
+#define		SECOND_HARMONIC_GUARD		3
+
+// How many time constants of the narrowest resonator a chunk runs for before its first window.  e^-20 of whatever
+// was ringing before is far below anything a float can hold next to the tone itself.
+#define		IIR_WARMUP_TIME_CONSTANTS	20.0
+
+// Chunks shorter than this many windows aren't worth a thread since every chunk has to prime its filters first.
+#define		MIN_CHUNK_WINDOWS		1000
+
+// FFTW doesn't like plans being made (or thrown away) from more than one thread at a time
+static pthread_mutex_t PlanLock = PTHREAD_MUTEX_INITIALIZER;
+
+// One thread's share of the windows and its own copy of the engine (none of them can be shared between threads).
+// Placement is where the thread goes in the topology, and SamplesNode is the node the samples were read on.
+typedef struct {
+  AnalysisType    *Analysis;
+  short           *Samples;
+  long             SamplesStart;
+  long             FirstWindow, LastWindow;
+  PowerMatrixType *Matrix;
+
+  int              Placement;
+  int              SamplesNode;
+
+  DSPlibFilter        **Filters;
+  DSPlibResonatorBank  *Resonators;
+  DSPlibSpectrum       *Spectrum;
+
+  pthread_t Thread;
+} ChunkType;
+
+static void *AnalyzeChunk (void *Chunk);
+static void CreateEngine (ChunkType *Chunk);
+static void DeleteEngine (ChunkType *Chunk);
+static void AnalyzeFiltered (ChunkType *Chunk);
+static void AnalyzeSpectrum (ChunkType *Chunk);
+
+const char *EngineNames [ENGINE_COUNT] = { "fir", "iir", "fft" };
+
+int FindEngine (const char *Name)
+{
+  for (int Engine = 0; Engine < ENGINE_COUNT; Engine++) {
+    if (strcmp (EngineNames [Engine], Name) == 0) {
+      return Engine;
+    }
+  }
+
+  return -1;
+}
+
+bool SetAnalysisLengths (AnalysisType *Analysis, int Engine, long Rate, long WindowMs, long HopMs)
+{
+  // The FFT engine's window is its block, which comes from the rate.  The filter lengths come from the tone spacing
+  // (see SetupAnalysis) so changing the window doesn't change the filters' selectivity.
+  if (HopMs == 0) {
+    HopMs = (Engine == ENGINE_FFT) ? FFT_HOP_MS : ACCUMULATOR_HOP_MS;
+  }
+
+  if ((WindowMs == 0) && (Engine == ENGINE_FFT)) {
+    Analysis->WindowLength = (long) floor (((fftw_real) Rate * (fftw_real) FFT_BLOCK_LENGTH_8KHZ / (fftw_real) 8000.0) + 0.5);
+    WindowMs               = (Analysis->WindowLength * 1000) / Rate;
+  }
+  else {
+    WindowMs               = (WindowMs == 0) ? ACCUMULATOR_DURATION_MS : WindowMs;
+    Analysis->WindowLength = (long) (((fftw_real) Rate / (fftw_real) 1000.0) * (fftw_real) WindowMs);
+  }
+
+  Analysis->HopLength = (long) (((fftw_real) Rate / (fftw_real) 1000.0) * (fftw_real) HopMs);
+  Analysis->Engine    = Engine;
+  Analysis->Rate      = Rate;
+  Analysis->WindowMs  = WindowMs;
+  Analysis->HopMs     = HopMs;
+  Analysis->Topology  = NULL;
+
+  return (Analysis->WindowLength > 0) && (Analysis->HopLength > 0);
+}
+
+void SetupAnalysis (AnalysisType *Analysis)
+{
+  double MinBandwidth = 0.0;
+
+  Analysis->Taps         = NULL;
+  Analysis->TapCounts    = NULL;
+  Analysis->FilterDelays = NULL;
+  Analysis->FilterLength = 0;
+  Analysis->Warmup       = 0;
+
+  if (Analysis->Engine == ENGINE_FIR) {
+    Analysis->Taps         = new fftw_real * [Analysis->ToneCount];
+    Analysis->TapCounts    = new int [Analysis->ToneCount];
+    Analysis->FilterDelays = new int [Analysis->ToneCount];
+
+    // Each filter is made from its tone's spec in the tone table (see SetupDetector)
+    for (int Tone = 0; Tone < Analysis->ToneCount; Tone++) {
+      ToneType *Spec = &Analysis->Tones [Tone];
+
+      CreateBandPassFilter (Spec->LowStop, Spec->LowPass, Spec->HighPass, Spec->HighStop, STOPBAND_ATTENUATION,
+			    Analysis->Rate, &Analysis->TapCounts [Tone], &Analysis->Taps [Tone]);
+
+      if (Analysis->TapCounts [Tone] > Analysis->FilterLength) {
+	Analysis->FilterLength = Analysis->TapCounts [Tone];
+      }
+    }
+
+    // The tap counts are all odd so these come out whole
+    for (int Tone = 0; Tone < Analysis->ToneCount; Tone++) {
+      Analysis->FilterDelays [Tone] = (Analysis->FilterLength - Analysis->TapCounts [Tone]) / 2;
+    }
+  }
+  else if (Analysis->Engine == ENGINE_IIR) {
+    for (int Tone = 0; Tone < Analysis->ToneCount; Tone++) {
+      if ((MinBandwidth == 0.0) || (Analysis->Tones [Tone].Bandwidth < MinBandwidth)) {
+	MinBandwidth = Analysis->Tones [Tone].Bandwidth;
+      }
+    }
+
+    // A resonator's envelope decays by e every Rate / (pi * Bandwidth) samples
+    Analysis->Warmup = (long) (IIR_WARMUP_TIME_CONSTANTS * (double) Analysis->Rate / (M_PI * MinBandwidth));
+  }
+}
+
+void DeleteAnalysis (AnalysisType *Analysis)
+{
+  if (Analysis->Taps != NULL) {
+    for (int Tone = 0; Tone < Analysis->ToneCount; Tone++) {
+      delete [] Analysis->Taps [Tone];
+    }
+  }
+
+  delete [] Analysis->Taps;
+  delete [] Analysis->TapCounts;
+  delete [] Analysis->FilterDelays;
+}
+
+// Where the windows are -----------------------------------------------------------------------------------------------
+//   Notes:
+//     The filters give one output per sample once they're primed, so output n is sample n + Primer.  A chunk starts a
+//       whole ring early (see AnalyzeFiltered) and the FIRs reach back FilterDelays samples further, or the
+//       resonators Warmup samples.
+// ---------------------------------------------------------------------------------------------------------------------
+
+static long GetPrimer (AnalysisType *Analysis)
+{
+  return (Analysis->FilterLength > 0) ? (Analysis->FilterLength - 1) : 0;
+}
+
+static long GetRingStart (AnalysisType *Analysis, long FirstWindow)
+{
+  long Start = (((FirstWindow * Analysis->HopLength) / Analysis->WindowLength) - 1) * Analysis->WindowLength;
+
+  return (Start > 0) ? Start : 0;
+}
+
+long GetWindowCount (AnalysisType *Analysis, long SampleCount)
+{
+  long OutputCount = SampleCount - Analysis->FilterLength - GetPrimer (Analysis);
+
+  return (OutputCount >= Analysis->WindowLength) ? ((OutputCount - Analysis->WindowLength) / Analysis->HopLength) + 1 : 0;
+}
+
+long GetFirstSample (AnalysisType *Analysis, long FirstWindow)
+{
+  long First;
+
+  if (Analysis->Engine == ENGINE_FFT) {
+    return FirstWindow * Analysis->HopLength;
+  }
+
+  First = GetRingStart (Analysis, FirstWindow);
+
+  if (Analysis->Engine == ENGINE_IIR) {
+    First -= Analysis->Warmup;
+  }
+  else {
+    // The shortest filter has the longest delay
+    for (int Tone = 0; Tone < Analysis->ToneCount; Tone++) {
+      if ((GetRingStart (Analysis, FirstWindow) - Analysis->FilterDelays [Tone]) < First) {
+	First = GetRingStart (Analysis, FirstWindow) - Analysis->FilterDelays [Tone];
+      }
+    }
+  }
+
+  return (First > 0) ? First : 0;
+}
+
+long GetLastSample (AnalysisType *Analysis, long LastWindow)
+{
+  return (LastWindow - 1) * Analysis->HopLength + Analysis->WindowLength + GetPrimer (Analysis);
+}
+
+long GetWindowDelay (AnalysisType *Analysis)
+{
+  // Every FIR's output is lined up with the longest one's, which is centered halfway back along it
+  return GetPrimer (Analysis) / 2;
+}
+
+long GetWindowAt (AnalysisType *Analysis, long Sample)
+{
+  long Window = Sample - GetWindowDelay (Analysis) + Analysis->HopLength - 1;
+
+  return (Window > 0) ? (Window / Analysis->HopLength) : 0;
+}
+
+void AnalyzeSamples (AnalysisType *Analysis, short *Samples, long SamplesStart, long FirstWindow, long LastWindow,
+		     int ThreadCount, PowerMatrixType *Matrix)
+{
+  CreatePowerMatrix (Analysis, (LastWindow > FirstWindow) ? (LastWindow - FirstWindow) : 0, Matrix);
+  AnalyzeWindows (Analysis, Samples, SamplesStart, FirstWindow, LastWindow, ThreadCount, Matrix);
+}
+
+void CreatePowerMatrix (AnalysisType *Analysis, long WindowCount, PowerMatrixType *Matrix)
+{
+  Matrix->Engine       = Analysis->Engine;
+  Matrix->Rate         = Analysis->Rate;
+  Matrix->WindowMs     = Analysis->WindowMs;
+  Matrix->HopMs        = Analysis->HopMs;
+  Matrix->WindowLength = Analysis->WindowLength;
+  Matrix->HopLength    = Analysis->HopLength;
+  Matrix->ToneCount    = Analysis->ToneCount;
+  Matrix->Frequencies  = new double [Analysis->ToneCount];
+
+  for (int Tone = 0; Tone < Analysis->ToneCount; Tone++) {
+    Matrix->Frequencies [Tone] = Analysis->Tones [Tone].Frequency;
+  }
+
+  Matrix->FirstWindow = 0;
+  Matrix->WindowCount = WindowCount;
+  Matrix->Power       = (WindowCount > 0) ? new float [Matrix->ToneCount * WindowCount] : NULL;
+}
+
+void AnalyzeWindows (AnalysisType *Analysis, short *Samples, long SamplesStart, long FirstWindow, long LastWindow,
+		     int ThreadCount, PowerMatrixType *Matrix)
+{
+  long ChunkCount, ChunkWindows;
+  ChunkType *Chunks;
+
+  Matrix->FirstWindow = FirstWindow;
+  Matrix->WindowCount = (LastWindow > FirstWindow) ? (LastWindow - FirstWindow) : 0;
+
+  // Cut the windows up between the threads
+  ChunkCount = Matrix->WindowCount / MIN_CHUNK_WINDOWS;
+
+  if (ChunkCount > ThreadCount) ChunkCount = ThreadCount;
+  if (ChunkCount < 1)           ChunkCount = 1;
+
+  ChunkWindows = (Matrix->WindowCount + ChunkCount - 1) / ChunkCount;
+  Chunks       = new ChunkType [ChunkCount];
+
+  // Each thread makes its own engine once it's running (see AnalyzeChunk)
+  for (long Chunk = 0; Chunk < ChunkCount; Chunk++) {
+    Chunks [Chunk].Analysis     = Analysis;
+    Chunks [Chunk].Samples      = Samples;
+    Chunks [Chunk].SamplesStart = SamplesStart;
+    Chunks [Chunk].Matrix       = Matrix;
+    Chunks [Chunk].FirstWindow  = FirstWindow + Chunk * ChunkWindows;
+    Chunks [Chunk].LastWindow   = FirstWindow + (Chunk + 1) * ChunkWindows;
+    Chunks [Chunk].Placement    = (Analysis->Topology != NULL) ? (Chunk % Analysis->Topology->GetCPUCount ()) : -1;
+    Chunks [Chunk].SamplesNode  = (Analysis->Topology != NULL) ? Analysis->Topology->GetCurrentNode () : -1;
+    Chunks [Chunk].Filters      = NULL;
+    Chunks [Chunk].Resonators   = NULL;
+    Chunks [Chunk].Spectrum     = NULL;
+
+    if (Chunks [Chunk].LastWindow > LastWindow) {
+      Chunks [Chunk].LastWindow = LastWindow;
+    }
+  }
+
+  // This thread does the first chunk itself
+  for (long Chunk = 1; Chunk < ChunkCount; Chunk++) {
+    if (pthread_create (&Chunks [Chunk].Thread, NULL, AnalyzeChunk, &Chunks [Chunk]) != 0) {
+      printf ("Couldn't start an analysis thread.\n");
+      exit (0);
+    }
+  }
+
+  AnalyzeChunk (&Chunks [0]);
+
+  for (long Chunk = 1; Chunk < ChunkCount; Chunk++) {
+    pthread_join (Chunks [Chunk].Thread, NULL);
+  }
+
+  delete [] Chunks;
+}
+
+// Analyze a chunk -----------------------------------------------------------------------------------------------------
+//   Notes:
+//     Memory comes from the node of whichever thread writes to it first, so a pinned thread makes its engine (and
+//       with it its own copy of the taps or coefficients, and every history and buffer) after it's been pinned.  The
+//       samples were read by the thread that called AnalyzeSamples, so a thread on another node copies the ones its
+//       chunk needs first rather than reading every one of them across the link between the sockets.
+// ---------------------------------------------------------------------------------------------------------------------
+
+static void *AnalyzeChunk (void *Argument)
+{
+  ChunkType    *Chunk    = (ChunkType *) Argument;
+  AnalysisType *Analysis = Chunk->Analysis;
+  short        *Local    = NULL;
+
+  if (Chunk->FirstWindow >= Chunk->LastWindow) {
+    return NULL;
+  }
+
+  if (Chunk->Placement >= 0) {
+    Analysis->Topology->Pin (Chunk->Placement);
+
+    if (Analysis->Topology->GetNode (Chunk->Placement) != Chunk->SamplesNode) {
+      long First = GetFirstSample (Analysis, Chunk->FirstWindow);
+      long Last  = GetLastSample  (Analysis, Chunk->LastWindow);
+
+      Local = new short [Last - First];
+      memcpy (Local, &Chunk->Samples [First - Chunk->SamplesStart], (Last - First) * sizeof (short));
+
+      Chunk->Samples      = Local;
+      Chunk->SamplesStart = First;
+    }
+  }
+
+  CreateEngine (Chunk);
+
+  if (Chunk->Spectrum != NULL) {
+    AnalyzeSpectrum (Chunk);
+  }
+  else {
+    AnalyzeFiltered (Chunk);
+  }
+
+  DeleteEngine (Chunk);
+
+  delete [] Local;
+
+  return NULL;
+}
+
+static void CreateEngine (ChunkType *Chunk)
+{
+  AnalysisType *Analysis = Chunk->Analysis;
+  double Frequencies [MAX_TONES], Bandwidths [MAX_TONES];
+
+  if (Analysis->Engine == ENGINE_FIR) {
+    Chunk->Filters = new DSPlibFilter * [Analysis->ToneCount];
+
+    for (int Tone = 0; Tone < Analysis->ToneCount; Tone++) {
+      Chunk->Filters [Tone] = new DSPlibFilter (Analysis->TapCounts [Tone], Analysis->Taps [Tone]);
+    }
+  }
+  else if (Analysis->Engine == ENGINE_IIR) {
+    for (int Tone = 0; Tone < Analysis->ToneCount; Tone++) {
+      Frequencies [Tone] = Analysis->Tones [Tone].Frequency;
+      Bandwidths  [Tone] = Analysis->Tones [Tone].Bandwidth;
+    }
+
+    Chunk->Resonators = new DSPlibResonatorBank (Analysis->ToneCount, Frequencies, Bandwidths, Analysis->Rate);
+  }
+  else {
+    pthread_mutex_lock (&PlanLock);
+    Chunk->Spectrum = new DSPlibSpectrum (Analysis->WindowLength, FFT_WINDOW, Analysis->Rate);
+    pthread_mutex_unlock (&PlanLock);
+  }
+}
+
+static void DeleteEngine (ChunkType *Chunk)
+{
+  if (Chunk->Filters != NULL) {
+    for (int Tone = 0; Tone < Chunk->Analysis->ToneCount; Tone++) {
+      delete Chunk->Filters [Tone];
+    }
+
+    delete [] Chunk->Filters;
+  }
+
+  delete Chunk->Resonators;
+
+  pthread_mutex_lock (&PlanLock);
+  delete Chunk->Spectrum;
+  pthread_mutex_unlock (&PlanLock);
+}
+
+// Analyze a chunk with the FIRs or the resonators ---------------------------------------------------------------------
+//   Description:
+//     Runs the filters over just enough of the file to cover the chunk's windows and averages their rectified outputs
+//       over each window.  The averages are running sums over a ring of the last WindowLength outputs.  Every time
+//       the ring wraps it's added up again from scratch, which keeps rounding error from piling up over a long file.
+//
+//   Notes:
+//     Outputs are numbered from the first one the whole file gives.  The ring slot an output goes in and the points
+//       where the sums are redone both go by that number, and a chunk starts a whole ring before the one its first
+//       window starts in, so its sums are redone before its first window ends.  From there on they're bit for bit
+//       what one pass over the whole file gives.
+//
+//     The FIRs only depend on the last FilterLength samples so they're primed by starting FilterLength - 1 samples
+//       early.  The resonators depend on everything, so they're run for Warmup samples first instead.
+// ---------------------------------------------------------------------------------------------------------------------
+
+static void AnalyzeFiltered (ChunkType *Chunk)
+{
+  AnalysisType    *Analysis = Chunk->Analysis;
+  PowerMatrixType *Matrix   = Chunk->Matrix;
+  int  ToneCount    = Analysis->ToneCount;
+  long WindowLength = Analysis->WindowLength;
+  long HopLength    = Analysis->HopLength;
+  long Primer       = GetPrimer (Analysis);
+  long FirstOutput, LastOutput, Start, FirstLoop, Output, End, Slot, Block = 0;
+  bool Valid;
+
+  fftw_real *Accumulators  = new fftw_real [ToneCount];
+  fftw_real *Outputs       = new fftw_real [ToneCount];
+  fftw_real *WindowHistory = new fftw_real [WindowLength * ToneCount];
+  fftw_real *BlockIn       = NULL;
+  fftw_real *BlockOut [MAX_TONES];
+
+  memset (Accumulators, 0, ToneCount * sizeof (fftw_real));
+  memset (WindowHistory, 0, WindowLength * ToneCount * sizeof (fftw_real));
+
+  // The outputs the chunk's windows cover, and where to start so the sums line up (see above)
+  FirstOutput = Chunk->FirstWindow * HopLength;
+  LastOutput  = (Chunk->LastWindow - 1) * HopLength + WindowLength - 1;
+
+  Start = GetRingStart (Analysis, Chunk->FirstWindow);
+
+  if (Analysis->Engine == ENGINE_IIR) {
+    FirstLoop = (Start > Analysis->Warmup) ? (Start - Analysis->Warmup) : 0;
+    BlockIn   = new fftw_real [DSPLIB_RESONATOR_BLOCK];
+
+    for (int Tone = 0; Tone < ToneCount; Tone++) {
+      BlockOut [Tone] = new fftw_real [DSPLIB_RESONATOR_BLOCK];
+    }
+  }
+  else {
+    FirstLoop = Start;
+  }
+
+  for (long Loop = FirstLoop; Loop <= LastOutput + Primer; Loop++) {
+    if (Analysis->Engine == ENGINE_IIR) {
+      // The resonators go a block at a time
+      if (((Loop - FirstLoop) % DSPLIB_RESONATOR_BLOCK) == 0) {
+	Block = LastOutput + 1 - Loop;
+
+	if (Block > DSPLIB_RESONATOR_BLOCK) {
+	  Block = DSPLIB_RESONATOR_BLOCK;
+	}
+
+	ConvertToReals (&Chunk->Samples [Loop - Chunk->SamplesStart], BlockIn, Block);
+	Chunk->Resonators->Filter (BlockIn, Block, BlockOut);
+      }
+
+      Output = Loop;
+
+      if (Output < Start) {
+	continue;
+      }
+
+      for (int Tone = 0; Tone < ToneCount; Tone++) {
+	Outputs [Tone] = BlockOut [Tone][(Loop - FirstLoop) % DSPLIB_RESONATOR_BLOCK];
+      }
+    }
+    else {
+      // A delayed filter gets nothing until the input has gone past its delay.  Every filter has to be asked for a
+      // sample every time, even the ones that are primed before the others, so they all stay lined up with the input.
+      Valid = true;
+
+      for (int Tone = 0; Tone < ToneCount; Tone++) {
+	if (Loop >= Analysis->FilterDelays [Tone]) {
+	  Chunk->Filters [Tone]->PutSample (Chunk->Samples [Loop - Analysis->FilterDelays [Tone] - Chunk->SamplesStart]);
+	}
+
+	if ((Outputs [Tone] = Chunk->Filters [Tone]->GetSample ()) == DSPFILTER_INVALID) {
+	  Valid = false;
+	}
+      }
+
+      if (!Valid) {
+	continue;
+      }
+
+      Output = Loop - Primer;
+    }
+
+    // Rectify the filter outputs with fabs so we can calculate the power by simple averaging.  This is similar to
+    // rectifying an AC signal and calculating the RMS of the resulting DC.  Then drop the oldest outputs out of the
+    // running sums and add these in.
+    Slot = (Output % WindowLength) * ToneCount;
+
+    for (int Tone = 0; Tone < ToneCount; Tone++) {
+      Outputs [Tone] = fabs (Outputs [Tone]);
+
+      Accumulators  [Tone] += Outputs [Tone] - WindowHistory [Slot + Tone];
+      WindowHistory [Slot + Tone] = Outputs [Tone];
+    }
+
+    if (((Output + 1) % WindowLength) == 0) {
+      memset (Accumulators, 0, ToneCount * sizeof (fftw_real));
+
+      for (long Position = 0; Position < WindowLength; Position++) {
+	for (int Tone = 0; Tone < ToneCount; Tone++) {
+	  Accumulators [Tone] += WindowHistory [Position * ToneCount + Tone];
+	}
+      }
+    }
+
+    // Average the accumulators to get the power if a window of ours ends here
+    End = Output - (WindowLength - 1);
+
+    if ((End >= FirstOutput) && ((End % HopLength) == 0)) {
+      for (int Tone = 0; Tone < ToneCount; Tone++) {
+	Matrix->Power [Tone * Matrix->WindowCount + End / HopLength - Matrix->FirstWindow] =
+	  (float) (Accumulators [Tone] / WindowLength);
+      }
+    }
+  }
+
+  if (BlockIn != NULL) {
+    delete [] BlockIn;
+
+    for (int Tone = 0; Tone < ToneCount; Tone++) {
+      delete [] BlockOut [Tone];
+    }
+  }
+
+  delete [] Accumulators;
+  delete [] Outputs;
+  delete [] WindowHistory;
+}
+
+static void AnalyzeSpectrum (ChunkType *Chunk)
+{
+  AnalysisType    *Analysis = Chunk->Analysis;
+  PowerMatrixType *Matrix   = Chunk->Matrix;
+  DSPlibSpectrum  *Spectrum = Chunk->Spectrum;
+  int Harmonic;
+  bool Clear;
+
+  // Each window is its own block so nothing has to be primed
+  for (long Window = Chunk->FirstWindow; Window < Chunk->LastWindow; Window++) {
+    Spectrum->Analyze (&Chunk->Samples [Window * Analysis->HopLength - Chunk->SamplesStart]);
+
+    for (int Tone = 0; Tone < Analysis->ToneCount; Tone++) {
+      double Frequency = Analysis->Tones [Tone].Frequency;
+      float *Power     = &Matrix->Power [Tone * Matrix->WindowCount + Window - Matrix->FirstWindow];
+
+      // See if the second harmonic's bucket is far enough from the other tones to mean anything
+      Harmonic = Spectrum->GetBucket (2.0 * Frequency);
+      Clear    = true;
+
+      for (int Other = 0; Other < Analysis->ToneCount; Other++) {
+	if (abs (Harmonic - Spectrum->GetBucket (Analysis->Tones [Other].Frequency)) < SECOND_HARMONIC_GUARD) {
+	  Clear = false;
+	}
+      }
+
+      // Throw the tone away if it looks like a harmonic-rich voice rather than a sine
+      if (Clear && (Spectrum->GetPower (2.0 * Frequency) > (Spectrum->GetPower (Frequency) * SECOND_HARMONIC_RATIO))) {
+	*Power = 0.0f;
+	continue;
+      }
+
+      // The other engines average the rectified output of a filter, which for a sine wave is 2 / pi of its
+      // amplitude.  Scale the amplitude the same way so the power threshold means the same thing for every engine.
+      *Power = (float) (Spectrum->GetAmplitude (Frequency) * 2.0 / M_PI);
+    }
+  }
+}
+
+bool LoadPowerMatrix (const char *FileName, PowerMatrixType *Matrix)
+{
+  DSPlibTraceReader *Trace = new DSPlibTraceReader (FileName);
+  float **Columns;
+  char *End;
+  int Engine;
+  double Frequency;
+
+  if (!Trace->IsGood () ||
+      (sscanf (Trace->GetComment (), POWER_TRACE_COMMENT, &Engine, &Matrix->Rate, &Matrix->WindowMs, &Matrix->HopMs,
+	       &Matrix->WindowLength, &Matrix->HopLength) != 6) || (Matrix->HopMs < 1)) {
+    delete Trace;
+    return false;
+  }
+
+  Matrix->Engine      = Engine;
+  Matrix->ToneCount   = 0;
+  Matrix->FirstWindow = 0;
+  Matrix->WindowCount = Trace->GetRowCount ();
+  Matrix->Frequencies = new double [Trace->GetColumnCount () + 1];
+  Matrix->Power       = new float [Trace->GetColumnCount () * Matrix->WindowCount + 1];
+
+  Columns = new float * [Trace->GetColumnCount () + 1];
+
+  // The tone columns are the ones named after a frequency.  The detectors' decisions are left where they are.
+  for (int Column = 0; Column < Trace->GetColumnCount (); Column++) {
+    Columns [Column] = NULL;
+    Frequency        = strtod (Trace->GetColumnName (Column), &End);
+
+    if ((*End == '\0') && (End != Trace->GetColumnName (Column))) {
+      Matrix->Frequencies [Matrix->ToneCount] = Frequency;
+      Columns [Column] = &Matrix->Power [Matrix->ToneCount * Matrix->WindowCount];
+
+      Matrix->ToneCount++;
+    }
+  }
+
+  Trace->GetRows (0, Matrix->WindowCount, Columns);
+
+  delete [] Columns;
+  delete Trace;
+
+  return true;
+}
+
+void SetDurationThresholds (DetectorType *Detectors, int DetectorCount, int Engine, long WindowMs, long HopMs)
+{
+  // A tone of a protocol's minimum duration completely covers this many hops' worth of windows.  The FFT block is
+  // longer than a touch tone, so for the FFT engine we count the hops a tone of the minimum duration takes to go by
+  // instead.
+  for (int Detector = 0; Detector < DetectorCount; Detector++) {
+    int MinDurationMs = Detectors [Detector].Protocol->MinDurationMs;
+
+    if (Engine == ENGINE_FFT) {
+      Detectors [Detector].DurationThreshold = MinDurationMs / HopMs;
+    }
+    else {
+      Detectors [Detector].DurationThreshold = (MinDurationMs - WindowMs) / HopMs + 1;
+    }
+
+    if (Detectors [Detector].DurationThreshold < 1) {
+      Detectors [Detector].DurationThreshold = 1;
+    }
+  }
+}
+
+void DeletePowerMatrix (PowerMatrixType *Matrix)
+{
+  delete [] Matrix->Frequencies;
+  delete [] Matrix->Power;
+
+  Matrix->Frequencies = NULL;
+  Matrix->Power       = NULL;
+}
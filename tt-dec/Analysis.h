@@ -0,0 +1,130 @@
+// Analysis.h
+//
+// The first half of tt-dec: run one of the engines over the samples and boil
+// them down to a matrix of band powers, one column of windows per tone.  The
+// file is cut into chunks that are analyzed side by side.  The matrix can be
+// read back from a trace tt-dec wrote (see DSPlibTrace.h) so the second half
+// (DetectSymbols in Protocols.h) can be run again with different thresholds
+// without filtering anything.
+
+// The engines that turn samples into band powers
+#define		ENGINE_FIR			0						// One Kaiser windowed FIR per tone
+#define		ENGINE_IIR			1						// One second order resonator per tone
+#define		ENGINE_FFT			2						// One FFT per hop
+#define		ENGINE_COUNT			3
+
+// The FIR and IIR engines' analysis window, and how often they look at it (unless --window and --hop say otherwise).
+// A hop equal to the window means no overlap.
+#define		ACCUMULATOR_DURATION_MS		8
+#define		ACCUMULATOR_HOP_MS		ACCUMULATOR_DURATION_MS
+
+// The FFT engine's block length at 8 kHz (scaled to the actual rate, unless --window says otherwise).  This is the
+// length the classic Goertzel detectors use: the buckets are 39 Hz wide so rows 1 and 2 are nearly two buckets
+// apart, and all eight tones land close to the middle of a bucket.
+#define		FFT_BLOCK_LENGTH_8KHZ		205
+
+// How often the FFT engine transforms a block (unless --hop says otherwise).  The blocks overlap by most of their
+// length so a tone edge can't fall badly for every block that sees it.
+#define		FFT_HOP_MS			4
+
+// The engines' names ("fir", "iir" and "fft"), and the engine with a name (-1 if there isn't one)
+extern const char *EngineNames [ENGINE_COUNT];
+
+int FindEngine (const char *Name);
+
+// Band powers, one column per tone, for WindowCount windows starting at window FirstWindow of the file.
+// Power [Tone * WindowCount + Window - FirstWindow] is the average rectified output of the tone's filter over that
+// window as a fraction of full scale (the FFT engine scales its amplitudes to match).  The rest is what the matrix
+// was made with, so a saved one can be decided on without the original file.
+typedef struct {
+  int     Engine;
+  long    Rate;
+  long    WindowMs, HopMs;
+  long    WindowLength, HopLength;
+
+  int     ToneCount;
+  double *Frequencies;
+
+  long    FirstWindow, WindowCount;
+  float  *Power;
+} PowerMatrixType;
+
+class DSPlibTopology;
+
+// Everything the workers share: the engine, the tone table and whatever was designed from it once up front.
+typedef struct {
+  int       Engine;
+  long      Rate;
+  long      WindowMs, HopMs;
+  long      WindowLength, HopLength;
+
+  ToneType *Tones;
+  int       ToneCount;
+
+  // Where the workers go.  When it isn't NULL the thread doing chunk n is pinned to the CPU at n in the topology's
+  // order (the calling thread does chunk 0), and makes its filters and buffers there.  SetAnalysisLengths sets it to
+  // NULL, which leaves the threads wherever the system puts them.
+  DSPlibTopology *Topology;
+
+  // ENGINE_FIR: each tone's taps, and the length of the longest filter (nothing comes out until this many samples
+  // have gone in).  A filter's output is centered (TapCount - 1) / 2 samples back, so the short filters are fed
+  // FilterDelays samples late to line every output up with the longest one's.
+  fftw_real **Taps;
+  int        *TapCounts;
+  int        *FilterDelays;
+  int         FilterLength;
+
+  // ENGINE_IIR: how many samples a chunk runs the resonators for before its first window so they've forgotten
+  // starting from silence
+  long        Warmup;
+} AnalysisType;
+
+// Fill in everything above the tone table (and the topology) for an engine at Rate, working out the window and hop in
+// samples.  A WindowMs or HopMs of 0 means the engine's default.  Returns false if either comes out as no samples.
+bool SetAnalysisLengths (AnalysisType *Analysis, int Engine, long Rate, long WindowMs, long HopMs);
+
+// Design the filters for a tone table.  Fill in everything above the tone table first.
+void SetupAnalysis (AnalysisType *Analysis);
+void DeleteAnalysis (AnalysisType *Analysis);
+
+// How many windows there are in SampleCount samples, and the samples it takes to work out windows FirstWindow to
+// LastWindow - 1 (from GetFirstSample up to but not including GetLastSample).  Windows start every hop once the
+// filters are primed.  The last FilterLength samples are never used, the same as when tt-dec did this one sample at
+// a time.
+long GetWindowCount (AnalysisType *Analysis, long SampleCount);
+long GetFirstSample (AnalysisType *Analysis, long FirstWindow);
+long GetLastSample  (AnalysisType *Analysis, long LastWindow);
+
+// How far the filters' output lags the samples, so window n covers the samples from GetWindowDelay + n * HopLength
+// on (to within the resonators' ringing)
+long GetWindowDelay (AnalysisType *Analysis);
+
+// The first window that covers nothing before Sample
+long GetWindowAt (AnalysisType *Analysis, long Sample);
+
+// Fill in a matrix for windows FirstWindow to LastWindow - 1 using up to ThreadCount threads.  Samples [0] is sample
+// SamplesStart of the file and the samples have to cover what GetFirstSample and GetLastSample say.  Every chunk (and
+// every call) gives exactly the same powers it would have if the file had been done in one go (to within the IIR
+// warmup).
+void AnalyzeSamples (AnalysisType *Analysis, short *Samples, long SamplesStart, long FirstWindow, long LastWindow,
+		     int ThreadCount, PowerMatrixType *Matrix);
+
+// AnalyzeSamples in two parts, for a caller that analyzes one piece after another: make a matrix with room for
+// WindowCount windows for Analysis's settings, then fill it in for windows FirstWindow to LastWindow - 1 as many
+// times as it likes.  A WindowCount of 0 leaves Power NULL, so it can be pointed at a buffer of the caller's (with
+// room for ToneCount powers per window) and set back to NULL before DeletePowerMatrix.
+void CreatePowerMatrix (AnalysisType *Analysis, long WindowCount, PowerMatrixType *Matrix);
+void AnalyzeWindows    (AnalysisType *Analysis, short *Samples, long SamplesStart, long FirstWindow, long LastWindow,
+			int ThreadCount, PowerMatrixType *Matrix);
+
+// How the settings a matrix was made with go in the comment of a trace.  The trace's other columns are named after
+// the frequency of their tone.
+#define		POWER_TRACE_COMMENT		"engine=%d rate=%ld window_ms=%ld hop_ms=%ld window=%ld hop=%ld"
+
+// Load the tone columns of a trace back into a matrix.  Returns false if the file isn't a trace tt-dec wrote.
+bool LoadPowerMatrix (const char *FileName, PowerMatrixType *Matrix);
+
+void DeletePowerMatrix (PowerMatrixType *Matrix);
+
+// Work out how many hops each detector's symbols have to last with an engine's window and hop
+void SetDurationThresholds (DetectorType *Detectors, int DetectorCount, int Engine, long WindowMs, long HopMs);
@@ -0,0 +1,358 @@
+// <BEHOLD the GPL!>
+// ntheory's tt-dec, a software-based, post processing style touch tone decoder
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include "../library/DSPlib.h"
+#include "../library/DSPlibSIMD.h"
+#include "../library/DSPlibOscillator.h"
+
+#include "Protocols.h"
+#include "Analysis.h"
+#include "Autotune.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// The sequence every engine has to get right, and how it's sent: each symbol's tones at AUTOTUNE_AMPLITUDE of full
+// scale for AUTOTUNE_TONE_MS with AUTOTUNE_GAP_MS of silence between them (and before the first one)
+#define		AUTOTUNE_SYMBOLS		"123A456B789C*0#D"
+#define		AUTOTUNE_TONE_MS		60
+#define		AUTOTUNE_GAP_MS			60
+#define		AUTOTUNE_AMPLITUDE		0.25
+
+// How much of the sequence each engine gets timed on and how many times (the best time counts).  Short enough that
+// the first run at a new rate hardly notices, long enough to get the caches warm.  An engine that takes more than
+// AUTOTUNE_GIVE_UP times as long as the best so far can't win, so it isn't timed again.
+#define		AUTOTUNE_TIMED_MS		500
+#define		AUTOTUNE_RUNS			3
+#define		AUTOTUNE_GIVE_UP		2.0
+
+// The longest line in the profile
+#define		AUTOTUNE_LINE_LENGTH		1024
+
+// Make the test sequence at Rate.  The caller deletes it.
+static short *CreateSequence (long Rate, long *Length);
+
+// Run one engine over the test sequence with Tones and return how long it took in seconds.  With Check it also has
+// to decode it (with just the DTMF tones) or the time comes back negative.
+static double TimeEngine (int Engine, long Rate, ToneType *Tones, int ToneCount, long WindowMs, long HopMs,
+			  short *Samples, long Length, bool Check);
+
+// What the profile's lines start with for this run
+static void GetProfileKey (char *Key, int Size, long Rate, ToneType *Tones, int ToneCount, long WindowMs, long HopMs);
+
+static double Now ()
+{
+  struct timespec Time;
+
+  clock_gettime (CLOCK_MONOTONIC, &Time);
+
+  return (double) Time.tv_sec + (double) Time.tv_nsec / 1e9;
+}
+
+int ChooseEngine (long Rate, ToneType *Tones, int ToneCount, long WindowMs, long HopMs, bool Retune)
+{
+  char Key [AUTOTUNE_LINE_LENGTH], Line [AUTOTUNE_LINE_LENGTH];
+  char *Profile = getenv ("TT_DEC_PROFILE"), *Home = getenv ("HOME"), *TempName;
+  double Times [ENGINE_COUNT];
+  int Winner = -1;
+  short *Samples;
+  long Length, TimedLength;
+  FILE *File, *Temp;
+
+  GetProfileKey (Key, sizeof (Key), Rate, Tones, ToneCount, WindowMs, HopMs);
+
+  // Where's the profile?  Without one we still pick the fastest, we just can't remember it.
+  TempName = new char [((Profile != NULL) ? strlen (Profile) : (Home != NULL) ? strlen (Home) : 0) + 64];
+
+  if (Profile == NULL) {
+    if (Home != NULL) {
+      sprintf (TempName, "%s/%s", Home, AUTOTUNE_PROFILE_NAME);
+      Profile = TempName;
+    }
+  }
+
+  // A line is the key, a tab, then the winner's name (and the times, which are only there for people to read)
+  if ((Profile != NULL) && !Retune && ((File = fopen (Profile, "r")) != NULL)) {
+    while ((Winner < 0) && (fgets (Line, sizeof (Line), File) != NULL)) {
+      if ((strncmp (Line, Key, strlen (Key)) == 0) && (Line [strlen (Key)] == '\t')) {
+	char *Name = &Line [strlen (Key) + 1];
+
+	Name [strcspn (Name, "\t\n")] = '\0';
+	Winner = FindEngine (Name);
+      }
+    }
+
+    fclose (File);
+  }
+
+  if (Winner >= 0) {
+    delete [] TempName;
+    return Winner;
+  }
+
+  // Every engine has to decode the sequence, then the ones that did race each other over the start of it
+  Samples     = CreateSequence (Rate, &Length);
+  TimedLength = (AUTOTUNE_TIMED_MS * Rate) / 1000;
+  TimedLength = (TimedLength < Length) ? TimedLength : Length;
+
+  for (int Engine = 0; Engine < ENGINE_COUNT; Engine++) {
+    Times [Engine] = TimeEngine (Engine, Rate, Tones, ToneCount, WindowMs, HopMs, Samples, Length, true);
+
+    for (int Run = 0; (Run < AUTOTUNE_RUNS) && (Times [Engine] >= 0.0); Run++) {
+      double Time = TimeEngine (Engine, Rate, Tones, ToneCount, WindowMs, HopMs, Samples, TimedLength, false);
+
+      if ((Run == 0) || (Time < Times [Engine])) {
+	Times [Engine] = Time;
+      }
+
+      if ((Winner >= 0) && (Times [Engine] > AUTOTUNE_GIVE_UP * Times [Winner])) {
+	break;
+      }
+    }
+
+    if ((Times [Engine] >= 0.0) && ((Winner < 0) || (Times [Engine] < Times [Winner]))) {
+      Winner = Engine;
+    }
+  }
+
+  delete [] Samples;
+
+  // If none of them could do it the window or hop must be no good.  Go with the FIRs and let tt-dec say so.
+  if (Winner < 0) {
+    delete [] TempName;
+    return ENGINE_FIR;
+  }
+
+  // Write the profile back without any old answer for this key.  It goes to a temporary file that's renamed over it,
+  // so two runs tuning at once can only lose each other's line (which just gets measured again).
+  if (Profile != NULL) {
+    char *NewName = new char [strlen (Profile) + 32];
+
+    sprintf (NewName, "%s.%ld.tmp", Profile, (long) getpid ());
+
+    if ((Temp = fopen (NewName, "w")) != NULL) {
+      if ((File = fopen (Profile, "r")) != NULL) {
+	while (fgets (Line, sizeof (Line), File) != NULL) {
+	  if (!((strncmp (Line, Key, strlen (Key)) == 0) && (Line [strlen (Key)] == '\t'))) {
+	    fputs (Line, Temp);
+	  }
+	}
+
+	fclose (File);
+      }
+
+      fprintf (Temp, "%s\t%s", Key, EngineNames [Winner]);
+
+      for (int Engine = 0; Engine < ENGINE_COUNT; Engine++) {
+	if (Times [Engine] >= 0.0) {
+	  fprintf (Temp, "\t%s=%.3fms", EngineNames [Engine], Times [Engine] * 1000.0);
+	}
+      }
+
+      fprintf (Temp, "\n");
+
+      if ((fclose (Temp) != 0) || (rename (NewName, Profile) != 0)) {
+	remove (NewName);
+      }
+    }
+
+    delete [] NewName;
+  }
+
+  delete [] TempName;
+
+  return Winner;
+}
+
+static void GetProfileKey (char *Key, int Size, long Rate, ToneType *Tones, int ToneCount, long WindowMs, long HopMs)
+{
+  char CPU [256] = "unknown";
+  char Line [AUTOTUNE_LINE_LENGTH];
+  int Length;
+  FILE *File;
+
+  // The same home directory can be shared by different machines
+  if ((File = fopen ("/proc/cpuinfo", "r")) != NULL) {
+    while (fgets (Line, sizeof (Line), File) != NULL) {
+      if ((strncmp (Line, "model name", 10) == 0) && (strchr (Line, ':') != NULL)) {
+	char *Name = strchr (Line, ':') + 1;
+
+	Name += strspn (Name, " \t");
+	Name [strcspn (Name, "\t\n")] = '\0';
+	snprintf (CPU, sizeof (CPU), "%s", Name);
+	break;
+      }
+    }
+
+    fclose (File);
+  }
+
+  // A run that DSPLIB_ISA holds back can have a different winner
+  Length = snprintf (Key, Size, "%s/%s/%ld/%ld/%ld/", CPU, DSPlibISAName (DSPlibGetISA ()), Rate, WindowMs, HopMs);
+
+  for (int Tone = 0; (Tone < ToneCount) && (Length < Size); Tone++) {
+    Length += snprintf (&Key [Length], Size - Length, (Tone == 0) ? "%g" : ",%g", Tones [Tone].Frequency);
+  }
+}
+
+static short *CreateSequence (long Rate, long *Length)
+{
+  ProtocolType *DTMF = FindProtocol ("dtmf");
+  long ToneLength = (AUTOTUNE_TONE_MS * Rate) / 1000, GapLength = (AUTOTUNE_GAP_MS * Rate) / 1000;
+  long Once = (long) strlen (AUTOTUNE_SYMBOLS) * (ToneLength + GapLength) + GapLength;
+  double Frequencies [2] = { DTMF->Symbols [0].Frequencies [0], DTMF->Symbols [0].Frequencies [1] };
+  fftw_real *Mix = new fftw_real [Once];
+  short *Samples;
+  DSPlibOscillatorBank *Bank;
+
+  Bank = new DSPlibOscillatorBank (2, Frequencies, NULL, NULL, Rate);
+
+  // Start and end with silence
+  Bank->SetTone (0, Frequencies [0], 0.0);
+  Bank->SetTone (1, Frequencies [1], 0.0);
+  Bank->GenerateMix (Mix, GapLength);
+
+  for (long Loop = 0, Position = GapLength; AUTOTUNE_SYMBOLS [Loop] != '\0'; Loop++) {
+    SymbolType *Symbol = DTMF->Symbols;
+
+    while ((Symbol->Label [0] != AUTOTUNE_SYMBOLS [Loop]) || (Symbol->Label [1] != '\0')) {
+      Symbol++;
+    }
+
+    Bank->SetTone (0, Symbol->Frequencies [0], AUTOTUNE_AMPLITUDE);
+    Bank->SetTone (1, Symbol->Frequencies [1], AUTOTUNE_AMPLITUDE);
+    Bank->GenerateMix (&Mix [Position], ToneLength);
+    Position += ToneLength;
+
+    Bank->SetTone (0, Symbol->Frequencies [0], 0.0);
+    Bank->SetTone (1, Symbol->Frequencies [1], 0.0);
+    Bank->GenerateMix (&Mix [Position], GapLength);
+    Position += GapLength;
+  }
+
+  delete Bank;
+
+  *Length = Once;
+  Samples = new short [Once];
+
+  for (long Loop = 0; Loop < Once; Loop++) {
+    Samples [Loop] = (short) floor (Mix [Loop] * 32767.0 + 0.5);
+  }
+
+  delete [] Mix;
+
+  return Samples;
+}
+
+static double TimeEngine (int Engine, long Rate, ToneType *Tones, int ToneCount, long WindowMs, long HopMs,
+			  short *Samples, long Length, bool Check)
+{
+  ToneType DTMFTones [MAX_TONES];
+  int DTMFToneCount = 0;
+  DetectorType Detector;
+  AnalysisType Analysis;
+  PowerMatrixType Matrix;
+  float *Columns [MAX_TONES];
+  char Symbols [sizeof (AUTOTUNE_SYMBOLS)];
+  char *SavedLog;
+  long SavedLogSize, SavedLogLength;
+  bool SavedEcho;
+  EventWriter *SavedEvents;
+  DSPlibMetrics *SavedMetrics;
+  long WindowCount;
+  double Start, Time;
+  bool Good;
+
+  if (Check) {
+    SetupDetector (&Detector, FindProtocol ("dtmf"), DTMFTones, &DTMFToneCount);
+
+    Tones     = DTMFTones;
+    ToneCount = DTMFToneCount;
+  }
+
+  if (!SetAnalysisLengths (&Analysis, Engine, Rate, WindowMs, HopMs) || (Analysis.HopLength > Analysis.WindowLength)) {
+    if (Check) {
+      DeleteDetector (&Detector);
+    }
+
+    return -1.0;
+  }
+
+  Analysis.Tones     = Tones;
+  Analysis.ToneCount = ToneCount;
+
+  SetupAnalysis (&Analysis);
+
+  WindowCount = GetWindowCount (&Analysis, Length);
+
+  Start = Now ();
+  AnalyzeSamples (&Analysis, Samples, 0, 0, WindowCount, 1, &Matrix);
+  Time  = Now () - Start;
+
+  if (Check) {
+    // Decide on the powers without printing, sending events or counting anything and see if they came out right.
+    // The settings tt-dec's own decode uses go back the way they were afterwards.
+    SetDurationThresholds (&Detector, 1, Engine, Analysis.WindowMs, Analysis.HopMs);
+
+    for (int Tone = 0; Tone < ToneCount; Tone++) {
+      Columns [Tone] = &Matrix.Power [Tone * Matrix.WindowCount];
+    }
+
+    SavedLog       = SymbolLog;
+    SavedLogSize   = SymbolLogSize;
+    SavedLogLength = SymbolLogLength;
+    SavedEcho      = SymbolEcho;
+    SavedEvents    = SymbolEvents;
+    SavedMetrics   = SymbolMetrics;
+
+    SymbolLog       = Symbols;
+    SymbolLogSize   = sizeof (Symbols);
+    SymbolLogLength = 0;
+    SymbolEcho      = false;
+    SymbolEvents    = NULL;
+    SymbolMetrics   = NULL;
+
+    DetectSymbols (&Detector, 1, ToneCount, Columns, 0, Matrix.WindowCount, POWER_THRESHOLD, strlen (AUTOTUNE_SYMBOLS),
+		   NULL, NULL);
+
+    Good = (SymbolLogLength == (long) strlen (AUTOTUNE_SYMBOLS)) && (strcmp (Symbols, AUTOTUNE_SYMBOLS) == 0);
+
+    SymbolLog       = SavedLog;
+    SymbolLogSize   = SavedLogSize;
+    SymbolLogLength = SavedLogLength;
+    SymbolEcho      = SavedEcho;
+    SymbolEvents    = SavedEvents;
+    SymbolMetrics   = SavedMetrics;
+
+    DeleteDetector (&Detector);
+
+    if (!Good) {
+      Time = -1.0;
+    }
+  }
+
+  DeletePowerMatrix (&Matrix);
+  DeleteAnalysis (&Analysis);
+
+  return Time;
+}
@@ -0,0 +1,22 @@
+// Autotune.h
+//
+// Picks the fastest engine for a run.  Which engine wins depends on the rate
+// (the FIRs get longer as it goes up, the FFT's cost per hop doesn't move
+// much), on how many tones there are and on the CPU, so the only way to know
+// is to time them on the machine that's going to do the work.
+//
+// Every engine first has to decode a synthetic DTMF sequence correctly, then
+// the ones that did are timed on half a second of it.  The winner goes in a
+// profile file, one line per CPU, instruction set level (DSPLIB_ISA can hold
+// it back), rate, window, hop and tone table, so only the first run with
+// each combination pays for the timing.
+
+// The engine to ask for when it should be picked this way
+#define		ENGINE_AUTO			-1
+
+// Where the profile is kept when TT_DEC_PROFILE doesn't say: this file in the home directory
+#define		AUTOTUNE_PROFILE_NAME		".tt-dec-profile"
+
+// Pick the engine for Rate and a tone table with the window and hop that were asked for (0 for each engine's
+// default).  The profile is used if it has an answer, unless Retune is true.
+int ChooseEngine (long Rate, ToneType *Tones, int ToneCount, long WindowMs, long HopMs, bool Retune);
@@ -0,0 +1,162 @@
+// <BEHOLD the GPL!>
+// ntheory's tt-dec, a software-based, post processing style touch tone decoder
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "Cache.h"
+
+// The first line of every entry.  Anything else isn't one of ours (or is from a version whose results mean something
+// else) and doesn't count.
+#define		CACHE_MAGIC			"tt-dec cache 1"
+
+#define		CACHE_HASH_PRIME		1099511628211ULL
+
+unsigned long long HashSamples (short *Samples, long Count, unsigned long long Hash)
+{
+  for (long Loop = 0; Loop < Count; Loop++) {
+    Hash = (Hash ^ (unsigned short) Samples [Loop]) * CACHE_HASH_PRIME;
+  }
+
+  return Hash;
+}
+
+unsigned long long HashString (const char *String)
+{
+  unsigned long long Hash = CACHE_HASH_SEED;
+
+  for (; *String != '\0'; String++) {
+    Hash = (Hash ^ (unsigned char) *String) * CACHE_HASH_PRIME;
+  }
+
+  return Hash;
+}
+
+// Where an entry lives.  The caller deletes it.
+static char *GetEntryName (const char *Directory, unsigned long long SampleHash, const char *Fingerprint)
+{
+  char *Name = new char [strlen (Directory) + 64];
+
+  sprintf (Name, "%s/%02x/%016llx-%016llx", Directory, (unsigned int) (SampleHash >> 56), SampleHash,
+	   HashString (Fingerprint));
+
+  return Name;
+}
+
+// Read a line without its newline.  The caller deletes it.
+static char *GetLine (FILE *File)
+{
+  char *Line = NULL;
+  size_t Size = 0;
+  ssize_t Length;
+  char *Copy;
+
+  if ((Length = getline (&Line, &Size, File)) < 0) {
+    free (Line);
+    return NULL;
+  }
+
+  if ((Length > 0) && (Line [Length - 1] == '\n')) {
+    Line [--Length] = '\0';
+  }
+
+  Copy = new char [Length + 1];
+  memcpy (Copy, Line, Length + 1);
+  free (Line);
+
+  return Copy;
+}
+
+bool LookupCache (const char *Directory, unsigned long long SampleHash, const char *Fingerprint, int *Found,
+		  char *Symbols, long SymbolsSize)
+{
+  char *Name = GetEntryName (Directory, SampleHash, Fingerprint);
+  char *Lines [4] = { NULL, NULL, NULL, NULL };
+  bool Hit;
+  FILE *File;
+
+  File = fopen (Name, "r");
+  delete [] Name;
+
+  if (File == NULL) {
+    return false;
+  }
+
+  for (int Loop = 0; Loop < 4; Loop++) {
+    Lines [Loop] = GetLine (File);
+  }
+
+  fclose (File);
+
+  // The fingerprint has to match exactly, not just its hash
+  Hit = (Lines [3] != NULL) && (strcmp (Lines [0], CACHE_MAGIC) == 0) && (strcmp (Lines [1], Fingerprint) == 0) &&
+	((long) strlen (Lines [3]) < SymbolsSize);
+
+  if (Hit) {
+    *Found = atoi (Lines [2]);
+    strcpy (Symbols, Lines [3]);
+  }
+
+  for (int Loop = 0; Loop < 4; Loop++) {
+    delete [] Lines [Loop];
+  }
+
+  return Hit;
+}
+
+bool StoreCache (const char *Directory, unsigned long long SampleHash, const char *Fingerprint, int Found,
+		 const char *Symbols)
+{
+  char *Name = GetEntryName (Directory, SampleHash, Fingerprint);
+  char *TempName = new char [strlen (Name) + 32];
+  bool Good;
+  FILE *File;
+
+  // Make the directories if they aren't there yet (somebody else may be making them at the same time)
+  mkdir (Directory, 0777);
+
+  strcpy (TempName, Name);
+  *strrchr (TempName, '/') = '\0';
+  mkdir (TempName, 0777);
+
+  // Every process writes its own temporary file, and rename () swaps the whole entry in at once
+  sprintf (TempName, "%s.%ld.tmp", Name, (long) getpid ());
+
+  if ((File = fopen (TempName, "w")) == NULL) {
+    delete [] Name;
+    delete [] TempName;
+    return false;
+  }
+
+  Good = (fprintf (File, "%s\n%s\n%d\n%s\n", CACHE_MAGIC, Fingerprint, Found, Symbols) > 0);
+  Good = (fclose (File) == 0) && Good && (rename (TempName, Name) == 0);
+
+  if (!Good) {
+    remove (TempName);
+  }
+
+  delete [] Name;
+  delete [] TempName;
+
+  return Good;
+}
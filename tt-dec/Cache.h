@@ -0,0 +1,30 @@
+// Cache.h
+//
+// A cache of tt-dec's results on disk, so decoding the same recording with
+// the same settings again only costs reading it once to hash it.
+//
+// An entry is looked up by a hash of the samples that get decoded and a hash
+// of a line of text that describes the settings (the fingerprint).  Each one
+// is a small file of its own, named after the two hashes, in a directory
+// named after the first two hex digits of the samples' hash.  Entries are
+// written to a temporary file that's renamed into place, so any number of
+// tt-decs can share a cache: the worst that can happen is two of them decode
+// the same file and one's entry replaces the other's identical one.
+
+// Where the hashes start
+#define		CACHE_HASH_SEED			14695981039346656037ULL
+
+// Add Count samples to a hash (64 bit FNV-1a, a sample at a time)
+unsigned long long HashSamples (short *Samples, long Count, unsigned long long Hash);
+
+// Hash a string the same way (a character at a time)
+unsigned long long HashString (const char *String);
+
+// Look an entry up.  Returns true and fills in how many symbols there were and what was printed (up to SymbolsSize
+// characters) if there's one with exactly this fingerprint.
+bool LookupCache (const char *Directory, unsigned long long SampleHash, const char *Fingerprint, int *Found,
+		  char *Symbols, long SymbolsSize);
+
+// Save an entry, replacing any that's there.  Returns false if it couldn't be written.
+bool StoreCache (const char *Directory, unsigned long long SampleHash, const char *Fingerprint, int Found,
+		 const char *Symbols);
@@ -0,0 +1,225 @@
+// <BEHOLD the GPL!>
+// ntheory's tt-dec, a software-based, post processing style touch tone decoder
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include <stdio.h>
+#include <string.h>
+#include "Protocols.h"
+#include "Checkpoint.h"
+
+// Checkpoint files start with this, then a version number.  Everything after that is little endian 32 bit words
+// (the frequencies in hundredths of a Hz, the event powers as the bits of a float) apart from the protocol names and
+// the positions in the file (Origin, NextWindow, HistoryStart and the events' starts), which are 64 bit words so a
+// stream can go on for longer than 2^31 samples.
+#define		CHECKPOINT_MAGIC		"TTCP"
+#define		CHECKPOINT_VERSION		3
+
+static bool PutWord (FILE *File, long Word)
+{
+  unsigned char Bytes [4] = { (unsigned char) Word, (unsigned char) (Word >> 8),
+			      (unsigned char) (Word >> 16), (unsigned char) (Word >> 24) };
+
+  return (fwrite (Bytes, 1, 4, File) == 4);
+}
+
+static long GetWord (FILE *File, bool *Good)
+{
+  unsigned char Bytes [4];
+
+  if (fread (Bytes, 1, 4, File) != 4) {
+    *Good = false;
+    return 0;
+  }
+
+  return (int) (Bytes [0] | (Bytes [1] << 8) | (Bytes [2] << 16) | ((unsigned int) Bytes [3] << 24));
+}
+
+// A 64 bit word is its low 32 bits then its high 32 bits
+static bool PutLong (FILE *File, long long Long)
+{
+  return PutWord (File, (long) (Long & 0xffffffffLL)) && PutWord (File, (long) (Long >> 32));
+}
+
+static long long GetLong (FILE *File, bool *Good)
+{
+  unsigned long long Low  = (unsigned int) GetWord (File, Good);
+  unsigned long long High = (unsigned int) GetWord (File, Good);
+
+  return (long long) ((High << 32) | Low);
+}
+
+bool SaveCheckpoint (const char *FileName, CheckpointType *Checkpoint)
+{
+  char *TempName = new char [strlen (FileName) + strlen (".tmp") + 1];
+  unsigned char Bytes [2];
+  bool Good;
+  FILE *File;
+
+  strcpy (TempName, FileName);
+  strcat (TempName, ".tmp");
+
+  if ((File = fopen (TempName, "wb")) == NULL) {
+    delete [] TempName;
+    return false;
+  }
+
+  Good = (fwrite (CHECKPOINT_MAGIC, 1, 4, File) == 4) && PutWord (File, CHECKPOINT_VERSION) &&
+	 PutWord (File, Checkpoint->Engine) && PutWord (File, Checkpoint->Rate) &&
+	 PutWord (File, Checkpoint->WindowLength) && PutWord (File, Checkpoint->HopLength) &&
+	 PutWord (File, Checkpoint->ToneCount) && PutWord (File, Checkpoint->DetectorCount);
+
+  for (int Tone = 0; Tone < Checkpoint->ToneCount; Tone++) {
+    Good = Good && PutWord (File, (long) (Checkpoint->Frequencies [Tone] * 100.0 + 0.5));
+  }
+
+  for (int Detector = 0; Detector < Checkpoint->DetectorCount; Detector++) {
+    Good = Good && (fwrite (Checkpoint->Protocols [Detector], 1, sizeof (Checkpoint->Protocols [0]), File) ==
+		    sizeof (Checkpoint->Protocols [0]));
+
+    for (int Tone = 0; Tone < MAX_PROTOCOL_TONES; Tone++) {
+      Good = Good && PutWord (File, Checkpoint->Counters [Detector][Tone]);
+    }
+
+    Good = Good && PutWord (File, Checkpoint->EventSymbols [Detector]) && PutLong (File, Checkpoint->EventStarts [Detector]) &&
+	   PutWord (File, Checkpoint->EventWindows [Detector]) && PutWord (File, Checkpoint->EventPrinted [Detector]);
+
+    for (int Tone = 0; Tone < MAX_PROTOCOL_TONES; Tone++) {
+      unsigned int Bits;
+
+      memcpy (&Bits, &Checkpoint->EventPowers [Detector][Tone], sizeof (Bits));
+
+      Good = Good && PutWord (File, Bits);
+    }
+  }
+
+  Good = Good && PutLong (File, Checkpoint->Origin) && PutLong (File, Checkpoint->NextWindow) &&
+	 PutWord (File, Checkpoint->Found) && PutLong (File, Checkpoint->HistoryStart) &&
+	 PutWord (File, Checkpoint->HistoryLength);
+
+  for (long Loop = 0; Loop < Checkpoint->HistoryLength; Loop++) {
+    Bytes [0] = (unsigned char) Checkpoint->History [Loop];
+    Bytes [1] = (unsigned char) (Checkpoint->History [Loop] >> 8);
+
+    Good = Good && (fwrite (Bytes, 1, 2, File) == 2);
+  }
+
+  // Only put it in place once every byte of it made it to the disk
+  Good = (fclose (File) == 0) && Good && (rename (TempName, FileName) == 0);
+
+  if (!Good) {
+    remove (TempName);
+  }
+
+  delete [] TempName;
+
+  return Good;
+}
+
+bool LoadCheckpoint (const char *FileName, CheckpointType *Checkpoint)
+{
+  FILE *File = fopen (FileName, "rb");
+  unsigned char Bytes [2];
+  char Magic [4];
+  bool Good = true;
+
+  Checkpoint->History = NULL;
+
+  if (File == NULL) {
+    return false;
+  }
+
+  if ((fread (Magic, 1, 4, File) != 4) || (memcmp (Magic, CHECKPOINT_MAGIC, 4) != 0) ||
+      (GetWord (File, &Good) != CHECKPOINT_VERSION)) {
+    fclose (File);
+    return false;
+  }
+
+  Checkpoint->Engine        = GetWord (File, &Good);
+  Checkpoint->Rate          = GetWord (File, &Good);
+  Checkpoint->WindowLength  = GetWord (File, &Good);
+  Checkpoint->HopLength     = GetWord (File, &Good);
+  Checkpoint->ToneCount     = GetWord (File, &Good);
+  Checkpoint->DetectorCount = GetWord (File, &Good);
+
+  if (!Good || (Checkpoint->ToneCount < 0) || (Checkpoint->ToneCount > MAX_TONES) ||
+      (Checkpoint->DetectorCount < 0) || (Checkpoint->DetectorCount > MAX_DETECTORS)) {
+    fclose (File);
+    return false;
+  }
+
+  for (int Tone = 0; Tone < Checkpoint->ToneCount; Tone++) {
+    Checkpoint->Frequencies [Tone] = GetWord (File, &Good) / 100.0;
+  }
+
+  for (int Detector = 0; Detector < Checkpoint->DetectorCount; Detector++) {
+    Good = Good && (fread (Checkpoint->Protocols [Detector], 1, sizeof (Checkpoint->Protocols [0]), File) ==
+		    sizeof (Checkpoint->Protocols [0]));
+
+    Checkpoint->Protocols [Detector][sizeof (Checkpoint->Protocols [0]) - 1] = '\0';
+
+    for (int Tone = 0; Tone < MAX_PROTOCOL_TONES; Tone++) {
+      Checkpoint->Counters [Detector][Tone] = GetWord (File, &Good);
+    }
+
+    Checkpoint->EventSymbols [Detector] = GetWord (File, &Good);
+    Checkpoint->EventStarts  [Detector] = GetLong (File, &Good);
+    Checkpoint->EventWindows [Detector] = GetWord (File, &Good);
+    Checkpoint->EventPrinted [Detector] = (GetWord (File, &Good) != 0);
+
+    for (int Tone = 0; Tone < MAX_PROTOCOL_TONES; Tone++) {
+      unsigned int Bits = (unsigned int) GetWord (File, &Good);
+
+      memcpy (&Checkpoint->EventPowers [Detector][Tone], &Bits, sizeof (Bits));
+    }
+  }
+
+  Checkpoint->Origin        = GetLong (File, &Good);
+  Checkpoint->NextWindow    = GetLong (File, &Good);
+  Checkpoint->Found         = GetWord (File, &Good);
+  Checkpoint->HistoryStart  = GetLong (File, &Good);
+  Checkpoint->HistoryLength = GetWord (File, &Good);
+
+  if (!Good || (Checkpoint->HistoryLength < 0)) {
+    fclose (File);
+    return false;
+  }
+
+  Checkpoint->History = new short [Checkpoint->HistoryLength + 1];
+
+  for (long Loop = 0; (Loop < Checkpoint->HistoryLength) && Good; Loop++) {
+    Good = (fread (Bytes, 1, 2, File) == 2);
+
+    Checkpoint->History [Loop] = (short) (Bytes [0] | (Bytes [1] << 8));
+  }
+
+  fclose (File);
+
+  if (!Good) {
+    DeleteCheckpoint (Checkpoint);
+  }
+
+  return Good;
+}
+
+void DeleteCheckpoint (CheckpointType *Checkpoint)
+{
+  delete [] Checkpoint->History;
+
+  Checkpoint->History = NULL;
+}
@@ -0,0 +1,49 @@
+// Checkpoint.h
+//
+// Everything tt-dec needs to pick a decode back up where it left off: where
+// it was in the file, what the detectors had counted so far, and the samples
+// the next piece of the file needs from before it.
+//
+// Those samples stand in for the filters' state.  An FIR's history, the
+// running sums over the analysis window and (to within the warmup) the
+// resonators are all made from them again exactly the way they would have
+// been if the decode had never stopped, and it's only a few thousand samples.
+
+typedef struct {
+  // What the decode was set up with.  A checkpoint only fits the same settings.
+  int    Engine;
+  long   Rate;
+  long   WindowLength, HopLength;
+  int    ToneCount;
+  double Frequencies [MAX_TONES];
+  int    DetectorCount;
+  char   Protocols [MAX_DETECTORS][16];
+
+  // Where we were.  Windows are counted from sample Origin of the file and NextWindow is the first one that hasn't
+  // been decided on yet.  Found is how many symbols have been printed so far.
+  long Origin;
+  long NextWindow;
+  int  Found;
+
+  // Each detector's counters, and the symbol it was following for the events (see DetectorType)
+  int Counters [MAX_DETECTORS][MAX_PROTOCOL_TONES];
+
+  int   EventSymbols [MAX_DETECTORS];
+  long  EventStarts  [MAX_DETECTORS], EventWindows [MAX_DETECTORS];
+  bool  EventPrinted [MAX_DETECTORS];
+  float EventPowers  [MAX_DETECTORS][MAX_PROTOCOL_TONES];
+
+  // The samples (counted from Origin) from HistoryStart on that have already been read
+  long   HistoryStart;
+  long   HistoryLength;
+  short *History;
+} CheckpointType;
+
+// Write a checkpoint.  It goes to a temporary file that's renamed over FileName once it's all there, so a worker that
+// dies halfway through writing one leaves the last one alone.  Returns false if it couldn't be written.
+bool SaveCheckpoint (const char *FileName, CheckpointType *Checkpoint);
+
+// Read one back.  Returns false if the file isn't there or isn't a checkpoint.
+bool LoadCheckpoint (const char *FileName, CheckpointType *Checkpoint);
+
+void DeleteCheckpoint (CheckpointType *Checkpoint);
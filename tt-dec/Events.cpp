@@ -0,0 +1,288 @@
+// <BEHOLD the GPL!>
+// ntheory's tt-dec, a software-based, post processing style touch tone decoder
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "Events.h"
+
+// The most one event can take up in any format.  The buffer always has this much room left when an event goes in.
+#define		EVENT_MAX_RECORD		1024
+
+const char *EventFormatNames [EVENT_FORMAT_COUNT] = { "binary", "csv", "json" };
+
+int FindEventFormat (const char *Name)
+{
+  for (int Format = 0; Format < EVENT_FORMAT_COUNT; Format++) {
+    if (strcmp (EventFormatNames [Format], Name) == 0) {
+      return Format;
+    }
+  }
+
+  return -1;
+}
+
+int GuessEventFormat (const char *FileName)
+{
+  const char *Extension = strrchr (FileName, '.');
+
+  if (Extension == NULL) {
+    return EVENT_FORMAT_BINARY;
+  }
+
+  if (strcmp (Extension, ".csv") == 0) {
+    return EVENT_FORMAT_CSV;
+  }
+
+  if ((strcmp (Extension, ".json") == 0) || (strcmp (Extension, ".jsonl") == 0)) {
+    return EVENT_FORMAT_JSON;
+  }
+
+  return EVENT_FORMAT_BINARY;
+}
+
+static double Now ()
+{
+  struct timespec Time;
+
+  clock_gettime (CLOCK_MONOTONIC, &Time);
+
+  return (double) Time.tv_sec + (double) Time.tv_nsec / 1e9;
+}
+
+// Little endian helpers for the binary records.  They return how many bytes they put in.
+static int PutWord (char *Out, unsigned int Word)
+{
+  for (int Loop = 0; Loop < 4; Loop++) {
+    Out [Loop] = (char) (Word >> (8 * Loop));
+  }
+
+  return 4;
+}
+
+static int PutLong (char *Out, long long Word)
+{
+  for (int Loop = 0; Loop < 8; Loop++) {
+    Out [Loop] = (char) ((unsigned long long) Word >> (8 * Loop));
+  }
+
+  return 8;
+}
+
+static int PutFloat (char *Out, float Value)
+{
+  unsigned int Word;
+
+  memcpy (&Word, &Value, sizeof (Word));
+
+  return PutWord (Out, Word);
+}
+
+static int PutChars (char *Out, const char *String, int Size)
+{
+  memset (Out, 0, Size);
+  strncpy (Out, String, Size);
+
+  return Size;
+}
+
+// Copy a string into a JSON one (with the quotes).  None of the labels need it yet but nothing stops them.
+static int PutJSONString (char *Out, const char *String)
+{
+  int Length = 0;
+
+  Out [Length++] = '"';
+
+  for (; (*String != '\0') && (Length < 64); String++) {
+    if ((*String == '"') || (*String == '\\')) {
+      Out [Length++] = '\\';
+    }
+
+    Out [Length++] = *String;
+  }
+
+  Out [Length++] = '"';
+
+  return Length;
+}
+
+// Basic constructor
+EventWriter::EventWriter (const char *FileName, int Format, bool Append, long FlushBytes, long FlushMs)
+{
+  char *Header = new char [EVENT_MAX_RECORD];
+  long  Length = 0;
+
+  this->Format     = Format;
+  this->BufferSize = FlushBytes + EVENT_MAX_RECORD;
+  this->Buffer     = new char [this->BufferSize];
+  this->Buffered   = 0;
+  this->FlushMs    = FlushMs;
+  this->LastFlush  = Now ();
+
+  this->SetStream (0, 8000, 0, 0, 1, 1);
+
+  if (strcmp (FileName, "-") == 0) {
+    this->File = stdout;
+  }
+  else {
+    this->File = fopen (FileName, Append ? "ab" : "wb");
+  }
+
+  this->Good = (this->File != NULL);
+
+  if (!this->Good) {
+    delete [] Header;
+    return;
+  }
+
+  // A file that's being added to already has its header
+  if (Append && (this->File != stdout)) {
+    fseek (this->File, 0, SEEK_END);
+
+    if (ftell (this->File) > 0) {
+      delete [] Header;
+      return;
+    }
+  }
+
+  switch (Format) {
+    case EVENT_FORMAT_BINARY:
+      memcpy (Header, EVENT_BINARY_MAGIC, 4);
+
+      Length  = 4;
+      Length += PutWord (&Header [Length], EVENT_BINARY_VERSION);
+      Length += PutWord (&Header [Length], EVENT_BINARY_RECORD);
+      break;
+
+    case EVENT_FORMAT_CSV:
+      Length = sprintf (Header, "stream,protocol,symbol,onset,offset,duration_ms,frequency1,power1,frequency2,power2,"
+			"other_power\n");
+      break;
+  }
+
+  this->Good = (fwrite (Header, 1, Length, this->File) == (size_t) Length);
+
+  delete [] Header;
+}
+
+EventWriter::~EventWriter ()
+{
+  if (this->File != NULL) {
+    this->Flush ();
+
+    if (this->File != stdout) {
+      fclose (this->File);
+    }
+  }
+
+  delete [] this->Buffer;
+}
+
+bool EventWriter::IsGood ()
+{
+  return this->Good;
+}
+
+void EventWriter::SetStream (int Stream, long Rate, long Origin, long Delay, long HopLength, long WindowLength)
+{
+  this->Stream       = Stream;
+  this->Rate         = Rate;
+  this->Origin       = Origin;
+  this->Delay        = Delay;
+  this->HopLength    = HopLength;
+  this->WindowLength = WindowLength;
+}
+
+void EventWriter::PutEvent (EventType *Event)
+{
+  char  *Out      = &this->Buffer [this->Buffered];
+  long   Onset    = this->Origin + this->Delay + Event->FirstWindow * this->HopLength;
+  long   Offset   = this->Origin + this->Delay + (Event->LastWindow - 1) * this->HopLength + this->WindowLength;
+  double Duration = (Offset - Onset) * 1000.0 / (double) this->Rate;
+  int    Length   = 0;
+
+  switch (this->Format) {
+    case EVENT_FORMAT_BINARY:
+      Length += PutWord  (&Out [Length], this->Stream);
+      Length += PutChars (&Out [Length], Event->Protocol, 8);
+      Length += PutChars (&Out [Length], Event->Symbol, 12);
+      Length += PutLong  (&Out [Length], Onset);
+      Length += PutLong  (&Out [Length], Offset);
+      Length += PutFloat (&Out [Length], (float) Duration);
+
+      for (int Tone = 0; Tone < 2; Tone++) {
+	Length += PutFloat (&Out [Length], (float) Event->Frequencies [Tone]);
+	Length += PutFloat (&Out [Length], Event->Powers [Tone]);
+      }
+
+      Length += PutFloat (&Out [Length], Event->OtherPower);
+      break;
+
+    case EVENT_FORMAT_CSV:
+      Length = snprintf (Out, EVENT_MAX_RECORD, "%d,%s,%s,%ld,%ld,%.3f,%g,%g,%g,%g,%g\n", this->Stream, Event->Protocol,
+			 Event->Symbol, Onset, Offset, Duration, Event->Frequencies [0], Event->Powers [0],
+			 Event->Frequencies [1], Event->Powers [1], Event->OtherPower);
+      break;
+
+    case EVENT_FORMAT_JSON:
+      Length  = sprintf (Out, "{\"stream\":%d,\"protocol\":", this->Stream);
+      Length += PutJSONString (&Out [Length], Event->Protocol);
+      Length += sprintf (&Out [Length], ",\"symbol\":");
+      Length += PutJSONString (&Out [Length], Event->Symbol);
+      Length += sprintf (&Out [Length], ",\"onset\":%ld,\"offset\":%ld,\"duration_ms\":%.3f,\"tones\":[", Onset, Offset,
+			 Duration);
+
+      for (int Tone = 0; Tone < Event->ToneCount; Tone++) {
+	Length += sprintf (&Out [Length], "%s{\"frequency\":%g,\"power\":%g}", (Tone == 0) ? "" : ",",
+			   Event->Frequencies [Tone], Event->Powers [Tone]);
+      }
+
+      Length += sprintf (&Out [Length], "],\"other_power\":%g}\n", Event->OtherPower);
+      break;
+  }
+
+  this->Buffered += Length;
+
+  // There always has to be room for the next one
+  if (this->Buffered > (this->BufferSize - EVENT_MAX_RECORD)) {
+    this->Flush ();
+  }
+  else {
+    this->Poll ();
+  }
+}
+
+void EventWriter::Poll ()
+{
+  if ((this->Buffered > 0) && ((Now () - this->LastFlush) * 1000.0 >= this->FlushMs)) {
+    this->Flush ();
+  }
+}
+
+void EventWriter::Flush ()
+{
+  if ((this->File != NULL) && (this->Buffered > 0)) {
+    this->Good = (fwrite (this->Buffer, 1, this->Buffered, this->File) == (size_t) this->Buffered) && this->Good;
+    this->Good = (fflush (this->File) == 0) && this->Good;
+  }
+
+  this->Buffered  = 0;
+  this->LastFlush = Now ();
+}
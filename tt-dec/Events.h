@@ -0,0 +1,102 @@
+// Events.h
+//
+// A record of every symbol tt-dec finds, for other programs to read: which
+// stream it was in, where it started and stopped in the samples, how long it
+// lasted and how strong its tones were.  A symbol only becomes an event once
+// it's over, so events come out a little after the symbol gets printed.
+//
+// Events are formatted into a buffer that's only written out when it has
+// FlushBytes in it or FlushMs has gone by since it was last written, so a busy
+// decode makes one write for thousands of events and a quiet one still gets
+// them out promptly.
+//
+// The formats:
+//
+//   binary   "TTEV", then a 32 bit version and record size, then one 64 byte
+//            record per event, all little endian:
+//              stream                         32 bit integer
+//              protocol, symbol               8 and 12 characters, padded with 0s
+//              onset, offset                  64 bit integers (samples, offset is one past the end)
+//              duration_ms                    32 bit float
+//              frequency1, power1             32 bit floats (the symbol's tones, frequency2 is 0 for one)
+//              frequency2, power2
+//              other_power                    32 bit float (the loudest of the protocol's other tones)
+//   csv      a header line, then those fields one event per line
+//   json     one JSON object per line with the same names ("tones" is a list)
+//
+// Powers are averaged over the event and are on the same scale as the band
+// powers in a trace.
+
+#define		EVENT_FORMAT_BINARY		0
+#define		EVENT_FORMAT_CSV		1
+#define		EVENT_FORMAT_JSON		2
+#define		EVENT_FORMAT_COUNT		3
+
+#define		EVENT_BINARY_MAGIC		"TTEV"
+#define		EVENT_BINARY_VERSION		1
+#define		EVENT_BINARY_RECORD		64
+
+// When the buffer gets written unless --flush-kb and --flush-ms say otherwise
+#define		EVENT_FLUSH_BYTES		65536
+#define		EVENT_FLUSH_MS			1000
+
+// The formats' names ("binary", "csv" and "json"), the format with a name (-1 if there isn't one), and the format a
+// file name suggests (.csv, .json or .jsonl, and binary for anything else)
+extern const char *EventFormatNames [EVENT_FORMAT_COUNT];
+
+int FindEventFormat  (const char *Name);
+int GuessEventFormat (const char *FileName);
+
+// One symbol from start to end, as DetectSymbols sees it: windows from FirstWindow up to but not including
+// LastWindow.  The writer turns the windows into samples.
+typedef struct {
+  const char *Protocol;
+  const char *Symbol;
+  long        FirstWindow, LastWindow;
+
+  int         ToneCount;
+  double      Frequencies [2];
+  float       Powers [2];
+  float       OtherPower;
+} EventType;
+
+class EventWriter {
+  public:
+    // Basic constructor.  Creates FileName ("-" for standard output), or adds
+    // to the end of it if Append is true (the header is only written if it
+    // was empty).
+    EventWriter (const char *FileName, int Format, bool Append, long FlushBytes, long FlushMs);
+
+    // Destructor (writes whatever's still buffered and closes the file)
+    ~EventWriter ();
+
+    // False if the file couldn't be created or a write failed.
+    bool IsGood ();
+
+    // Which stream the events are from and where its windows are: window n
+    // starts at sample Origin + Delay + n * HopLength of the stream and is
+    // WindowLength samples long.
+    void SetStream (int Stream, long Rate, long Origin, long Delay, long HopLength, long WindowLength);
+
+    // Add an event, and write the buffer if it's time.
+    void PutEvent (EventType *Event);
+
+    // Write the buffer if FlushMs has gone by since it was last written.
+    void Poll ();
+
+    // Write out whatever's buffered.
+    void Flush ();
+
+  private:
+    FILE *File;
+    bool  Good;
+    int   Format;
+
+    int  Stream;
+    long Rate, Origin, Delay, HopLength, WindowLength;
+
+    char  *Buffer;
+    long   BufferSize, Buffered;
+    long   FlushMs;
+    double LastFlush;
+};
@@ -0,0 +1,480 @@
+// <BEHOLD the GPL!>
+// ntheory's tt-dec, a software-based, post processing style touch tone decoder
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include <rfftw.h>
+#include <stdio.h>
+#include <string.h>
+#include "../library/DSPlibMetrics.h"
+#include "../library/DSPlibTrace.h"
+#include "Protocols.h"
+#include "Events.h"
+
+// How many windows DetectSymbols works out the tone masks for at a time
+#define		DETECT_BLOCK			1024
+
+// Set in a window's mask when the protocol's tones are too quiet to look at
+#define		QUIET_MASK			(1 << MAX_PROTOCOL_TONES)
+
+// DTMF: one row and one column
+static SymbolType DTMFSymbols [] = {
+  { "1", { ROW1, COL1 } }, { "2", { ROW1, COL2 } }, { "3", { ROW1, COL3 } }, { "A", { ROW1, COL4 } },
+  { "4", { ROW2, COL1 } }, { "5", { ROW2, COL2 } }, { "6", { ROW2, COL3 } }, { "B", { ROW2, COL4 } },
+  { "7", { ROW3, COL1 } }, { "8", { ROW3, COL2 } }, { "9", { ROW3, COL3 } }, { "C", { ROW3, COL4 } },
+  { "*", { ROW4, COL1 } }, { "0", { ROW4, COL2 } }, { "#", { ROW4, COL3 } }, { "D", { ROW4, COL4 } },
+  { NULL }
+};
+
+// R1 MF: two out of six
+static SymbolType MFSymbols [] = {
+  { "[MF 1]",    { 700,  900  } }, { "[MF 2]",    { 700,  1100 } }, { "[MF 3]",    { 900,  1100 } },
+  { "[MF 4]",    { 700,  1300 } }, { "[MF 5]",    { 900,  1300 } }, { "[MF 6]",    { 1100, 1300 } },
+  { "[MF 7]",    { 700,  1500 } }, { "[MF 8]",    { 900,  1500 } }, { "[MF 9]",    { 1100, 1500 } },
+  { "[MF 0]",    { 1300, 1500 } }, { "[MF KP]",   { 1100, 1700 } }, { "[MF ST]",   { 1500, 1700 } },
+  { "[MF ST']",  { 900,  1700 } }, { "[MF ST'']", { 1300, 1700 } }, { "[MF ST''']", { 700, 1700 } },
+  { NULL }
+};
+
+// North American call progress.  Busy and reorder are the same pair at different cadences, which we don't time.
+static SymbolType ProgressSymbols [] = {
+  { "[dial tone]", { 350, 440 } },
+  { "[ringback]",  { 440, 480 } },
+  { "[busy]",      { 480, 620 } },
+  { NULL }
+};
+
+// Fax calling and answer tones.  They're single tones so the protocol also compares them against three guard
+// frequencies nothing is ever sent on.  Speech spreads out over all of them where a real CNG or CED doesn't.
+static SymbolType FaxSymbols [] = {
+  { "[fax CNG]", { 1100, 0 } },
+  { "[fax CED]", { 2100, 0 } },
+  { NULL }
+};
+
+ProtocolType Protocols [] = {
+  { "dtmf",     { ROW1, ROW2, ROW3, ROW4, COL1, COL2, COL3, COL4 }, DTMFSymbols,
+		SIDE_DTMF_TOLERANCE, 2.0 * ROW1 * SIDE_DTMF_TOLERANCE * RESONATOR_BANDWIDTH_SCALE, MIN_DTMF_DURATION_MS },
+  { "mf",       { 700, 900, 1100, 1300, 1500, 1700 },                MFSymbols,       0.015, 50.0, 30  },
+  { "progress", { 350, 440, 480, 620 },                              ProgressSymbols, 0.01,  10.0, 100 },
+  { "fax",      { 600, 1100, 1600, 2100, 2600 },                     FaxSymbols,      0.02,  50.0, 400 },
+  { NULL }
+};
+
+char          *SymbolLog       = NULL;
+long           SymbolLogSize   = 0;
+long           SymbolLogLength = 0;
+bool           SymbolEcho      = true;
+EventWriter   *SymbolEvents    = NULL;
+DSPlibMetrics *SymbolMetrics   = NULL;
+
+ProtocolType *FindProtocol (const char *Name)
+{
+  for (int Loop = 0; Protocols [Loop].Name != NULL; Loop++) {
+    if (strcmp (Protocols [Loop].Name, Name) == 0) {
+      return &Protocols [Loop];
+    }
+  }
+
+  return NULL;
+}
+
+bool SetupDetector (DetectorType *Detector, ProtocolType *Protocol, ToneType *Tones, int *ToneCount)
+{
+  double Frequency, Lower, Upper, LowPass, HighPass, LowStop, HighStop;
+  int Tone;
+
+  Detector->Protocol  = Protocol;
+  Detector->ToneCount = 0;
+
+  while ((Detector->ToneCount < MAX_PROTOCOL_TONES) && (Protocol->Frequencies [Detector->ToneCount] != 0.0)) {
+    Detector->ToneCount++;
+  }
+
+  for (int Loop = 0; Loop < Detector->ToneCount; Loop++) {
+    Frequency = Protocol->Frequencies [Loop];
+
+    // Find the protocol's tones on either side of this one
+    Lower = 0.0;
+    Upper = 0.0;
+
+    for (int Other = 0; Other < Detector->ToneCount; Other++) {
+      double Neighbour = Protocol->Frequencies [Other];
+
+      if ((Neighbour < Frequency) && (Neighbour > Lower))                     Lower = Neighbour;
+      if ((Neighbour > Frequency) && ((Upper == 0.0) || (Neighbour < Upper))) Upper = Neighbour;
+    }
+
+    // The filter passes the tone plus or minus the tolerance, and has to have stopped by the time it gets to the edge
+    // of the pass band of the tone next to it.  The lowest and highest tones have nothing on one side so we give them
+    // the same room as the other side.
+    LowPass  = Frequency * (1.0 - Protocol->Tolerance);
+    HighPass = Frequency * (1.0 + Protocol->Tolerance);
+
+    LowStop  = (Lower > 0.0) ? Lower * (1.0 + Protocol->Tolerance) : 0.0;
+    HighStop = (Upper > 0.0) ? Upper * (1.0 - Protocol->Tolerance) : 0.0;
+
+    if (Lower == 0.0) LowStop  = LowPass  - (HighStop - HighPass);
+    if (Upper == 0.0) HighStop = HighPass + (LowPass - LowStop);
+
+    // Share the tone if another protocol already has it, with a spec that's strict enough for both
+    for (Tone = 0; Tone < *ToneCount; Tone++) {
+      if (Tones [Tone].Frequency == Frequency) {
+	break;
+      }
+    }
+
+    if (Tone == *ToneCount) {
+      if (*ToneCount == MAX_TONES) {
+	return false;
+      }
+
+      Tones [Tone].Frequency = Frequency;
+      Tones [Tone].LowStop   = LowStop;
+      Tones [Tone].LowPass   = LowPass;
+      Tones [Tone].HighPass  = HighPass;
+      Tones [Tone].HighStop  = HighStop;
+      Tones [Tone].Bandwidth = Protocol->Bandwidth;
+
+      (*ToneCount)++;
+    }
+    else {
+      if (LowStop  > Tones [Tone].LowStop)   Tones [Tone].LowStop   = LowStop;
+      if (LowPass  < Tones [Tone].LowPass)   Tones [Tone].LowPass   = LowPass;
+      if (HighPass > Tones [Tone].HighPass)  Tones [Tone].HighPass  = HighPass;
+      if (HighStop < Tones [Tone].HighStop)  Tones [Tone].HighStop  = HighStop;
+
+      if (Protocol->Bandwidth < Tones [Tone].Bandwidth) Tones [Tone].Bandwidth = Protocol->Bandwidth;
+    }
+
+    Detector->Tones    [Loop] = Tone;
+    Detector->Counters [Loop] = 0;
+  }
+
+  // Turn each symbol's frequencies into positions in the protocol's tone list
+  for (Detector->SymbolCount = 0; Protocol->Symbols [Detector->SymbolCount].Label != NULL; Detector->SymbolCount++);
+
+  Detector->SymbolTones = new int [Detector->SymbolCount][2];
+
+  for (int Mask = 0; Mask < (1 << MAX_PROTOCOL_TONES); Mask++) {
+    Detector->SymbolByMask [Mask] = -1;
+  }
+
+  for (int Symbol = 0; Symbol < Detector->SymbolCount; Symbol++) {
+    for (int Half = 0; Half < 2; Half++) {
+      Detector->SymbolTones [Symbol][Half] = -1;
+
+      for (int Loop = 0; Loop < Detector->ToneCount; Loop++) {
+	if (Protocol->Symbols [Symbol].Frequencies [Half] == Protocol->Frequencies [Loop]) {
+	  Detector->SymbolTones [Symbol][Half] = Loop;
+	}
+      }
+    }
+
+    // A symbol is its one or two tones on and every other tone off
+    Detector->SymbolByMask [(1 << Detector->SymbolTones [Symbol][0]) |
+			    ((Detector->SymbolTones [Symbol][1] < 0) ? 0 : (1 << Detector->SymbolTones [Symbol][1]))] = Symbol;
+  }
+
+  Detector->DurationThreshold = 1;
+  Detector->EventSymbol       = -1;
+
+  // Nothing gets counted until it's given somewhere to count it
+  Detector->WindowMetric = -1;
+  Detector->QuietMetric  = -1;
+  Detector->SymbolMetric = -1;
+
+  return true;
+}
+
+void DeleteDetector (DetectorType *Detector)
+{
+  delete [] Detector->SymbolTones;
+}
+
+static void LogSymbol (const char *Label)
+{
+  for (; *Label != '\0'; Label++, SymbolLogLength++) {
+    if (SymbolLogLength < (SymbolLogSize - 1)) {
+      SymbolLog [SymbolLogLength] = *Label;
+    }
+  }
+
+  SymbolLog [(SymbolLogLength < SymbolLogSize) ? SymbolLogLength : (SymbolLogSize - 1)] = '\0';
+}
+
+// Send the symbol a detector has been following to SymbolEvents.  Its own tones' powers are kept apart from the
+// loudest of the rest, which is what a symbol's levels usually get compared against.
+static void PutEvent (DetectorType *Detector)
+{
+  int *Pair = Detector->SymbolTones [Detector->EventSymbol];
+  EventType Event;
+
+  Event.Protocol    = Detector->Protocol->Name;
+  Event.Symbol      = Detector->Protocol->Symbols [Detector->EventSymbol].Label;
+  Event.FirstWindow = Detector->EventStart;
+  Event.LastWindow  = Detector->EventStart + Detector->EventWindows;
+  Event.ToneCount   = (Pair [1] < 0) ? 1 : 2;
+  Event.OtherPower  = 0.0f;
+
+  for (int Tone = 0; Tone < Detector->ToneCount; Tone++) {
+    float Power = Detector->EventPowers [Tone] / (float) Detector->EventWindows;
+
+    if ((Tone == Pair [0]) || (Tone == Pair [1])) {
+      Event.Frequencies [(Tone == Pair [0]) ? 0 : 1] = Detector->Protocol->Frequencies [Tone];
+      Event.Powers      [(Tone == Pair [0]) ? 0 : 1] = Power;
+    }
+    else if (Power > Event.OtherPower) {
+      Event.OtherPower = Power;
+    }
+  }
+
+  if (Event.ToneCount == 1) {
+    Event.Frequencies [1] = 0.0;
+    Event.Powers      [1] = 0.0f;
+  }
+
+  SymbolEvents->PutEvent (&Event);
+}
+
+// Follow the symbol (-1 for none) a detector's tones make in window Window of the file (Index in Columns) from
+// start to end.  It only becomes an event once it stops, and only if it got printed on the way.
+static void TrackEvent (DetectorType *Detector, int Symbol, float **Columns, long Index, long Window)
+{
+  if (Symbol != Detector->EventSymbol) {
+    if ((Detector->EventSymbol >= 0) && Detector->EventPrinted) {
+      PutEvent (Detector);
+    }
+
+    Detector->EventSymbol  = Symbol;
+    Detector->EventStart   = Window;
+    Detector->EventWindows = 0;
+    Detector->EventPrinted = false;
+
+    memset (Detector->EventPowers, 0, sizeof (Detector->EventPowers));
+  }
+
+  if (Symbol >= 0) {
+    for (int Tone = 0; Tone < Detector->ToneCount; Tone++) {
+      Detector->EventPowers [Tone] += Columns [Detector->Tones [Tone]][Index];
+    }
+
+    Detector->EventWindows++;
+  }
+}
+
+// Symbol detection ---------------------------------------------------------------------------------------------------
+//   Description:
+//     Ok, here's the meat of the algorithm.  Basically we look to see which of a protocol's tones have a power greater
+//       than the average power of them all.  If they aren't exactly the tones of one of the protocol's symbols (one
+//       row and one column for DTMF, two of six for MF, one tone for fax) then we can't decypher which one is correct
+//       so we throw it away.
+//
+//     We also keep track of how many hops in a row a tone has passed this test.  Once both of a symbol's tones have
+//       passed it exactly DurationThreshold times we'll print it out.  We then keep counting the number of times they
+//       pass the test.  Once one fails we'll reset it to zero.  Since we only print success messages when it's
+//       exactly equal to DurationThreshold the symbols can be as long as they'd like and they'll only be printed
+//       once.
+//
+//     ::whew::
+//
+//   Notes:
+//     The averages and the masks of tones that are above them are worked out a column at a time for a block of
+//       windows, which the compiler can do several windows at a time.  Only the counters have to go window by window,
+//       and every detector takes its turn at each window so the symbols still come out in order.
+// --------------------------------------------------------------------------------------------------------------------
+
+int DetectSymbols (DetectorType *Detectors, int DetectorCount, int ToneCount, float **Columns, long FirstWindow,
+		   long WindowCount, double PowerThreshold, int MaxSymbols, long *Decided, DSPlibTraceWriter *Trace)
+{
+  float Average [DETECT_BLOCK];
+  unsigned short *Masks = new unsigned short [DetectorCount * DETECT_BLOCK];
+  float *Decisions = new float [2 * DetectorCount * DETECT_BLOCK];
+  float *TraceColumns [MAX_TONES + 2 * MAX_DETECTORS];
+  float Threshold = (float) PowerThreshold;
+  int Found = 0;
+
+  if (Decided != NULL) {
+    *Decided = 0;
+  }
+
+  for (long First = 0; (First < WindowCount) && ((MaxSymbols == 0) || (Found < MaxSymbols)); First += DETECT_BLOCK) {
+    long Length = ((WindowCount - First) < DETECT_BLOCK) ? (WindowCount - First) : DETECT_BLOCK;
+
+    for (int Loop = 0; Loop < DetectorCount; Loop++) {
+      DetectorType   *Detector = &Detectors [Loop];
+      unsigned short *Mask     = &Masks [Loop * DETECT_BLOCK];
+
+      // Calculate the total power of the protocol's tones and get the average of it by dividing by the number of them
+      for (long Window = 0; Window < Length; Window++) {
+	Average [Window] = 0.0f;
+      }
+
+      for (int Tone = 0; Tone < Detector->ToneCount; Tone++) {
+	float *Power = &Columns [Detector->Tones [Tone]][First];
+
+	for (long Window = 0; Window < Length; Window++) {
+	  Average [Window] += Power [Window];
+	}
+      }
+
+      for (long Window = 0; Window < Length; Window++) {
+	Average [Window] /= (float) Detector->ToneCount;
+	Mask    [Window]  = (Average [Window] < Threshold) ? QUIET_MASK : 0;
+      }
+
+      // Mark the tones that are above the average
+      for (int Tone = 0; Tone < Detector->ToneCount; Tone++) {
+	float *Power = &Columns [Detector->Tones [Tone]][First];
+
+	for (long Window = 0; Window < Length; Window++) {
+	  Mask [Window] |= (Power [Window] > Average [Window]) << Tone;
+	}
+      }
+    }
+
+    for (long Window = 0; Window < Length; Window++) {
+      for (int Loop = 0; Loop < DetectorCount; Loop++) {
+	DetectorType *Detector = &Detectors [Loop];
+	int Mask = Masks [Loop * DETECT_BLOCK + Window];
+	int Symbol, *Pair;
+	float *Matched = &Decisions [(2 * Loop) * DETECT_BLOCK + Window];
+	float *Printed = &Decisions [(2 * Loop + 1) * DETECT_BLOCK + Window];
+
+	*Matched = -1.0f;
+	*Printed =  0.0f;
+
+	// Follow whatever symbol this is from start to end for the events
+	if (SymbolEvents != NULL) {
+	  TrackEvent (Detector, (Mask & QUIET_MASK) ? -1 : Detector->SymbolByMask [Mask], Columns, First + Window,
+		      FirstWindow + First + Window);
+	}
+
+	// If the power is too low we don't look any further
+	if (Mask & QUIET_MASK) {
+	  memset (Detector->Counters, 0, sizeof (Detector->Counters));
+	  continue;
+	}
+
+	// Increment the counters where necessary
+	for (int Tone = 0; Tone < Detector->ToneCount; Tone++) {
+	  Detector->Counters [Tone] = (Mask & (1 << Tone)) ? (Detector->Counters [Tone] + 1) : 0;
+	}
+
+	// We didn't detect one of the symbols.  Clear the counters.
+	if ((Symbol = Detector->SymbolByMask [Mask]) < 0) {
+	  memset (Detector->Counters, 0, sizeof (Detector->Counters));
+	  continue;
+	}
+
+	// Check to see if they've been around long enough
+	Pair     = Detector->SymbolTones [Symbol];
+	*Matched = (float) Symbol;
+
+	if ((Detector->Counters [Pair [0]] == Detector->DurationThreshold) &&
+	    ((Pair [1] < 0) || (Detector->Counters [Pair [1]] == Detector->DurationThreshold))) {
+	  if (SymbolEcho) {
+	    printf ("%s", Detector->Protocol->Symbols [Symbol].Label);
+	  }
+
+	  Found++;
+	  *Printed = 1.0f;
+
+	  Detector->EventPrinted = true;
+
+	  if ((SymbolMetrics != NULL) && (Detector->SymbolMetric >= 0)) {
+	    SymbolMetrics->Add (Detector->SymbolMetric, 1);
+	  }
+
+	  if (SymbolLog != NULL) {
+	    LogSymbol (Detector->Protocol->Symbols [Symbol].Label);
+	  }
+	}
+      }
+
+      // That's all we were asked for, so this is the last window (and the last one traced)
+      if ((MaxSymbols != 0) && (Found >= MaxSymbols)) {
+	Length = Window + 1;
+      }
+    }
+
+    // Count the windows each detector got through and how many of them the threshold kept it from looking at
+    if (SymbolMetrics != NULL) {
+      for (int Loop = 0; Loop < DetectorCount; Loop++) {
+	unsigned short *Mask = &Masks [Loop * DETECT_BLOCK];
+	long Quiet = 0;
+
+	if ((Detectors [Loop].WindowMetric < 0) || (Detectors [Loop].QuietMetric < 0)) {
+	  continue;
+	}
+
+	for (long Window = 0; Window < Length; Window++) {
+	  Quiet += Mask [Window] >> MAX_PROTOCOL_TONES;
+	}
+
+	SymbolMetrics->Add (Detectors [Loop].WindowMetric, Length);
+	SymbolMetrics->Add (Detectors [Loop].QuietMetric,  Quiet);
+      }
+    }
+
+    // The powers go straight from the matrix into the trace, then the decisions we just made
+    if (Trace != NULL) {
+      for (int Tone = 0; Tone < ToneCount; Tone++) {
+	TraceColumns [Tone] = &Columns [Tone][First];
+      }
+
+      for (int Loop = 0; Loop < 2 * DetectorCount; Loop++) {
+	TraceColumns [ToneCount + Loop] = &Decisions [Loop * DETECT_BLOCK];
+      }
+
+      Trace->PutColumns (TraceColumns, Length);
+    }
+
+    if (Decided != NULL) {
+      *Decided = First + Length;
+    }
+  }
+
+  delete [] Masks;
+  delete [] Decisions;
+
+  // What got printed goes out once per call rather than once per symbol, and the events get written if they've been
+  // waiting long enough
+  if (SymbolEcho && (Found > 0)) {
+    fflush (stdout);
+  }
+
+  if (SymbolEvents != NULL) {
+    SymbolEvents->Poll ();
+  }
+
+  return Found;
+}
+
+void FinishEvents (DetectorType *Detectors, int DetectorCount)
+{
+  for (int Loop = 0; Loop < DetectorCount; Loop++) {
+    DetectorType *Detector = &Detectors [Loop];
+
+    if ((SymbolEvents != NULL) && (Detector->EventSymbol >= 0) && Detector->EventPrinted) {
+      PutEvent (Detector);
+    }
+
+    Detector->EventSymbol = -1;
+  }
+}
@@ -0,0 +1,134 @@
+// Protocols.h
+//
+// The tone signalling systems tt-dec knows how to pick out, and the shared
+// tone table they get merged into so every protocol that's switched on runs
+// off the same filters (or resonators, or FFT) in the same pass.
+
+// DTMF frequencies
+#define		ROW1				697
+#define		ROW2				770
+#define		ROW3				852
+#define		ROW4				941
+
+#define		COL1				1209
+#define		COL2				1336
+#define		COL3				1477
+#define		COL4				1633
+
+// Minimum number of milliseconds to be a valid touch tone
+#define		MIN_DTMF_DURATION_MS		24
+
+// Don't detect anything when the input power is this low (unless --threshold says otherwise).  The filters have a
+// gain of one in their pass band so this is the average rectified output as a fraction of full scale.
+#define		POWER_THRESHOLD			0.001
+
+// The percentage error allowed for a touch tone
+#define		STANDARD_DTMF_TOLERANCE		0.035							// The standard allowance
+#define		SIDE_DTMF_TOLERANCE		(STANDARD_DTMF_TOLERANCE / 5.0)				// What I allow above and below in percent
+
+// How wide (as a multiple of SIDE_DTMF_TOLERANCE on either side of the tone) the IIR resonators' pass bands are for
+// DTMF.  A one pole resonator only rolls off at 6 dB an octave so it can't be as narrow as the FIRs without ringing
+// for longer than a touch tone lasts.
+#define		RESONATOR_BANDWIDTH_SCALE	2.0
+
+// The most tones one protocol compares against each other, the most in the shared table and the most protocols that
+// can be switched on at once
+#define		MAX_PROTOCOL_TONES		8
+#define		MAX_TONES			32
+#define		MAX_DETECTORS			8
+
+// One thing a protocol can report: a label and the one or two frequencies (the second is 0 for one) that make it up.
+typedef struct {
+  const char *Label;
+  double      Frequencies [2];
+} SymbolType;
+
+// One signalling system.  A symbol is seen when its tones are the only ones out of Frequencies that are above the
+// average of all of them for MinDurationMs.  Tolerance is the fraction either side of each tone its filter has to
+// pass, Bandwidth is the resonators' -3 dB width in Hz.
+typedef struct {
+  const char *Name;
+  double      Frequencies [MAX_PROTOCOL_TONES];						// Ends early at a 0
+  SymbolType *Symbols;									// Ends at a NULL label
+  double      Tolerance;
+  double      Bandwidth;
+  int         MinDurationMs;
+} ProtocolType;
+
+// Every protocol, ending at a NULL name
+extern ProtocolType Protocols [];
+
+// When SymbolLog isn't NULL every symbol DetectSymbols prints gets added to the end of it too (it's always ended with
+// a 0), up to SymbolLogSize characters.  SymbolLogLength carries on counting past that, so it's easy to tell when the
+// log was too small.  Setting SymbolEcho to false stops them being printed at all.  When SymbolEvents isn't NULL
+// every symbol that gets printed also goes to it as an event once it's over (see Events.h).  When SymbolMetrics isn't
+// NULL every detector counts the windows it decides on, the ones its tones were too quiet to look at and the symbols
+// it prints in its WindowMetric, QuietMetric and SymbolMetric (see DSPlibMetrics.h), unless they're -1 (which
+// SetupDetector sets them to).
+class EventWriter;
+class DSPlibMetrics;
+
+extern char          *SymbolLog;
+extern long           SymbolLogSize, SymbolLogLength;
+extern bool           SymbolEcho;
+extern EventWriter   *SymbolEvents;
+extern DSPlibMetrics *SymbolMetrics;
+
+// One frequency in the shared front end, with a filter spec that suits every protocol that uses it
+typedef struct {
+  double Frequency;
+  double LowStop, LowPass, HighPass, HighStop;
+  double Bandwidth;
+} ToneType;
+
+// A protocol that's switched on.  Tones are where its frequencies ended up in the tone table, SymbolTones are each
+// symbol's tones as positions in Tones (-1 for none), and Counters count the hops each tone has been on for.
+// SymbolByMask turns the set of tones that are on (bit n for Tones [n]) straight into the symbol they make, or -1.
+typedef struct {
+  ProtocolType *Protocol;
+
+  int ToneCount;
+  int Tones    [MAX_PROTOCOL_TONES];
+  int Counters [MAX_PROTOCOL_TONES];
+
+  int SymbolCount;
+  int (*SymbolTones) [2];
+  short SymbolByMask [1 << MAX_PROTOCOL_TONES];
+
+  int DurationThreshold;
+
+  // For the events: the symbol the tones have been making since window EventStart (-1 for none), how many windows
+  // that's been, whether it got printed and each of Tones' powers added up over those windows
+  int   EventSymbol;
+  long  EventStart, EventWindows;
+  bool  EventPrinted;
+  float EventPowers [MAX_PROTOCOL_TONES];
+
+  // Where it counts what it does in SymbolMetrics
+  int WindowMetric, QuietMetric, SymbolMetric;
+} DetectorType;
+
+// Find a protocol by name.  Returns NULL if there isn't one.
+ProtocolType *FindProtocol (const char *Name);
+
+// Add a protocol's tones to the tone table (sharing any that are already there) and fill in a detector for it.
+// Returns false if the table is full.
+bool SetupDetector (DetectorType *Detector, ProtocolType *Protocol, ToneType *Tones, int *ToneCount);
+
+// Free what SetupDetector allocated
+void DeleteDetector (DetectorType *Detector);
+
+// Run the detectors over a matrix of band powers (see Analysis.h) and print the symbols they find in the order they
+// happen.  Columns [Tone] is WindowCount powers for that tone in the tone table, starting at window FirstWindow of
+// the file (which is only used to number the events).  If Trace isn't NULL every window's
+// powers go into it, followed by two columns per detector: the symbol its tones made (-1 for none) and a 1 where the
+// symbol was printed.  If MaxSymbols isn't 0 it stops (and stops tracing) at the window where it's printed that
+// many.  Returns how many were printed, and if Decided isn't NULL how many windows it got through.  The detectors'
+// counters carry on from one call to the next.
+class DSPlibTraceWriter;
+
+int DetectSymbols (DetectorType *Detectors, int DetectorCount, int ToneCount, float **Columns, long FirstWindow,
+		   long WindowCount, double PowerThreshold, int MaxSymbols, long *Decided, DSPlibTraceWriter *Trace);
+
+// Send the events for the symbols that are still going when the decode stops to SymbolEvents
+void FinishEvents (DetectorType *Detectors, int DetectorCount);
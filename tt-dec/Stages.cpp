@@ -0,0 +1,235 @@
+// <BEHOLD the GPL!>
+// ntheory's tt-dec, a software-based, post processing style touch tone decoder
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include "../library/DSPlib.h"
+#include "../library/DSPlibMetrics.h"
+#include "../library/DSPlibPipeline.h"
+#include "../library/DSPlibWAV.h"
+
+#include "Protocols.h"
+#include "Analysis.h"
+#include "Stages.h"
+
+#include <string.h>
+
+void SetupDecode (DecodeType *Decode, AnalysisType *Analysis, int ThreadCount, long FirstWindow, long WindowCount,
+		  long SegmentWindows, short *History, long HistoryStart, long HistoryLength)
+{
+  Decode->Analysis       = Analysis;
+  Decode->ThreadCount    = ThreadCount;
+  Decode->Window         = FirstWindow;
+  Decode->WindowCount    = WindowCount;
+  Decode->SegmentWindows = SegmentWindows;
+
+  // A piece's first sample is never more than two rings (and the filters' reach) before its first window, and
+  // neither is the history a checkpoint keeps
+  Decode->SamplesSize = GetLastSample (Analysis, SegmentWindows) + 2 * Analysis->WindowLength + Analysis->FilterLength +
+			Analysis->Warmup;
+  Decode->Samples     = new short [Decode->SamplesSize];
+
+  // What the last piece (or the checkpoint) already read doesn't get read again
+  Decode->SamplesStart = GetFirstSample (Analysis, FirstWindow);
+  Decode->SamplesEnd   = Decode->SamplesStart;
+
+  if ((History != NULL) && (HistoryStart == Decode->SamplesStart)) {
+    memcpy (Decode->Samples, History, HistoryLength * sizeof (short));
+
+    Decode->SamplesEnd += HistoryLength;
+  }
+
+  Decode->Input     = NULL;
+  Decode->InputUsed = 0;
+
+  Decode->Metrics   = NULL;
+  Decode->PieceTime = 0;
+
+  // The powers go straight into the analyze stage's blocks
+  CreatePowerMatrix (Analysis, 0, &Decode->Matrix);
+}
+
+void DeleteDecode (DecodeType *Decode)
+{
+  Decode->Matrix.Power = NULL;
+
+  DeletePowerMatrix (&Decode->Matrix);
+
+  delete [] Decode->Samples;
+}
+
+long GetNextSample (DecodeType *Decode)
+{
+  return Decode->SamplesEnd;
+}
+
+short *GetDecodeSamples (DecodeType *Decode, long First)
+{
+  return &Decode->Samples [First - Decode->SamplesStart];
+}
+
+bool ReadStage (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out)
+{
+  DecodeType *Decode = (DecodeType *) State;
+  long Count = Decode->ReadLast - Decode->ReadNext;
+
+  if (Count > Out->Capacity) {
+    Count = Out->Capacity;
+  }
+
+  if (Count <= 0) {
+    return false;
+  }
+
+  Out->Position   = Decode->ReadNext;
+  Out->Length     = Decode->Reader->ReadFrames (Decode->ReadNext, Count, (unsigned char *) Out->Data);
+  Decode->ReadNext += Out->Length;
+
+  if (Decode->Metrics != NULL) {
+    Decode->Metrics->Add (Decode->ReadMetric, Out->Length);
+  }
+
+  return (Out->Length > 0);
+}
+
+bool ConvertStage (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out)
+{
+  DecodeType      *Decode = (DecodeType *) State;
+  DSPlibBlockType *In     = Pipeline->Pull (Stage - 1);
+
+  if (In == NULL) {
+    return false;
+  }
+
+  Decode->Reader->ConvertFrames ((unsigned char *) In->Data, In->Length, (short *) Out->Data);
+
+  Out->Position = In->Position;
+  Out->Length   = In->Length;
+
+  return true;
+}
+
+// Analyze a piece of the file --------------------------------------------------------------------------------------
+//   Description:
+//     Gets the samples windows Window to Window + SegmentWindows - 1 need together (dropping the ones before the first
+//       of them and adding the ones after the last piece from the stage before), then works out their band powers
+//       into Out.
+//
+//   Notes:
+//     The samples before the piece's first one are only dropped when the next piece starts, so the main loop can
+//       still save them in a checkpoint after the piece has been decided on.
+// ---------------------------------------------------------------------------------------------------------------------
+
+bool AnalyzeStage (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out)
+{
+  DecodeType   *Decode   = (DecodeType *) State;
+  AnalysisType *Analysis = Decode->Analysis;
+  long Last, First, Need, Count;
+
+  if (Decode->Window >= Decode->WindowCount) {
+    return false;
+  }
+
+  Last  = ((Decode->Window + Decode->SegmentWindows) < Decode->WindowCount) ? (Decode->Window + Decode->SegmentWindows) :
+	  Decode->WindowCount;
+  First = GetFirstSample (Analysis, Decode->Window);
+  Need  = GetLastSample (Analysis, Last);
+
+  if (First > Decode->SamplesStart) {
+    Count = (First < Decode->SamplesEnd) ? (Decode->SamplesEnd - First) : 0;
+
+    memmove (Decode->Samples, GetDecodeSamples (Decode, First), Count * sizeof (short));
+
+    Decode->SamplesStart = First;
+    Decode->SamplesEnd   = First + Count;
+  }
+
+  while (Decode->SamplesEnd < Need) {
+    if ((Decode->Input == NULL) || (Decode->InputUsed == Decode->Input->Length)) {
+      Decode->Input     = Pipeline->Pull (Stage - 1);
+      Decode->InputUsed = 0;
+
+      // The range never goes past the end of the file, but a file can be cut short while we're reading it
+      if (Decode->Input == NULL) {
+	if (Decode->Metrics != NULL) {
+	  Decode->Metrics->Add (Decode->DroppedMetric, Need - Decode->SamplesEnd);
+	}
+
+	memset (GetDecodeSamples (Decode, Decode->SamplesEnd), 0, (Need - Decode->SamplesEnd) * sizeof (short));
+
+	Decode->SamplesEnd = Need;
+	break;
+      }
+    }
+
+    Count = Decode->Input->Length - Decode->InputUsed;
+    Count = (Count < (Need - Decode->SamplesEnd)) ? Count : (Need - Decode->SamplesEnd);
+
+    memcpy (GetDecodeSamples (Decode, Decode->SamplesEnd), &((short *) Decode->Input->Data) [Decode->InputUsed],
+	    Count * sizeof (short));
+
+    Decode->SamplesEnd += Count;
+    Decode->InputUsed  += Count;
+  }
+
+  if (Decode->Metrics != NULL) {
+    Decode->PieceTime = DSPlibMetrics::GetTime ();
+  }
+
+  Decode->Matrix.Power = (float *) Out->Data;
+
+  AnalyzeWindows (Analysis, Decode->Samples, Decode->SamplesStart, Decode->Window, Last, Decode->ThreadCount,
+		  &Decode->Matrix);
+
+  Out->Position  = Decode->Window;
+  Out->Length    = Last - Decode->Window;
+  Decode->Window = Last;
+
+  return true;
+}
+
+bool DecideStage (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out)
+{
+  DecodeType      *Decode = (DecodeType *) State;
+  DSPlibBlockType *In;
+  float *Columns [MAX_TONES];
+  long Decided;
+
+  // Nothing more to decide once --max-digits has been reached (DetectSymbols takes a budget of 0 as no limit)
+  if ((Decode->MaxDigits > 0) && (Decode->Found >= Decode->MaxDigits)) {
+    return false;
+  }
+
+  if ((In = Pipeline->Pull (Stage - 1)) == NULL) {
+    return false;
+  }
+
+  // The analysis puts the tones in the tone table's order
+  for (int Tone = 0; Tone < Decode->Analysis->ToneCount; Tone++) {
+    Columns [Tone] = &((float *) In->Data) [Tone * In->Length];
+  }
+
+  Decode->Found += DetectSymbols (Decode->Detectors, Decode->DetectorCount, Decode->Analysis->ToneCount, Columns,
+				  In->Position, In->Length, Decode->Threshold,
+				  (Decode->MaxDigits > 0) ? (Decode->MaxDigits - Decode->Found) : 0, &Decided, Decode->Trace);
+
+  Out->Position = In->Position;
+  Out->Length   = Decided;
+
+  return true;
+}
@@ -0,0 +1,79 @@
+// Stages.h
+//
+// The stages tt-dec runs a WAV file through (see DSPlibPipeline.h):
+//
+//   read      frames from the file as they are in it
+//   convert   16 bit mono
+//   decimate  (--decimate) a low pass and every n'th sample
+//   analyze   a piece of the file's band powers (AnalyzeWindows), one item per window
+//   decide    DetectSymbols, one item per window it got through
+//
+// Everything up to the analysis runs on a thread of its own that reads ahead
+// while the engine's threads work on the piece before.  Whatever pulls from
+// decide (tt-dec's main loop) is the sink: it saves checkpoints and stops at
+// --max-digits.  The symbols, events and trace come out of DetectSymbols as
+// it goes, the same as they always have.
+//
+// Windows and the samples they're made from are counted from the stream's
+// origin, and at the decimated rate when there's a decimator.  The read and
+// convert stages count samples of the file.
+
+// How many frames the read and convert stages do at a time
+#define		DECODE_BLOCK_FRAMES		4096
+
+class DSPlibWAVReader;
+class DSPlibMetrics;
+
+// What the stages share
+typedef struct {
+  // read: frames ReadNext up to ReadLast of the file
+  DSPlibWAVReader *Reader;
+  long             ReadNext, ReadLast;
+
+  // analyze: windows Window up to WindowCount a piece of SegmentWindows at a time using ThreadCount threads.  The
+  // samples the piece needs are kept in Samples, which holds SamplesStart up to SamplesEnd.
+  AnalysisType    *Analysis;
+  int              ThreadCount;
+  long             Window, WindowCount, SegmentWindows;
+
+  short           *Samples;
+  long             SamplesSize, SamplesStart, SamplesEnd;
+
+  DSPlibBlockType *Input;
+  long             InputUsed;
+  PowerMatrixType  Matrix;
+
+  // decide: Found symbols so far, and no more than MaxDigits if it isn't 0
+  DetectorType      *Detectors;
+  int                DetectorCount;
+  double             Threshold;
+  int                MaxDigits, Found;
+  DSPlibTraceWriter *Trace;
+
+  // When Metrics isn't NULL: the frames read go in ReadMetric and the samples made up when the file ended early in
+  // DroppedMetric, and PieceTime is when the last piece's last samples came in (DSPlibMetrics::GetTime)
+  DSPlibMetrics     *Metrics;
+  int                ReadMetric, DroppedMetric;
+  long               PieceTime;
+} DecodeType;
+
+// Set the stages up to analyze windows FirstWindow to WindowCount - 1.  History is HistoryLength samples from
+// HistoryStart on that have already been read (NULL if there aren't any), and the read stage starts from the first
+// sample after what the analysis already has (GetNextSample).  Fill in the reader and what DetectSymbols needs
+// afterwards.
+void SetupDecode  (DecodeType *Decode, AnalysisType *Analysis, int ThreadCount, long FirstWindow, long WindowCount,
+		   long SegmentWindows, short *History, long HistoryStart, long HistoryLength);
+void DeleteDecode (DecodeType *Decode);
+
+// The first sample (counted from the origin) the analysis doesn't have yet
+long GetNextSample (DecodeType *Decode);
+
+// The samples from First on that the analysis still has, for a checkpoint.  First has to be at or after the first
+// sample of the last piece that was analyzed.
+short *GetDecodeSamples (DecodeType *Decode, long First);
+
+// The stage functions.  State is the DecodeType.
+bool ReadStage    (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out);
+bool ConvertStage (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out);
+bool AnalyzeStage (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out);
+bool DecideStage  (DSPlibPipeline *Pipeline, int Stage, void *State, DSPlibBlockType *Out);
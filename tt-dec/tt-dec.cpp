@@ -19,380 +19,866 @@
 // </BEHOLD>
 
 #include "../library/DSPlib.h"
-#include "../library/DSPlibFilter.h"
+#include "../library/DSPlibMetrics.h"
+#include "../library/DSPlibPipeline.h"
+#include "../library/DSPlibTopology.h"
+#include "../library/DSPlibTrace.h"
+#include "../library/DSPlibWAV.h"
+
+#include "Protocols.h"
+#include "Analysis.h"
+#include "Checkpoint.h"
+#include "Cache.h"
+#include "Autotune.h"
+#include "Events.h"
+#include "Stages.h"
 
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
 
-// DTMF frequencies
-#define		ROW1				697
-#define		ROW2				770
-#define		ROW3				852
-#define		ROW4				941
+// How much of the file (per thread) gets analyzed at a time.  Each piece is decided on before the next one is
+// analyzed, and the reading never gets more than a piece ahead, so --max-digits can stop partway through a long file.
+#define		DECODE_SEGMENT_MS		8000
 
-#define		COL1				1209
-#define		COL2				1336
-#define		COL3				1477
-#define		COL4				1633
+// How much of the new Nyquist frequency --decimate keeps (the rest is the decimator's transition band)
+#define		DECIMATE_PASS_BAND		0.8
 
-// Amplitude of the waves to build the FIRs
-#define		AMPLITUDE			2
+// How many samples get hashed at a time for the cache, and the most characters of symbols an entry can have
+#define		CACHE_READ_SAMPLES		65536
+#define		CACHE_MAX_SYMBOLS		65536
 
-// Duration parameters
-#define		MIN_DTMF_DURATION_MS		24							// Minimum number of milliseconds to be a valid touch tone
-#define		ACCUMULATOR_DURATION_MS		8							// The amount of time we average our FIR results over
+// The protocols we look for when --detect isn't given
+#define		DEFAULT_PROTOCOLS		"dtmf"
 
-#define		DURATION_THRESHOLD		(MIN_DTMF_DURATION_MS / ACCUMULATOR_DURATION_MS)	// The number of times to average our FIR results before checking for valid touch tones
+// The shared tone table every protocol that's switched on was merged into, and the detectors that read it
+ToneType     Tones [MAX_TONES];
+int          ToneCount;
 
-// Don't detect anything when the input power is this low
-#define		POWER_THRESHOLD			0.02
+DetectorType Detectors [MAX_DETECTORS];
+int          DetectorCount;
 
-// The percentage error allowed for a touch tone
-#define		STANDARD_DTMF_TOLERANCE		0.035							// The standard allowance
-#define		SIDE_DTMF_TOLERANCE		(STANDARD_DTMF_TOLERANCE / 5.0)				// What I allow above and below in percent
+// What --metrics (and --stats) count besides what the detectors count themselves
+int ReadMetric, DroppedMetric, BacklogMetric, LatencyMetric;
 
-// A scaling factor to make the FIRs sufficiently long to not confuse rows 1 and 2 (because they're very close) 
-#define		FILTER_LENGTH_SCALE_FACTOR	2
+// Function to switch on the protocols named in a comma separated list
+void SetupDetectors (char *Names);
 
-// This is where we accumulate our samples before we average them.
-typedef struct {
-  fftw_real Row1, Row2, Row3, Row4;
-  fftw_real Col1, Col2, Col3, Col4;
-} AccumulatorsType;
+// Functions to make the metrics for --metrics and --stats, and to print what they came to for --stats
+DSPlibMetrics *CreateMetrics (int Stream);
+void PrintMetrics (FILE *File);
 
-// This is where we count how many times we've successfully detected a tone (we compare this to DURATION_THRESHOLD to see if
-// we have a match)
-typedef struct {
-  int Row1, Row2, Row3, Row4;
-  int Col1, Col2, Col3, Col4;
-} CountersType;
+// Function to find each tone's column in a matrix
+void FindColumns (PowerMatrixType *Matrix, float **Columns);
 
-AccumulatorsType Accumulators;
-CountersType     Counters;
+// Function to start a trace of the band powers and decisions for a matrix
+DSPlibTraceWriter *CreateTrace (char *FileName, PowerMatrixType *Matrix);
 
-// The length of the filter (different for each input rate)
-int FilterLength;
+// Functions to fill in a checkpoint's settings and counters, and to check a checkpoint against the settings we have
+void FillCheckpoint (CheckpointType *Checkpoint, AnalysisType *Analysis);
+bool CheckpointFits (CheckpointType *Checkpoint, AnalysisType *Analysis);
 
-// The filter objects
-DSPlibFilter *Row1Filter, *Row2Filter, *Row3Filter, *Row4Filter;
-DSPlibFilter *Col1Filter, *Col2Filter, *Col3Filter, *Col4Filter;
+// Functions to describe every setting that changes what gets printed, and to hash the samples that get decoded
+void GetFingerprint (char *Fingerprint, int Size, AnalysisType *Analysis, int Decimate, double Threshold, int MaxDigits,
+		     long RangeStart, long Origin, long Available);
+unsigned long long HashRange (DSPlibWAVReader *Reader, long Origin, long Available);
 
-// Functions to create and delete the filters
-void CreateFilters (long Rate);
-void DeleteFilters ();
+int main (int argc, char **argv) {
+  DSPlibWAVReader *Reader = NULL;
+  DSPlibDecimator *Decimator = NULL;
+  DSPlibPipeline *Pipeline = NULL;
+  DSPlibBlockType *Block;
+  DecodeType Decode;
+  long Rate, FileRate, SampleCount;
+  int Decimate = 1;
+  bool Stats = false;
+  long WindowMs = 0, HopMs = 0;
+  double StartSeconds = -1.0, EndSeconds = -1.0;
+  long FromSample = -1, ToSample = -1;
+  long RangeStart, RangeEnd, Origin, Available, WindowCount, SegmentWindows;
+  long Next, StartWindow = 0, FirstRead = 0, Backlog, Latency;
+  int LastStage;
+  short *History = NULL;
+  long HistoryStart = 0, HistoryLength = 0;
+  int Engine = ENGINE_AUTO;
+  int ThreadCount = 0;
+  int Node = -1;
+  bool Pin = false;
+  DSPlibTopology *Topology = NULL;
+  int MaxDigits = 0, Found = 0, Timed = 0;
+  double Threshold = POWER_THRESHOLD;
+  char *InputFile;
+  char *ProtocolNames = NULL;
+  char *MatrixFile = NULL, *TraceFile = NULL;
+  char *CheckpointFile = NULL, *ResumeFile = NULL;
+  char *EventFile = NULL;
+  char *MetricsAddress = NULL;
+  int EventFormat = -1, Stream = 0;
+  long FlushKB = EVENT_FLUSH_BYTES / 1024, FlushMs = EVENT_FLUSH_MS;
+  CheckpointType Checkpoint;
+  char *CacheDirectory = getenv ("TT_DEC_CACHE");
+  bool NoCache = false, RefreshCache = false, Retune = false, Resuming = false, Finished = true;
+  char Fingerprint [4096];
+  char *Symbols;
+  unsigned long long SampleHash = 0;
+  float *Columns [MAX_TONES];
+  DSPlibTraceWriter *Trace = NULL;
+  AnalysisType Analysis;
+  PowerMatrixType Matrix;
+  int Option;
+
+  static struct option LongOptions [] = {
+    { "window",        required_argument, NULL, 'w' },
+    { "hop",           required_argument, NULL, 'H' },
+    { "engine",        required_argument, NULL, 'e' },
+    { "detect",        required_argument, NULL, 'd' },
+    { "threads",       required_argument, NULL, 'j' },
+    { "threshold",     required_argument, NULL, 't' },
+    { "matrix",        required_argument, NULL, 'm' },
+    { "trace",         required_argument, NULL, 'T' },
+    { "start",         required_argument, NULL, 's' },
+    { "end",           required_argument, NULL, 'E' },
+    { "from",          required_argument, NULL, 'f' },
+    { "to",            required_argument, NULL, 'F' },
+    { "max-digits",    required_argument, NULL, 'n' },
+    { "checkpoint",    required_argument, NULL, 'c' },
+    { "resume",        required_argument, NULL, 'r' },
+    { "cache",         required_argument, NULL, 'C' },
+    { "no-cache",      no_argument,       NULL, 'N' },
+    { "refresh-cache", no_argument,       NULL, 'R' },
+    { "retune",        no_argument,       NULL, 'u' },
+    { "events",        required_argument, NULL, 'o' },
+    { "event-format",  required_argument, NULL, 'O' },
+    { "stream",        required_argument, NULL, 'i' },
+    { "flush-kb",      required_argument, NULL, 'K' },
+    { "flush-ms",      required_argument, NULL, 'M' },
+    { "pin",           no_argument,       NULL, 'p' },
+    { "node",          required_argument, NULL, 'P' },
+    { "decimate",      required_argument, NULL, 'D' },
+    { "stats",         no_argument,       NULL, 'S' },
+    { "metrics",       required_argument, NULL, 'x' },
+    { NULL,            0,                 NULL, 0   }
+  };
+
+  // Parse the options
+  while ((Option = getopt_long (argc, argv, "w:H:e:d:j:t:m:T:s:E:f:F:n:c:r:C:NRuo:O:i:K:M:pP:D:Sx:", LongOptions, NULL)) != -1) {
+    switch (Option) {
+      case 'w': WindowMs       = atol (optarg); break;
+      case 'H': HopMs          = atol (optarg); break;
+      case 'd': ProtocolNames  = optarg;        break;
+      case 'j': ThreadCount    = atoi (optarg); break;
+      case 't': Threshold      = atof (optarg); break;
+      case 'm': MatrixFile     = optarg;        break;
+      case 'T': TraceFile      = optarg;        break;
+      case 's': StartSeconds   = atof (optarg); break;
+      case 'E': EndSeconds     = atof (optarg); break;
+      case 'f': FromSample     = atol (optarg); break;
+      case 'F': ToSample       = atol (optarg); break;
+      case 'n': MaxDigits      = atoi (optarg); break;
+      case 'c': CheckpointFile = optarg;        break;
+      case 'r': ResumeFile     = optarg;        break;
+      case 'C': CacheDirectory = optarg;        break;
+      case 'N': NoCache        = true;          break;
+      case 'R': RefreshCache   = true;          break;
+      case 'u': Retune         = true;          break;
+      case 'o': EventFile      = optarg;        break;
+      case 'i': Stream         = atoi (optarg); break;
+      case 'K': FlushKB        = atol (optarg); break;
+      case 'M': FlushMs        = atol (optarg); break;
+      case 'p': Pin            = true;          break;
+      case 'P': Node           = atoi (optarg); Pin = true; break;
+      case 'D': Decimate       = atoi (optarg); break;
+      case 'S': Stats          = true;          break;
+      case 'x': MetricsAddress = optarg;        break;
+      case 'O':
+	if ((EventFormat = FindEventFormat (optarg)) < 0) {
+	  printf ("The event format has to be \"binary\", \"csv\" or \"json\".\n");
+	  exit (0);
+	}
+	break;
+      case 'e':
+	if ((strcmp (optarg, "auto") != 0) && ((Engine = FindEngine (optarg)) < 0)) {
+	  printf ("The engine has to be \"auto\", \"fir\", \"iir\" or \"fft\".\n");
+	  exit (0);
+	}
+	break;
+      default:
+	printf ("Usage: %s [--window ms] [--hop ms] [--engine auto|fir|iir|fft] [--retune]\n"
+		"          [--detect dtmf,mf,progress,fax] [--threads n] [--threshold power] [--trace file] [--max-digits n]\n"
+		"          [--start seconds] [--end seconds] [--from sample] [--to sample]\n"
+		"          [--checkpoint file] [--resume file] [--cache directory] [--no-cache] [--refresh-cache]\n"
+		"          [--events file] [--event-format binary|csv|json] [--stream id] [--flush-kb kb] [--flush-ms ms]\n"
+		"          [--pin] [--node n] [--decimate n] [--stats] [--metrics port|socket]\n"
+		"          inputfile.wav\n"
+		"       %s --matrix tracefile [--detect ...] [--threshold power] [--trace file] [--max-digits n] [--events file ...]\n",
+		argv [0], argv [0]);
+	exit (0);
+    }
+  }
 
-// Function to check for present touch tones
-void CheckDTMF (AccumulatorsType *Power);
+  InputFile = argv [optind];
 
-bool ToneDetected;
+  // --no-cache wins over --cache (and TT_DEC_CACHE) wherever it comes
+  if (NoCache) {
+    CacheDirectory = NULL;
+  }
 
-int main (int argc, char **argv) {
-  SDL_AudioSpec *AudioSpec = NULL;
-  unsigned char *AudioBuffer = NULL;
-  unsigned long AudioBufferLength;
-  long Rate = DSPLIB_ANY_RATE;
-  long MinDTMFDuration, DurationCounter = 0;
-  fftw_real Row1Sample;
-  char *InputFile = argv [1];
+  // Pinned workers get a core each, taking turns between the sockets (or just the cores of one node).  This thread
+  // goes on the first one, so the samples it reads are on that node.
+  if (Pin) {
+    Topology = new DSPlibTopology ();
+
+    if ((Node >= 0) && !Topology->KeepNode (Node)) {
+      printf ("There's no node %d (there are %d).\n", Node, Topology->GetNodeCount ());
+      exit (0);
+    }
+
+    Topology->Pin (0);
+  }
+
+  if (ThreadCount == 0) {
+    ThreadCount = (Topology != NULL) ? Topology->GetCPUCount () : (int) sysconf (_SC_NPROCESSORS_ONLN);
+  }
+
+  if (ThreadCount < 1) {
+    ThreadCount = 1;
+  }
 
   // Check to see if we have an input file
-  if (InputFile == NULL) {
+  if ((InputFile == NULL) && (MatrixFile == NULL)) {
     printf ("You need to enter an input file.\n");
     exit (0);
   }
 
-  // Have SDL read the input file
-  AudioSpec = GetSoundDataFromWAV (InputFile, Rate, &AudioBuffer, &AudioBufferLength);
+  if (Decimate < 1) {
+    printf ("The decimation has to be at least 1.\n");
+    exit (0);
+  }
 
-  // Die if SDL doesn't like it
-  if (AudioSpec == NULL) {
-    printf ("SDL hates you.\n");
+  // A hop longer than the window would skip samples entirely
+  if ((WindowMs < 0) || (HopMs < 0) || ((WindowMs > 0) && (HopMs > WindowMs))) {
+    printf ("The hop has to be between 1 ms and the window length.\n");
     exit (0);
   }
 
-  // Get the sampling rate and calculate the minimum DTMF duration in samples, then calculate the filter length
-  Rate = AudioSpec->freq;
+  // Build the tone table from the protocols we're looking for
+  SetupDetectors ((ProtocolNames != NULL) ? ProtocolNames : (char *) DEFAULT_PROTOCOLS);
 
-  MinDTMFDuration = (unsigned long) (((fftw_real) Rate / (fftw_real) 1000.0) * (fftw_real) ACCUMULATOR_DURATION_MS);
-  FilterLength = MinDTMFDuration * FILTER_LENGTH_SCALE_FACTOR;
+  // Count what the decode does for --metrics (and --stats), and answer requests for the counts while it runs
+  if ((MetricsAddress != NULL) || Stats) {
+    SymbolMetrics = CreateMetrics (Stream);
 
-  // See if the minimum DTMF duration is too short (just a sanity check)
-  if (MinDTMFDuration == 0) {
-    printf ("Minimum DTMF duration in samples is zero.  No good!\n");
-    exit (0);
+    if ((MetricsAddress != NULL) && !SymbolMetrics->Serve (MetricsAddress)) {
+      printf ("Couldn't serve the metrics on %s.\n", MetricsAddress);
+      exit (0);
+    }
+  }
+
+  // Events go in a file of their own.  When they go to standard output the symbols aren't printed there as well.  A
+  // decode that's being resumed adds to the events it already wrote.
+  if (EventFile != NULL) {
+    SymbolEvents = new EventWriter (EventFile, (EventFormat >= 0) ? EventFormat : GuessEventFormat (EventFile),
+				    (ResumeFile != NULL) && (access (ResumeFile, F_OK) == 0), FlushKB * 1024, FlushMs);
+
+    if (!SymbolEvents->IsGood ()) {
+      printf ("Couldn't create %s.\n", EventFile);
+      exit (0);
+    }
+
+    SymbolEcho = (strcmp (EventFile, "-") != 0);
   }
 
-  // Create the filters
-  CreateFilters (Rate);
-
-  // Initialize the accumulators and the counters
-  Accumulators.Row1 = Accumulators.Row2 = Accumulators.Row3 = Accumulators.Row4 = 0.0;
-  Accumulators.Col1 = Accumulators.Col2 = Accumulators.Col3 = Accumulators.Col4 = 0.0;
-
-  Counters.Row1, Counters.Row2, Counters.Row3, Counters.Row4 = 0;
-  Counters.Col1, Counters.Col2, Counters.Col3, Counters.Col4 = 0;
-
-  ToneDetected = false;
-
-  for (unsigned long Loop = 0; Loop < (AudioBufferLength / sizeof (short)) - FilterLength; Loop++) {
-    // Grab a sample.  We need to typecast this array because the SDL routines make an array of shorts and our pointer
-    // is to an array of unsigned chars (which is also why we have to divide by sizeof (short) above).
-    fftw_real Sample = ((short *) AudioBuffer) [Loop];
-    
-    // Put the new sample into the filter objects
-    Row1Filter->PutSample (Sample); Col1Filter->PutSample (Sample);
-    Row2Filter->PutSample (Sample); Col2Filter->PutSample (Sample);
-    Row3Filter->PutSample (Sample); Col3Filter->PutSample (Sample);
-    Row4Filter->PutSample (Sample); Col4Filter->PutSample (Sample);
-
-    // If the first filter gives valid output (the FIR is sufficiently primed) we can assume that the rest will
-    // as well (they're all the same lenght with the same startup time) and we start our DTMF detection
-    if ((Row1Sample = Row1Filter->GetSample ()) != DSPFILTER_INVALID) {
-      // Increment the duration counter
-      DurationCounter++;
-
-      // Add up the filter outputs.  We rectify them with fabs so we can calculate the power by simple averaging later.
-      // This is similar to rectifying an AC signal and calculating the RMS of the resulting DC.
-      Accumulators.Row1 += fabs (Row1Sample);               Accumulators.Col1 += fabs (Col1Filter->GetSample ());
-      Accumulators.Row2 += fabs (Row2Filter->GetSample ()); Accumulators.Col2 += fabs (Col2Filter->GetSample ());
-      Accumulators.Row3 += fabs (Row3Filter->GetSample ()); Accumulators.Col3 += fabs (Col3Filter->GetSample ());
-      Accumulators.Row4 += fabs (Row4Filter->GetSample ()); Accumulators.Col4 += fabs (Col4Filter->GetSample ());
-
-      // If we've grabbed enough samples we can calculate the power
-      if (DurationCounter == MinDTMFDuration) {
-	// Reset the counter
-	DurationCounter = 0;
-
-	// Average all of the accumulators to get the power
-	Accumulators.Row1 /= MinDTMFDuration; Accumulators.Col1 /= MinDTMFDuration;
-	Accumulators.Row2 /= MinDTMFDuration; Accumulators.Col2 /= MinDTMFDuration;
-	Accumulators.Row3 /= MinDTMFDuration; Accumulators.Col3 /= MinDTMFDuration;
-	Accumulators.Row4 /= MinDTMFDuration; Accumulators.Col4 /= MinDTMFDuration;
-
-	// Do the DTMF detection
-	CheckDTMF (&Accumulators);
-
-	// Clear the accumulators for the next step
-        Accumulators.Row1 = Accumulators.Row2 = Accumulators.Row3 = Accumulators.Row4 = 0.0;
-        Accumulators.Col1 = Accumulators.Col2 = Accumulators.Col3 = Accumulators.Col4 = 0.0;
+  if (MatrixFile != NULL) {
+    // The powers were worked out (and traced) by an earlier run, so all that's left is deciding on them
+    if (!LoadPowerMatrix (MatrixFile, &Matrix)) {
+      printf ("Couldn't read a power matrix from %s.\n", MatrixFile);
+      exit (0);
+    }
+
+    FindColumns (&Matrix, Columns);
+    SetDurationThresholds (Detectors, DetectorCount, Matrix.Engine, Matrix.WindowMs, Matrix.HopMs);
+
+    if (TraceFile != NULL) {
+      Trace = CreateTrace (TraceFile, &Matrix);
+    }
+
+    // There's no file to line the windows up with, so the events count samples from the first window
+    if (SymbolEvents != NULL) {
+      SymbolEvents->SetStream (Stream, Matrix.Rate, 0, 0, Matrix.HopLength, Matrix.WindowLength);
+    }
+
+    Found = DetectSymbols (Detectors, DetectorCount, ToneCount, Columns, Matrix.FirstWindow, Matrix.WindowCount, Threshold,
+			   MaxDigits, NULL, Trace);
+
+    DeletePowerMatrix (&Matrix);
+  }
+  else {
+    // Read the header.  The samples only get read a piece at a time below.
+    Reader = new DSPlibWAVReader (InputFile);
+
+    // Die if it isn't a WAV file we can read
+    if (!Reader->IsGood ()) {
+      printf ("SDL hates you.\n");
+      exit (0);
+    }
+
+    // With --decimate everything from here on is at the lower rate: the windows, the range and the samples a
+    // checkpoint keeps.  Only reading the file (and the events, which say where in it a symbol was) go by its samples.
+    FileRate    = Reader->GetRate ();
+    Rate        = FileRate / Decimate;
+    SampleCount = Reader->GetSampleCount () / Decimate;
+
+    if ((Rate * Decimate) != FileRate) {
+      printf ("The file's rate (%ld Hz) isn't a multiple of %d.\n", FileRate, Decimate);
+      exit (0);
+    }
+
+    for (int Tone = 0; (Decimate > 1) && (Tone < ToneCount); Tone++) {
+      if (Tones [Tone].HighStop > (DECIMATE_PASS_BAND * Rate / 2.0)) {
+	printf ("Decimating by %d leaves too little bandwidth for %g Hz.\n", Decimate, Tones [Tone].Frequency);
+	exit (0);
+      }
+    }
+
+    // Pick up where a checkpoint left off (see below).  If there isn't one yet we start from the beginning, so the
+    // same command both starts a decode and restarts it.
+    if ((ResumeFile != NULL) && (access (ResumeFile, F_OK) == 0)) {
+      if (!LoadCheckpoint (ResumeFile, &Checkpoint)) {
+	printf ("%s isn't a checkpoint.\n", ResumeFile);
+	exit (0);
+      }
+
+      Resuming = true;
+    }
+
+    // Use whichever engine is fastest on this machine unless we're told which.  A decode that's being resumed carries
+    // on with the engine it started with.
+    if (Engine == ENGINE_AUTO) {
+      Engine = Resuming ? Checkpoint.Engine : ChooseEngine (Rate, Tones, ToneCount, WindowMs, HopMs, Retune);
+    }
+
+    // Calculate the window and hop in samples and design the filters
+    if (!SetAnalysisLengths (&Analysis, Engine, Rate, WindowMs, HopMs)) {
+      printf ("Analysis window or hop in samples is zero.  No good!\n");
+      exit (0);
+    }
+
+    if (Analysis.HopLength > Analysis.WindowLength) {
+      printf ("The hop has to be between 1 ms and the window length.\n");
+      exit (0);
+    }
+
+    WindowMs = Analysis.WindowMs;
+    HopMs    = Analysis.HopMs;
+
+    Analysis.Tones     = Tones;
+    Analysis.ToneCount = ToneCount;
+    Analysis.Topology  = Topology;
+
+    SetupAnalysis (&Analysis);
+    SetDurationThresholds (Detectors, DetectorCount, Engine, WindowMs, HopMs);
+
+    // Work out the range of samples to decode (the whole file unless we're told otherwise)
+    RangeStart = (FromSample >= 0) ? (FromSample / Decimate) : (StartSeconds >= 0.0) ? (long) (StartSeconds * Rate) : 0;
+    RangeEnd   = (ToSample   >= 0) ? (ToSample   / Decimate) : (EndSeconds   >= 0.0) ? (long) (EndSeconds   * Rate) : SampleCount;
+
+    if (RangeEnd > SampleCount) {
+      RangeEnd = SampleCount;
+    }
+
+    if (RangeStart >= RangeEnd) {
+      printf ("The range to decode is empty.\n");
+      exit (0);
+    }
+
+    // The filters need FilterLength samples (the resonators Warmup samples) before the range to get going, and the
+    // windows are counted from there.  They also read FilterLength samples past the last window.
+    Origin    = RangeStart - ((Engine == ENGINE_IIR) ? Analysis.Warmup : Analysis.FilterLength);
+    Origin    = (Origin > 0) ? Origin : 0;
+    Available = RangeEnd + Analysis.FilterLength;
+    Available = ((Available < SampleCount) ? Available : SampleCount) - Origin;
+
+    // The windows before the range are only there to get the filters going.  Deciding starts with the first one that's
+    // all in it.
+    StartWindow = GetWindowAt (&Analysis, RangeStart - Origin);
+
+    // Carry on from the checkpoint
+    if (Resuming) {
+      if (!CheckpointFits (&Checkpoint, &Analysis)) {
+	printf ("%s was made with different settings.\n", ResumeFile);
+	exit (0);
       }
+
+      for (int Detector = 0; Detector < DetectorCount; Detector++) {
+	memcpy (Detectors [Detector].Counters, Checkpoint.Counters [Detector], sizeof (Detectors [Detector].Counters));
+	memcpy (Detectors [Detector].EventPowers, Checkpoint.EventPowers [Detector], sizeof (Detectors [Detector].EventPowers));
+
+	Detectors [Detector].EventSymbol  = Checkpoint.EventSymbols [Detector];
+	Detectors [Detector].EventStart   = Checkpoint.EventStarts  [Detector];
+	Detectors [Detector].EventWindows = Checkpoint.EventWindows [Detector];
+	Detectors [Detector].EventPrinted = Checkpoint.EventPrinted [Detector];
+      }
+
+      Origin        = Checkpoint.Origin;
+      StartWindow   = Checkpoint.NextWindow;
+      Found         = Checkpoint.Found;
+      History       = Checkpoint.History;
+      HistoryStart  = Checkpoint.HistoryStart;
+      HistoryLength = Checkpoint.HistoryLength;
+
+      Available = RangeEnd + Analysis.FilterLength;
+      Available = ((Available < SampleCount) ? Available : SampleCount) - Origin;
+    }
+
+    WindowCount    = GetWindowCount (&Analysis, Available);
+    SegmentWindows = (ThreadCount * DECODE_SEGMENT_MS) / HopMs;
+
+    // A checkpoint from a decode that stopped at --max-digits has nothing left to find
+    if ((MaxDigits > 0) && (Found >= MaxDigits)) {
+      StartWindow = WindowCount;
+    }
+
+    if (SymbolEvents != NULL) {
+      SymbolEvents->SetStream (Stream, FileRate, Origin * Decimate, GetWindowDelay (&Analysis) * Decimate,
+			       Analysis.HopLength * Decimate, Analysis.WindowLength * Decimate);
     }
+
+    // See if these samples have been decoded with these settings before.  Runs that want more than the symbols (a
+    // trace, events or a checkpoint) always decode.
+    if ((CacheDirectory != NULL) && (TraceFile == NULL) && (EventFile == NULL) && (CheckpointFile == NULL) &&
+	(ResumeFile == NULL)) {
+      GetFingerprint (Fingerprint, sizeof (Fingerprint), &Analysis, Decimate, Threshold, MaxDigits, RangeStart, Origin,
+		      Available);
+
+      SampleHash = HashRange (Reader, Origin * Decimate, Available * Decimate);
+      Symbols    = new char [CACHE_MAX_SYMBOLS];
+
+      if (!RefreshCache && LookupCache (CacheDirectory, SampleHash, Fingerprint, &Found, Symbols, CACHE_MAX_SYMBOLS)) {
+	printf ("%s", Symbols);
+	StartWindow = WindowCount;
+	delete [] Symbols;
+      }
+      else {
+	// Keep what gets printed for the cache
+	SymbolLog       = Symbols;
+	SymbolLogSize   = CACHE_MAX_SYMBOLS;
+	SymbolLogLength = 0;
+	SymbolLog [0]   = '\0';
+      }
+    }
+
+    // Settings for the trace (the analyze stage's matrix has the same ones)
+    Matrix.Engine       = Engine;
+    Matrix.Rate         = Rate;
+    Matrix.WindowMs     = WindowMs;
+    Matrix.HopMs        = HopMs;
+    Matrix.WindowLength = Analysis.WindowLength;
+    Matrix.HopLength    = Analysis.HopLength;
+
+    if (TraceFile != NULL) {
+      Trace = CreateTrace (TraceFile, &Matrix);
+    }
+
+    // A decode that stops before the end of the range leaves the symbol it's in the middle of to the run that resumes
+    // it, if there's going to be one
+    Finished = (StartWindow < WindowCount) || (CheckpointFile == NULL);
+
+    if (StartWindow < WindowCount) {
+      // Read, convert (and decimate) on a thread of our own with room to get the whole of the next piece in while
+      // this one's analyzed and decided on (see Stages.h)
+      SetupDecode (&Decode, &Analysis, ThreadCount, StartWindow, WindowCount, SegmentWindows, History, HistoryStart,
+		   HistoryLength);
+
+      Decode.Reader        = Reader;
+      Decode.ReadNext      = Origin + GetNextSample (&Decode);
+      Decode.ReadLast      = Origin + Available;
+      Decode.Detectors     = Detectors;
+      Decode.DetectorCount = DetectorCount;
+      Decode.Threshold     = Threshold;
+      Decode.MaxDigits     = MaxDigits;
+      Decode.Found         = Found;
+      Decode.Trace         = Trace;
+      Decode.Metrics       = SymbolMetrics;
+      Decode.ReadMetric    = ReadMetric;
+      Decode.DroppedMetric = DroppedMetric;
+
+      Pipeline = new DSPlibPipeline ();
+
+      Pipeline->AddStage ("read",    ReadStage,    &Decode, Reader->GetFrameBytes (), DECODE_BLOCK_FRAMES);
+      Pipeline->AddStage ("convert", ConvertStage, &Decode, sizeof (short),           DECODE_BLOCK_FRAMES);
+
+      // The decimator's filter reaches back before the first sample it puts out and on past the last
+      if (Decimate > 1) {
+	Decimator = new DSPlibDecimator (Decimate, FileRate, DECIMATE_PASS_BAND * Rate / 2.0, Decode.ReadNext,
+					 Decode.ReadLast);
+
+	Decode.ReadNext = (Decimator->GetFirstInput () > 0) ? Decimator->GetFirstInput () : 0;
+	Decode.ReadLast = (Decimator->GetLastInput () < (long) Reader->GetSampleCount ()) ? Decimator->GetLastInput () :
+			  (long) Reader->GetSampleCount ();
+
+	Pipeline->AddStage ("decimate", DSPlibDecimator::Stage, Decimator, sizeof (short), DECODE_BLOCK_FRAMES);
+      }
+
+      Pipeline->AddQueue ((SegmentWindows * Analysis.HopLength) / DECODE_BLOCK_FRAMES + 1);
+      Pipeline->AddStage ("analyze", AnalyzeStage, &Decode, ToneCount * sizeof (float), SegmentWindows);
+
+      LastStage = Pipeline->AddStage ("decide", DecideStage, &Decode, 0, 0);
+
+      FirstRead = Decode.ReadNext;
+      Timed     = Found;
+
+      if (!Pipeline->Start ()) {
+	printf ("Couldn't start the reading thread.\n");
+	exit (0);
+      }
+
+      while ((Block = Pipeline->Pull (LastStage)) != NULL) {
+	// Everything before Next has been decided on.  That's normally the next piece, but --max-digits can stop
+	// partway through this one.
+	Next     = Block->Position + Block->Length;
+	Found    = Decode.Found;
+	Finished = (Next == WindowCount) || (CheckpointFile == NULL);
+
+	// How far the reading has got ahead of the decisions, and how long the symbols this piece printed took to come
+	// out once the last of its samples were in
+	if (SymbolMetrics != NULL) {
+	  Backlog = FirstRead + SymbolMetrics->GetCount (ReadMetric) - (Origin + GetFirstSample (&Analysis, Next)) * Decimate;
+	  Latency = DSPlibMetrics::GetTime () - Decode.PieceTime;
+
+	  SymbolMetrics->Set (BacklogMetric, (Backlog > 0) ? (double) Backlog : 0.0);
+
+	  for (; Timed < Found; Timed++) {
+	    SymbolMetrics->Observe (LatencyMetric, Latency);
+	  }
+	}
+
+	// This is a good place to be able to come back to.  What the windows that haven't been decided on yet need
+	// from before them is kept (the filters' history and the windows' running sums, or the resonators' warmup, get
+	// made again from it), and the events from before it go out first so a resumed decode doesn't leave a gap.
+	if (CheckpointFile != NULL) {
+	  if (SymbolEvents != NULL) {
+	    SymbolEvents->Flush ();
+	  }
+
+	  FillCheckpoint (&Checkpoint, &Analysis);
+
+	  Checkpoint.Origin        = Origin;
+	  Checkpoint.NextWindow    = Next;
+	  Checkpoint.Found         = Found;
+	  Checkpoint.HistoryStart  = GetFirstSample (&Analysis, Next);
+	  Checkpoint.HistoryLength = GetLastSample (&Analysis, Next) - Checkpoint.HistoryStart;
+	  Checkpoint.History       = GetDecodeSamples (&Decode, Checkpoint.HistoryStart);
+
+	  if (!SaveCheckpoint (CheckpointFile, &Checkpoint)) {
+	    printf ("Couldn't write the checkpoint to %s.\n", CheckpointFile);
+	    exit (0);
+	  }
+	}
+
+	// Stop reading once we've got as many as we were asked for
+	if ((MaxDigits > 0) && (Found >= MaxDigits)) {
+	  break;
+	}
+      }
+
+      Pipeline->Stop ();
+
+      delete Decimator;
+      DeleteDecode (&Decode);
+    }
+
+    delete [] History;
+
+    if (SymbolLog != NULL) {
+      if ((SymbolLogLength < SymbolLogSize) && !StoreCache (CacheDirectory, SampleHash, Fingerprint, Found, SymbolLog)) {
+	printf ("Couldn't write to the cache in %s.\n", CacheDirectory);
+      }
+
+      delete [] SymbolLog;
+      SymbolLog = NULL;
+    }
+
+    DeleteAnalysis (&Analysis);
+    delete Reader;
+  }
+
+  // The symbols that were still going when we stopped are events too
+  if (SymbolEvents != NULL) {
+    if (Finished) {
+      FinishEvents (Detectors, DetectorCount);
+    }
+
+    SymbolEvents->Flush ();
+
+    if (!SymbolEvents->IsGood ()) {
+      printf ("Couldn't write the events to %s.\n", EventFile);
+    }
+
+    delete SymbolEvents;
+    SymbolEvents = NULL;
+  }
+
+  if (SymbolEcho) {
+    if (Found == 0) {
+      printf ("No tones detected.\n");
+    }
+
+    printf ("\n");
+  }
+
+  if (Trace != NULL) {
+    Trace->Flush ();
+
+    if (!Trace->IsGood ()) {
+      printf ("Couldn't write the trace to %s.\n", TraceFile);
+    }
+
+    delete Trace;
   }
 
-  if (!ToneDetected) {
-    printf ("No tones detected.\n");
+  // What each stage did goes on stderr so it doesn't get mixed up with the symbols
+  if (Stats && (Pipeline != NULL)) {
+    Pipeline->PrintStats (stderr);
   }
 
-  printf ("\n");
+  if (Stats) {
+    PrintMetrics (stderr);
+  }
+
+  for (int Detector = 0; Detector < DetectorCount; Detector++) {
+    DeleteDetector (&Detectors [Detector]);
+  }
 
-  // Delete the filters
-  DeleteFilters ();
+  delete SymbolMetrics;
+  delete Pipeline;
+  delete Topology;
 }
 
-void CreateFilters (long Rate)
+void SetupDetectors (char *Names)
 {
-  void MakeFilter (fftw_real *CenterFilter, fftw_real *LowerEdgeFilter, fftw_real *UpperEdgeFilter,
-                   fftw_real *FinalFilter,
-		   double Frequency, double Amplitude, unsigned long Rate);
-
-  fftw_real *CenterFilter = NULL;
-  fftw_real *LowerEdgeFilter = NULL;
-  fftw_real *UpperEdgeFilter = NULL;
-  fftw_real *FinalFilter = NULL;
-
-  // Allocate new filters.  There are four filters here for a reason.  The first (CenterFilter) is the
-  // frequency in the DTMF standard of a row or column.  The second and third (LowerEdgeFilter and
-  // UpperEdgeFilter) are to create a "fake window" so our filter will be a little more lenient like
-  // the standard says it should.  The last filter is where all of the three previous filters are mixed
-  // together to create the... uh, well... final filter.
-  CenterFilter    = new fftw_real [FilterLength];
-  LowerEdgeFilter = new fftw_real [FilterLength];
-  UpperEdgeFilter = new fftw_real [FilterLength];
-  FinalFilter     = new fftw_real [FilterLength];
-
-  // If the allocation fails we'll quit
-  if (!(CenterFilter && LowerEdgeFilter && UpperEdgeFilter && FinalFilter)) {
-    printf ("Couldn't allocate filters\n");
-    exit (0);
+  char *Name;
+  ProtocolType *Protocol;
+
+  ToneCount     = 0;
+  DetectorCount = 0;
+
+  for (Name = strtok (Names, ","); Name != NULL; Name = strtok (NULL, ",")) {
+    if ((Protocol = FindProtocol (Name)) == NULL) {
+      printf ("There's no protocol called \"%s\".\n", Name);
+      exit (0);
+    }
+
+    if ((DetectorCount == MAX_DETECTORS) || !SetupDetector (&Detectors [DetectorCount], Protocol, Tones, &ToneCount)) {
+      printf ("Too many protocols.\n");
+      exit (0);
+    }
+
+    DetectorCount++;
   }
+}
 
-  // Make the filters for the rows and columns
+DSPlibMetrics *CreateMetrics (int Stream)
+{
+  DSPlibMetrics *Metrics = new DSPlibMetrics ();
+  char Labels [128];
+
+  // Everything says which stream it's about so the tt-decs on one machine can be told apart
+  snprintf (Labels, sizeof (Labels), "stream=\"%d\"", Stream);
+
+  ReadMetric    = Metrics->AddCounter   ("ttdec_samples_read_total", Labels, "Samples read from the file.");
+  DroppedMetric = Metrics->AddCounter   ("ttdec_dropped_samples_total", Labels,
+					 "Samples missing from the end of a file that was cut short, decoded as silence.");
+  BacklogMetric = Metrics->AddGauge     ("ttdec_backlog_samples", Labels,
+					 "Samples read from the file that haven't been decided on yet.");
+  LatencyMetric = Metrics->AddHistogram ("ttdec_detection_latency_seconds", Labels,
+					 "How long each symbol took to be printed once the last samples of its piece were in.", 1e-9);
+
+  for (int Detector = 0; Detector < DetectorCount; Detector++) {
+    snprintf (Labels, sizeof (Labels), "protocol=\"%s\",stream=\"%d\"", Detectors [Detector].Protocol->Name, Stream);
+
+    Detectors [Detector].WindowMetric = Metrics->AddCounter ("ttdec_windows_total", Labels, "Windows decided on.");
+    Detectors [Detector].QuietMetric  = Metrics->AddCounter ("ttdec_quiet_windows_total", Labels,
+							     "Windows below the threshold, which the detector skips.");
+    Detectors [Detector].SymbolMetric = Metrics->AddCounter ("ttdec_symbols_total", Labels, "Symbols printed.");
+  }
 
-  MakeFilter (CenterFilter, LowerEdgeFilter, UpperEdgeFilter, FinalFilter, (double) ROW1, AMPLITUDE, Rate);
-  Row1Filter = new DSPlibFilter (FilterLength, FinalFilter);
+  return Metrics;
+}
 
-  MakeFilter (CenterFilter, LowerEdgeFilter, UpperEdgeFilter, FinalFilter, (double) ROW2, AMPLITUDE, Rate);
-  Row2Filter = new DSPlibFilter (FilterLength, FinalFilter);
+void PrintMetrics (FILE *File)
+{
+  long Windows;
 
-  MakeFilter (CenterFilter, LowerEdgeFilter, UpperEdgeFilter, FinalFilter, (double) ROW3, AMPLITUDE, Rate);
-  Row3Filter = new DSPlibFilter (FilterLength, FinalFilter);
+  fprintf (File, "\n%-12s %12s %8s %8s\n", "protocol", "windows", "quiet", "symbols");
 
-  MakeFilter (CenterFilter, LowerEdgeFilter, UpperEdgeFilter, FinalFilter, (double) ROW4, AMPLITUDE, Rate);
-  Row4Filter = new DSPlibFilter (FilterLength, FinalFilter);
+  for (int Detector = 0; Detector < DetectorCount; Detector++) {
+    Windows = SymbolMetrics->GetCount (Detectors [Detector].WindowMetric);
 
-  MakeFilter (CenterFilter, LowerEdgeFilter, UpperEdgeFilter, FinalFilter, (double) COL1, AMPLITUDE, Rate);
-  Col1Filter = new DSPlibFilter (FilterLength, FinalFilter);
+    fprintf (File, "%-12s %12ld %7.1f%% %8ld\n", Detectors [Detector].Protocol->Name, Windows,
+	     (Windows > 0) ? (100.0 * (double) SymbolMetrics->GetCount (Detectors [Detector].QuietMetric) / (double) Windows) :
+	     0.0, SymbolMetrics->GetCount (Detectors [Detector].SymbolMetric));
+  }
 
-  MakeFilter (CenterFilter, LowerEdgeFilter, UpperEdgeFilter, FinalFilter, (double) COL2, AMPLITUDE, Rate);
-  Col2Filter = new DSPlibFilter (FilterLength, FinalFilter);
+  if (SymbolMetrics->GetCount (LatencyMetric) > 0) {
+    fprintf (File, "\nSymbols came out %.3f ms (median), %.3f ms (99%%) after the last of their piece was read\n",
+	     SymbolMetrics->GetQuantile (LatencyMetric, 0.5) * 1000.0, SymbolMetrics->GetQuantile (LatencyMetric, 0.99) * 1000.0);
+  }
 
-  MakeFilter (CenterFilter, LowerEdgeFilter, UpperEdgeFilter, FinalFilter, (double) COL3, AMPLITUDE, Rate);
-  Col3Filter = new DSPlibFilter (FilterLength, FinalFilter);
+  if (SymbolMetrics->GetCount (DroppedMetric) > 0) {
+    fprintf (File, "%ld samples were missing from the end of the file\n", SymbolMetrics->GetCount (DroppedMetric));
+  }
+}
+
+DSPlibTraceWriter *CreateTrace (char *FileName, PowerMatrixType *Matrix)
+{
+  char Names [MAX_TONES + 2 * MAX_DETECTORS][64];
+  const char *ColumnNames [MAX_TONES + 2 * MAX_DETECTORS];
+  char Comment [256];
+  int Columns = 0;
+  DSPlibTraceWriter *Trace;
+
+  // One column per tone (named after its frequency so --matrix can find it), then each detector's decisions
+  for (int Tone = 0; Tone < ToneCount; Tone++) {
+    snprintf (Names [Columns++], sizeof (Names [0]), "%g", Tones [Tone].Frequency);
+  }
 
-  MakeFilter (CenterFilter, LowerEdgeFilter, UpperEdgeFilter, FinalFilter, (double) COL4, AMPLITUDE, Rate);
-  Col4Filter = new DSPlibFilter (FilterLength, FinalFilter);
+  for (int Detector = 0; Detector < DetectorCount; Detector++) {
+    snprintf (Names [Columns++], sizeof (Names [0]), "%s.symbol",  Detectors [Detector].Protocol->Name);
+    snprintf (Names [Columns++], sizeof (Names [0]), "%s.printed", Detectors [Detector].Protocol->Name);
+  }
 
-  // Delete the temporary filters
-  delete CenterFilter;
-  delete LowerEdgeFilter;
-  delete UpperEdgeFilter;
-  delete FinalFilter;
+  for (int Column = 0; Column < Columns; Column++) {
+    ColumnNames [Column] = Names [Column];
+  }
 
-  // If we couldn't allocate a filter object we'll quit
-  if (!(Row1Filter && Row2Filter && Row3Filter && Row4Filter &&
-        Col1Filter && Col2Filter && Col3Filter && Col4Filter)) {
-    printf ("Couldn't allocate a DSPlibFilter\n");
+  snprintf (Comment, sizeof (Comment), POWER_TRACE_COMMENT, Matrix->Engine, Matrix->Rate, Matrix->WindowMs,
+	    Matrix->HopMs, Matrix->WindowLength, Matrix->HopLength);
+
+  Trace = new DSPlibTraceWriter (FileName, Columns, ColumnNames, (double) Matrix->Rate / (double) Matrix->HopLength,
+				 Comment);
+
+  if (!Trace->IsGood ()) {
+    printf ("Couldn't create %s.\n", FileName);
     exit (0);
   }
+
+  return Trace;
 }
 
-void DeleteFilters ()
+void FillCheckpoint (CheckpointType *Checkpoint, AnalysisType *Analysis)
 {
-  // Delete all of the filter objects we created in CreateFilters
-  delete Row1Filter;
-  delete Row2Filter;
-  delete Row3Filter;
-  delete Row4Filter;
-
-  delete Col1Filter;
-  delete Col2Filter;
-  delete Col3Filter;
-  delete Col4Filter;
+  memset (Checkpoint, 0, sizeof (CheckpointType));
+
+  Checkpoint->Engine        = Analysis->Engine;
+  Checkpoint->Rate          = Analysis->Rate;
+  Checkpoint->WindowLength  = Analysis->WindowLength;
+  Checkpoint->HopLength     = Analysis->HopLength;
+  Checkpoint->ToneCount     = ToneCount;
+  Checkpoint->DetectorCount = DetectorCount;
+
+  for (int Tone = 0; Tone < ToneCount; Tone++) {
+    Checkpoint->Frequencies [Tone] = Tones [Tone].Frequency;
+  }
+
+  for (int Detector = 0; Detector < DetectorCount; Detector++) {
+    strncpy (Checkpoint->Protocols [Detector], Detectors [Detector].Protocol->Name, sizeof (Checkpoint->Protocols [0]) - 1);
+    memcpy (Checkpoint->Counters [Detector], Detectors [Detector].Counters, sizeof (Detectors [Detector].Counters));
+    memcpy (Checkpoint->EventPowers [Detector], Detectors [Detector].EventPowers, sizeof (Detectors [Detector].EventPowers));
+
+    Checkpoint->EventSymbols [Detector] = Detectors [Detector].EventSymbol;
+    Checkpoint->EventStarts  [Detector] = Detectors [Detector].EventStart;
+    Checkpoint->EventWindows [Detector] = Detectors [Detector].EventWindows;
+    Checkpoint->EventPrinted [Detector] = Detectors [Detector].EventPrinted;
+  }
 }
 
-void MakeFilter (fftw_real *CenterFilter, fftw_real *LowerEdgeFilter, fftw_real *UpperEdgeFilter,
-                 fftw_real *FinalFilter,
-		 double Frequency, double Amplitude, unsigned long Rate)
+bool CheckpointFits (CheckpointType *Checkpoint, AnalysisType *Analysis)
 {
-  // Generate the three tones (this is a special case hack of an FIR)
-  GenerateSine (CenterFilter,    FilterLength, Frequency,                                     Amplitude, Rate);
-  GenerateSine (LowerEdgeFilter, FilterLength, Frequency - (Frequency * SIDE_DTMF_TOLERANCE), Amplitude, Rate);
-  GenerateSine (UpperEdgeFilter, FilterLength, Frequency + (Frequency * SIDE_DTMF_TOLERANCE), Amplitude, Rate);
+  // The counters only mean something to the same detectors counting the same hops, and the history is only the
+  // filters' state for the same filters
+  if ((Checkpoint->Engine != Analysis->Engine) || (Checkpoint->Rate != Analysis->Rate) ||
+      (Checkpoint->WindowLength != Analysis->WindowLength) || (Checkpoint->HopLength != Analysis->HopLength) ||
+      (Checkpoint->ToneCount != ToneCount) || (Checkpoint->DetectorCount != DetectorCount)) {
+    return false;
+  }
+
+  for (int Tone = 0; Tone < ToneCount; Tone++) {
+    if (fabs (Checkpoint->Frequencies [Tone] - Tones [Tone].Frequency) >= 0.5) {
+      return false;
+    }
+  }
+
+  for (int Detector = 0; Detector < DetectorCount; Detector++) {
+    if (strcmp (Checkpoint->Protocols [Detector], Detectors [Detector].Protocol->Name) != 0) {
+      return false;
+    }
+  }
 
-  // Mix them together
-  MixArrays (CenterFilter, CenterFilter, LowerEdgeFilter, UpperEdgeFilter, FinalFilter, FilterLength);
+  return true;
 }
 
-void CheckDTMF (AccumulatorsType *Power)
+void GetFingerprint (char *Fingerprint, int Size, AnalysisType *Analysis, int Decimate, double Threshold, int MaxDigits,
+		     long RangeStart, long Origin, long Available)
 {
-  fftw_real Average = 0.0;
-  fftw_real LocalThreshold = 0.0;
-  int RowCounter = 0;
-  int ColCounter = 0;
-
-  // Calculate the total power
-  Average = Power->Row1 + Power->Row2 + Power->Row3 + Power->Row4 +
-            Power->Col1 + Power->Col2 + Power->Col3 + Power->Col4;
-
-  // Get the average of it by dividing by the number of inputs
-  Average /= 8.0;
-
-  // If the power is too low we should exit
-  if (Average < POWER_THRESHOLD) {
-    Counters.Row1 = Counters.Row2 = Counters.Row3 = Counters.Row4 = 0;
-    Counters.Col1 = Counters.Col2 = Counters.Col3 = Counters.Col4 = 0;
-
-    return;
-  }
-
-  // Ok, here's the meat of the algorithm.  Basically we look to see which filters have a power
-  // greater than the average power.  If there isn't exactly one column and one row that is
-  // larger than the average power then we aren't seeing a touch tone.  If there is more than
-  // one column or more than one row we can't decypher which one is correct so we throw it away.
-  //
-  // We also keep track of how many times a row or column filter has passed this test.  Once
-  // it has passed the test exactly DURATION_THRESHOLD times we'll print it out.  We then keep
-  // counting the number of times it passes the test.  Once it fails we'll reset it to zero.
-  // Since we only print success messages when it's exactly equal to DURATION_THRESHOLD the
-  // touch tones can be as long as they'd like and they'll only be printed once.
-  //
-  // ::whew::
-
-  // Increment the counters where necessary
-  if (Power->Row1 > Average) { Counters.Row1++; RowCounter++; } else { Counters.Row1 = 0; }
-  if (Power->Row2 > Average) { Counters.Row2++; RowCounter++; } else { Counters.Row2 = 0; }
-  if (Power->Row3 > Average) { Counters.Row3++; RowCounter++; } else { Counters.Row3 = 0; }
-  if (Power->Row4 > Average) { Counters.Row4++; RowCounter++; } else { Counters.Row4 = 0; }
-
-  if (Power->Col1 > Average) { Counters.Col1++; ColCounter++; } else { Counters.Col1 = 0; }
-  if (Power->Col2 > Average) { Counters.Col2++; ColCounter++; } else { Counters.Col2 = 0; }
-  if (Power->Col3 > Average) { Counters.Col3++; ColCounter++; } else { Counters.Col3 = 0; }
-  if (Power->Col4 > Average) { Counters.Col4++; ColCounter++; } else { Counters.Col4 = 0; }
-
-  // Here's the big ugly test that will be simplified in the next version with arrays.  I was
-  // tired, this was easy, and so it stays temporarily.  :)
-  if ((RowCounter == 1) && (ColCounter == 1)) {
-    // We detected two touch tones present at the same time.  Check to see if they've
-    // been around long enough.
-    if (Counters.Row1 == DURATION_THRESHOLD) {
-      if (Counters.Col1 == DURATION_THRESHOLD) {
-	printf ("1"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col2 == DURATION_THRESHOLD) {
-	printf ("2"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col3 == DURATION_THRESHOLD) {
-	printf ("3"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col4 == DURATION_THRESHOLD) {
-	printf ("A"); fflush (stdout); ToneDetected = true;
-      }
-    }
-    else if (Counters.Row2 == DURATION_THRESHOLD) {
-      if (Counters.Col1 == DURATION_THRESHOLD) {
-	printf ("4"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col2 == DURATION_THRESHOLD) {
-	printf ("5"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col3 == DURATION_THRESHOLD) {
-	printf ("6"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col4 == DURATION_THRESHOLD) {
-	printf ("B"); fflush (stdout); ToneDetected = true;
-      }
+  int Length;
+
+  // Where the samples are matters as well as what they are, since the range starts the detectors off
+  Length = snprintf (Fingerprint, Size, "engine=%d rate=%ld decimate=%d window=%ld hop=%ld filter=%d warmup=%ld "
+		     "threshold=%.17g max=%d start=%ld origin=%ld samples=%ld tones=", Analysis->Engine, Analysis->Rate,
+		     Decimate, Analysis->WindowLength, Analysis->HopLength, Analysis->FilterLength, Analysis->Warmup,
+		     Threshold, MaxDigits, RangeStart, Origin, Available);
+
+  // The pass and stop bands are where the tolerances end up
+  for (int Tone = 0; (Tone < ToneCount) && (Length < Size); Tone++) {
+    Length += snprintf (&Fingerprint [Length], Size - Length, "%.17g/%.17g/%.17g/%.17g/%.17g/%.17g,",
+			Tones [Tone].Frequency, Tones [Tone].LowStop, Tones [Tone].LowPass, Tones [Tone].HighPass,
+			Tones [Tone].HighStop, Tones [Tone].Bandwidth);
+  }
+
+  for (int Detector = 0; (Detector < DetectorCount) && (Length < Size); Detector++) {
+    Length += snprintf (&Fingerprint [Length], Size - Length, " %s/%d/%d", Detectors [Detector].Protocol->Name,
+			Detectors [Detector].Protocol->MinDurationMs, Detectors [Detector].DurationThreshold);
+  }
+}
+
+unsigned long long HashRange (DSPlibWAVReader *Reader, long Origin, long Available)
+{
+  short *Samples = new short [CACHE_READ_SAMPLES];
+  unsigned long long Hash = CACHE_HASH_SEED;
+  long Count;
+
+  for (long Done = 0; Done < Available; Done += Count) {
+    Count = ((Available - Done) < CACHE_READ_SAMPLES) ? (Available - Done) : CACHE_READ_SAMPLES;
+    Count = Reader->Read (Origin + Done, Count, Samples);
+
+    if (Count == 0) {
+      break;
     }
-    else if (Counters.Row3 == DURATION_THRESHOLD) {
-      if (Counters.Col1 == DURATION_THRESHOLD) {
-	printf ("7"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col2 == DURATION_THRESHOLD) {
-	printf ("8"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col3 == DURATION_THRESHOLD) {
-	printf ("9"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col4 == DURATION_THRESHOLD) {
-	printf ("C"); fflush (stdout); ToneDetected = true;
+
+    Hash = HashSamples (Samples, Count, Hash);
+  }
+
+  delete [] Samples;
+
+  return Hash;
+}
+
+void FindColumns (PowerMatrixType *Matrix, float **Columns)
+{
+  // A loaded matrix only has to have the tones we're looking for, in any order
+  for (int Tone = 0; Tone < ToneCount; Tone++) {
+    Columns [Tone] = NULL;
+
+    for (int Column = 0; Column < Matrix->ToneCount; Column++) {
+      if (fabs (Matrix->Frequencies [Column] - Tones [Tone].Frequency) < 0.5) {
+	Columns [Tone] = &Matrix->Power [Column * Matrix->WindowCount];
       }
     }
-    else if (Counters.Row4 == DURATION_THRESHOLD) {
-      if (Counters.Col1 == DURATION_THRESHOLD) {
-	printf ("*"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col2 == DURATION_THRESHOLD) {
-	printf ("0"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col3 == DURATION_THRESHOLD) {
-	printf ("#"); fflush (stdout); ToneDetected = true;
-      }
-      else if (Counters.Col4 == DURATION_THRESHOLD) {
-	printf ("D"); fflush (stdout); ToneDetected = true;
-      }
+
+    if (Columns [Tone] == NULL) {
+      printf ("The power matrix doesn't have %g Hz in it.\n", Tones [Tone].Frequency);
+      exit (0);
     }
   }
-  else {
-    // We didn't detect two touch tones present at the same time.  Clear the counters.
-    Counters.Row1 = Counters.Row2 = Counters.Row3 = Counters.Row4 = 0;
-    Counters.Col1 = Counters.Col2 = Counters.Col3 = Counters.Col4 = 0;
-  }
 }
@@ -0,0 +1,658 @@
+// <BEHOLD the GPL!>
+// ntheory's tt-gen, a touch tone traffic generator to feed tt-dec
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include "../library/DSPlib.h"
+#include "../library/DSPlibOscillator.h"
+#include "../library/DSPlibWAV.h"
+#include "../tt-dec/Protocols.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+// How much of every channel one thread makes at a time.  Each block gets its own random numbers (from the seed, the
+// channel and the block's number) and nothing carries over from one block to the next, so the output is the same
+// whatever the thread count and only a couple of rounds of blocks are ever in memory.
+#define		GEN_BLOCK_SECONDS		10
+
+// MixArrays divides by the number of inputs, so each of the four parts (tones, speech, noise and hum) is made this
+// much louder to begin with
+#define		GEN_MIX_INPUTS			4.0
+#define		GEN_FULL_SCALE			32767.0
+
+// The speech-like bursts are a harmonic series with two formants that move every syllable and a pitch that wanders
+// a little every frame.  Their harmonics wander over the DTMF tones the way a real voice does, which is what makes
+// them worth having.
+#define		GEN_SPEECH_HARMONICS		24
+#define		GEN_SPEECH_FRAME_MS		10
+#define		GEN_SPEECH_TOP_HZ		3400.0
+#define		GEN_SYLLABLE_MS			150
+#define		GEN_SPEECH_GUARD_MS		20
+
+// Defaults
+#define		GEN_DEFAULT_RATE		8000
+#define		GEN_DEFAULT_SECONDS		60.0
+#define		GEN_DEFAULT_SYMBOLS		"0123456789*#"
+
+// A keypad for turning a symbol into its row and column
+static const char *Keypad [4]    = { "123A", "456B", "789C", "*0#D" };
+static double      RowTones [4]  = { ROW1, ROW2, ROW3, ROW4 };
+static double      ColTones [4]  = { COL1, COL2, COL3, COL4 };
+
+// Something picked evenly between Min and Max
+typedef struct {
+  double Min, Max;
+} RangeType;
+
+typedef struct {
+  int         Rate, Channels;
+  const char *Symbols;
+
+  RangeType   SNR, Twist, ToneMs, GapMs, SpeechMs;
+  double      SpeechChance;
+
+  // Levels are RMS in dB relative to full scale, the same as the labels.  HumLevel is only used when Hum is true.
+  double      NoiseLevel, SpeechLevel, HumLevel, HumFrequency;
+  bool        Hum;
+
+  unsigned long long Seed;
+} SettingsType;
+
+// One symbol that went into the output.  Onset and Offset (one past the end) count samples per channel from the
+// start of the output.
+typedef struct {
+  int    Channel;
+  char   Symbol;
+  long   Onset, Offset;
+  double SNR, Twist, Level;
+} LabelType;
+
+typedef struct {
+  SettingsType *Settings;
+
+  long   Number;									// Which block of the output
+  long   Start, Length;								// Samples per channel
+  short *Out;									// Length * Channels interleaved samples
+
+  LabelType *Labels;
+  int        LabelCount, LabelSize;
+
+  pthread_t Thread;
+} BlockType;
+
+// Functions to make a block of every channel, and to write a round of blocks out (false if the samples couldn't be)
+void *GenerateBlock (void *Block);
+bool  WriteBlock (BlockType *Block, FILE *Output, FILE *Labels);
+
+// Functions to make the parts of one channel of a block
+void AddDigits (BlockType *Block, int Channel, unsigned long long *State, fftw_real *Tones, fftw_real *Speech);
+void AddSpeech (SettingsType *Settings, unsigned long long *State, fftw_real *Speech, long Length);
+void AddNoise  (SettingsType *Settings, unsigned long long *State, fftw_real *Noise, long Length);
+
+// Functions for the random numbers
+unsigned long long SeedRandom (unsigned long long Seed, long Channel, long Block);
+double Uniform  (unsigned long long *State);
+double Pick     (RangeType *Range, unsigned long long *State);
+
+// Function to read "min,max" (or just one number for both)
+RangeType ParseRange (const char *Text);
+
+// Function to write the header of a WAV file (false if it couldn't)
+bool PutWAVHeader (FILE *Output, int Rate, int Channels, long SampleCount);
+
+int main (int argc, char **argv) {
+  SettingsType Settings;
+  double Seconds = GEN_DEFAULT_SECONDS;
+  int ThreadCount = (int) sysconf (_SC_NPROCESSORS_ONLN);
+  bool Raw = false;
+  char *OutputFile, *LabelFile = NULL, *DefaultLabels = NULL;
+  FILE *Output, *Labels = NULL, *Report = stdout;
+  long TotalLength, BlockLength, BlockCount, SymbolCount = 0;
+  BlockType *Rounds [2];
+  struct timespec Began, Ended;
+  int Option;
+
+  static struct option LongOptions [] = {
+    { "rate",          required_argument, NULL, 'r' },
+    { "channels",      required_argument, NULL, 'c' },
+    { "duration",      required_argument, NULL, 'd' },
+    { "seed",          required_argument, NULL, 's' },
+    { "threads",       required_argument, NULL, 'j' },
+    { "symbols",       required_argument, NULL, 'S' },
+    { "snr",           required_argument, NULL, 'n' },
+    { "twist",         required_argument, NULL, 't' },
+    { "tone-ms",       required_argument, NULL, 'T' },
+    { "gap-ms",        required_argument, NULL, 'g' },
+    { "noise",         required_argument, NULL, 'N' },
+    { "speech",        required_argument, NULL, 'p' },
+    { "speech-ms",     required_argument, NULL, 'P' },
+    { "speech-level",  required_argument, NULL, 'L' },
+    { "hum",           required_argument, NULL, 'h' },
+    { "hum-frequency", required_argument, NULL, 'H' },
+    { "raw",           no_argument,       NULL, 'R' },
+    { "labels",        required_argument, NULL, 'l' },
+    { NULL,            0,                 NULL, 0   }
+  };
+
+  Settings.Rate         = GEN_DEFAULT_RATE;
+  Settings.Channels     = 1;
+  Settings.Symbols      = GEN_DEFAULT_SYMBOLS;
+  Settings.SNR          = ParseRange ("15,30");
+  Settings.Twist        = ParseRange ("-4,4");
+  Settings.ToneMs       = ParseRange ("40,100");
+  Settings.GapMs        = ParseRange ("40,1000");
+  Settings.SpeechMs     = ParseRange ("200,1500");
+  Settings.SpeechChance = 0.2;
+  Settings.NoiseLevel   = -45.0;
+  Settings.SpeechLevel  = -20.0;
+  Settings.HumLevel     = -40.0;
+  Settings.HumFrequency = 60.0;
+  Settings.Hum          = false;
+  Settings.Seed         = 1;
+
+  // Parse the options
+  while ((Option = getopt_long (argc, argv, "r:c:d:s:j:S:n:t:T:g:N:p:P:L:h:H:Rl:", LongOptions, NULL)) != -1) {
+    switch (Option) {
+      case 'r': Settings.Rate         = atoi (optarg);                 break;
+      case 'c': Settings.Channels     = atoi (optarg);                 break;
+      case 'd': Seconds               = atof (optarg);                 break;
+      case 's': Settings.Seed         = strtoull (optarg, NULL, 0);    break;
+      case 'j': ThreadCount           = atoi (optarg);                 break;
+      case 'S': Settings.Symbols      = optarg;                        break;
+      case 'n': Settings.SNR          = ParseRange (optarg);           break;
+      case 't': Settings.Twist        = ParseRange (optarg);           break;
+      case 'T': Settings.ToneMs       = ParseRange (optarg);           break;
+      case 'g': Settings.GapMs        = ParseRange (optarg);           break;
+      case 'N': Settings.NoiseLevel   = atof (optarg);                 break;
+      case 'p': Settings.SpeechChance = atof (optarg);                 break;
+      case 'P': Settings.SpeechMs     = ParseRange (optarg);           break;
+      case 'L': Settings.SpeechLevel  = atof (optarg);                 break;
+      case 'h': Settings.HumLevel     = atof (optarg); Settings.Hum = true; break;
+      case 'H': Settings.HumFrequency = atof (optarg);                 break;
+      case 'R': Raw                   = true;                          break;
+      case 'l': LabelFile             = optarg;                        break;
+      default:
+	printf ("Usage: %s [--rate hz] [--channels n] [--duration seconds] [--seed n] [--threads n]\n"
+		"          [--symbols 0123456789*#ABCD] [--snr db[,db]] [--twist db[,db]] [--tone-ms ms[,ms]]\n"
+		"          [--gap-ms ms[,ms]] [--noise dbfs] [--speech chance] [--speech-ms ms[,ms]] [--speech-level dbfs]\n"
+		"          [--hum dbfs] [--hum-frequency hz] [--raw] [--labels file] output.wav|output.raw|-\n",
+		argv [0]);
+	exit (0);
+    }
+  }
+
+  OutputFile = argv [optind];
+
+  if (OutputFile == NULL) {
+    printf ("You need to enter an output file (\"-\" for standard output).\n");
+    exit (0);
+  }
+
+  if ((Settings.Rate < 2 * COL4) || (Settings.Channels < 1) || (Seconds <= 0.0)) {
+    printf ("The rate has to be at least %d Hz, with at least one channel and more than no seconds.\n", 2 * COL4);
+    exit (0);
+  }
+
+  for (const char *Symbol = Settings.Symbols; *Symbol != '\0'; Symbol++) {
+    if ((strchr (Keypad [0], *Symbol) == NULL) && (strchr (Keypad [1], *Symbol) == NULL) &&
+	(strchr (Keypad [2], *Symbol) == NULL) && (strchr (Keypad [3], *Symbol) == NULL)) {
+      printf ("\"%c\" isn't a touch tone.\n", *Symbol);
+      exit (0);
+    }
+  }
+
+  if ((Settings.Symbols [0] == '\0') || (Settings.ToneMs.Min <= 0.0) || (Settings.GapMs.Min < 0.0)) {
+    printf ("There has to be a symbol to send and the tones have to last a while.\n");
+    exit (0);
+  }
+
+  if (ThreadCount < 1) {
+    ThreadCount = 1;
+  }
+
+  // Open the output (and the labels, which go next to it unless we're told otherwise)
+  if (strcmp (OutputFile, "-") == 0) {
+    Output = stdout;
+    Report = stderr;
+  }
+  else {
+    Raw = Raw || ((strlen (OutputFile) > 4) && (strcmp (&OutputFile [strlen (OutputFile) - 4], ".raw") == 0));
+
+    if ((Output = fopen (OutputFile, "wb")) == NULL) {
+      printf ("Couldn't create %s.\n", OutputFile);
+      exit (0);
+    }
+
+    if (LabelFile == NULL) {
+      DefaultLabels = new char [strlen (OutputFile) + strlen (".labels") + 1];
+      sprintf (DefaultLabels, "%s.labels", OutputFile);
+      LabelFile = DefaultLabels;
+    }
+  }
+
+  if ((LabelFile != NULL) && ((Labels = fopen (LabelFile, "w")) == NULL)) {
+    printf ("Couldn't create %s.\n", LabelFile);
+    exit (0);
+  }
+
+  if (Labels != NULL) {
+    fprintf (Labels, "# channel\tsymbol\tonset\toffset\tsnr_db\ttwist_db\tlevel_dbfs\n");
+  }
+
+  TotalLength = (long) (Seconds * Settings.Rate);
+  BlockLength = GEN_BLOCK_SECONDS * Settings.Rate;
+  BlockCount  = (TotalLength + BlockLength - 1) / BlockLength;
+
+  if (!Raw && !PutWAVHeader (Output, Settings.Rate, Settings.Channels, TotalLength)) {
+    fprintf (Report, "Couldn't write the output.\n");
+    exit (1);
+  }
+
+  // Each round is a block per thread.  The next round is made while the last one is written.
+  Rounds [0] = new BlockType [ThreadCount];
+  Rounds [1] = new BlockType [ThreadCount];
+
+  clock_gettime (CLOCK_MONOTONIC, &Began);
+
+  for (long First = 0, Round = 0; First < BlockCount; First += ThreadCount, Round++) {
+    // Start the first round on its own, then always start the one after the round being written
+    for (int Pass = (Round == 0) ? 0 : 1; Pass < 2; Pass++) {
+      long Start = First + Pass * ThreadCount;
+      BlockType *Set = Rounds [(Round + Pass) % 2];
+
+      for (int Thread = 0; Thread < ThreadCount; Thread++) {
+	BlockType *Block = &Set [Thread];
+
+	Block->Number = Start + Thread;
+	Block->Length = 0;
+
+	if (Block->Number >= BlockCount) {
+	  continue;
+	}
+
+	Block->Settings = &Settings;
+	Block->Start    = Block->Number * BlockLength;
+	Block->Length   = ((TotalLength - Block->Start) < BlockLength) ? (TotalLength - Block->Start) : BlockLength;
+
+	if (pthread_create (&Block->Thread, NULL, GenerateBlock, Block) != 0) {
+	  fprintf (Report, "Couldn't start a thread to make block %ld.\n", Block->Number);
+	  exit (1);
+	}
+      }
+
+      // The first round has to be finished before it can be written
+      if ((Round == 0) && (Pass == 0)) {
+	for (int Thread = 0; Thread < ThreadCount; Thread++) {
+	  if (Set [Thread].Length > 0) {
+	    pthread_join (Set [Thread].Thread, NULL);
+	  }
+	}
+      }
+    }
+
+    // Write this round while the next one is being made, then wait for the next one
+    for (int Thread = 0; Thread < ThreadCount; Thread++) {
+      BlockType *Block = &Rounds [Round % 2][Thread];
+
+      if (Block->Length > 0) {
+	SymbolCount += Block->LabelCount;
+
+	if (!WriteBlock (Block, Output, Labels)) {
+	  fprintf (Report, "Couldn't write the output.\n");
+	  exit (1);
+	}
+      }
+    }
+
+    for (int Thread = 0; Thread < ThreadCount; Thread++) {
+      BlockType *Block = &Rounds [(Round + 1) % 2][Thread];
+
+      if (Block->Length > 0) {
+	pthread_join (Block->Thread, NULL);
+      }
+    }
+  }
+
+  clock_gettime (CLOCK_MONOTONIC, &Ended);
+
+  // Standard output isn't closed, but whatever's still buffered has to get out
+  if (((Output == stdout) ? (fflush (Output) != 0) : (fclose (Output) != 0)) ||
+      ((Labels != NULL) && (fclose (Labels) != 0))) {
+    fprintf (Report, "Couldn't write all of the output.\n");
+    exit (1);
+  }
+
+  {
+    double Taken = (Ended.tv_sec - Began.tv_sec) + (Ended.tv_nsec - Began.tv_nsec) / 1e9;
+
+    fprintf (Report, "%.1f seconds of %d channel(s) with %ld symbols in %.2f seconds (%.0f times real time)\n",
+	     (double) TotalLength / Settings.Rate, Settings.Channels, SymbolCount, Taken,
+	     ((double) TotalLength * Settings.Channels / Settings.Rate) / ((Taken > 0.0) ? Taken : 1e-9));
+  }
+
+  delete [] Rounds [0];
+  delete [] Rounds [1];
+  delete [] DefaultLabels;
+}
+
+void *GenerateBlock (void *Argument)
+{
+  BlockType    *Block    = (BlockType *) Argument;
+  SettingsType *Settings = Block->Settings;
+  long          Length   = Block->Length;
+  fftw_real *Tones  = new fftw_real [Length];
+  fftw_real *Speech = new fftw_real [Length];
+  fftw_real *Noise  = new fftw_real [Length];
+  fftw_real *Hum    = new fftw_real [Length];
+  short     *Mixed  = new short [Length];
+  unsigned long long State;
+
+  Block->Out        = new short [Length * Settings->Channels];
+  Block->LabelCount = 0;
+  Block->LabelSize  = 64;
+  Block->Labels     = new LabelType [Block->LabelSize];
+
+  for (int Channel = 0; Channel < Settings->Channels; Channel++) {
+    State = SeedRandom (Settings->Seed, Channel, Block->Number);
+
+    memset (Tones,  0, Length * sizeof (fftw_real));
+    memset (Speech, 0, Length * sizeof (fftw_real));
+    memset (Hum,    0, Length * sizeof (fftw_real));
+
+    AddDigits (Block, Channel, &State, Tones, Speech);
+    AddNoise  (Settings, &State, Noise, Length);
+
+    // The hum carries on from one block to the next (it's the only thing that does)
+    if (Settings->Hum) {
+      double Cycles = fmod (Settings->HumFrequency * (double) Block->Start / (double) Settings->Rate, 1.0);
+
+      GenerateSine (Hum, Length, Settings->HumFrequency,
+		    GEN_MIX_INPUTS * GEN_FULL_SCALE * sqrt (2.0) * pow (10.0, Settings->HumLevel / 20.0),
+		    360.0 * Cycles, Settings->Rate);
+    }
+
+    MixArrays (Tones, Speech, Noise, Hum, Tones, Length);
+    ConvertToInts (Tones, Mixed, Length);
+
+    for (long Sample = 0; Sample < Length; Sample++) {
+      Block->Out [Sample * Settings->Channels + Channel] = Mixed [Sample];
+    }
+  }
+
+  delete [] Tones;
+  delete [] Speech;
+  delete [] Noise;
+  delete [] Hum;
+  delete [] Mixed;
+
+  return NULL;
+}
+
+void AddDigits (BlockType *Block, int Channel, unsigned long long *State, fftw_real *Tones, fftw_real *Speech)
+{
+  SettingsType *Settings = Block->Settings;
+  double Frequencies [2] = { ROW1, COL1 };
+  double NoisePower = pow (10.0, Settings->NoiseLevel / 10.0);
+  long Position = 0, ToneLength, GapLength, Guard = (GEN_SPEECH_GUARD_MS * Settings->Rate) / 1000;
+  DSPlibOscillatorBank *Bank = new DSPlibOscillatorBank (2, Frequencies, NULL, NULL, Settings->Rate);
+
+  // Gap, symbol, gap, symbol... until the next symbol wouldn't fit in the block
+  while (true) {
+    GapLength = (long) (Pick (&Settings->GapMs, State) * Settings->Rate / 1000.0);
+
+    // Sometimes somebody talks in the gap
+    if ((Uniform (State) < Settings->SpeechChance) && (GapLength > 4 * Guard)) {
+      long SpeechLength = (long) (Pick (&Settings->SpeechMs, State) * Settings->Rate / 1000.0);
+
+      SpeechLength = (SpeechLength < (GapLength - 2 * Guard)) ? SpeechLength : (GapLength - 2 * Guard);
+      SpeechLength = ((Position + Guard + SpeechLength) < Block->Length) ? SpeechLength : (Block->Length - Position - Guard);
+
+      if (SpeechLength > 0) {
+	AddSpeech (Settings, State, &Speech [Position + Guard], SpeechLength);
+      }
+    }
+
+    Position  += GapLength;
+    ToneLength = (long) (Pick (&Settings->ToneMs, State) * Settings->Rate / 1000.0);
+
+    if ((Position + ToneLength) > Block->Length) {
+      break;
+    }
+
+    // Pick a symbol, how far it is above the noise and how much louder its column is than its row
+    {
+      char   Symbol = Settings->Symbols [(int) (Uniform (State) * strlen (Settings->Symbols))];
+      double SNR    = Pick (&Settings->SNR, State);
+      double Twist  = Pick (&Settings->Twist, State);
+      double Power  = NoisePower * pow (10.0, SNR / 10.0);
+      double Ratio  = pow (10.0, Twist / 20.0);
+      double Row    = sqrt (2.0 * Power / (1.0 + Ratio * Ratio));
+      LabelType *Label;
+      int Key;
+
+      for (Key = 0; strchr (Keypad [Key], Symbol) == NULL; Key++);
+
+      Bank->SetTone (0, RowTones [Key], GEN_MIX_INPUTS * GEN_FULL_SCALE * Row);
+      Bank->SetTone (1, ColTones [strchr (Keypad [Key], Symbol) - Keypad [Key]], GEN_MIX_INPUTS * GEN_FULL_SCALE * Row * Ratio);
+      Bank->GenerateMix (&Tones [Position], ToneLength);
+
+      if (Block->LabelCount == Block->LabelSize) {
+	LabelType *Bigger = new LabelType [2 * Block->LabelSize];
+
+	memcpy (Bigger, Block->Labels, Block->LabelSize * sizeof (LabelType));
+	delete [] Block->Labels;
+
+	Block->Labels     = Bigger;
+	Block->LabelSize *= 2;
+      }
+
+      Label = &Block->Labels [Block->LabelCount++];
+
+      Label->Channel = Channel;
+      Label->Symbol  = Symbol;
+      Label->Onset   = Block->Start + Position;
+      Label->Offset  = Block->Start + Position + ToneLength;
+      Label->SNR     = SNR;
+      Label->Twist   = Twist;
+      Label->Level   = 10.0 * log10 (Power);
+    }
+
+    Position += ToneLength;
+  }
+
+  delete Bank;
+}
+
+void AddSpeech (SettingsType *Settings, unsigned long long *State, fftw_real *Speech, long Length)
+{
+  double Frequencies [GEN_SPEECH_HARMONICS], Weights [GEN_SPEECH_HARMONICS];
+  double Power = pow (10.0, Settings->SpeechLevel / 10.0);
+  double Pitch = 90.0 + 160.0 * Uniform (State), Formant1 = 0.0, Formant2 = 0.0;
+  long Frame = (GEN_SPEECH_FRAME_MS * Settings->Rate) / 1000, Syllable = (GEN_SYLLABLE_MS * Settings->Rate) / 1000;
+  DSPlibOscillatorBank *Bank;
+
+  for (int Harmonic = 0; Harmonic < GEN_SPEECH_HARMONICS; Harmonic++) {
+    Frequencies [Harmonic] = Pitch * (Harmonic + 1);
+  }
+
+  Bank = new DSPlibOscillatorBank (GEN_SPEECH_HARMONICS, Frequencies, NULL, NULL, Settings->Rate);
+
+  for (long Position = 0; Position < Length; Position += Frame) {
+    long   Count    = ((Length - Position) < Frame) ? (Length - Position) : Frame;
+    double Envelope = sin (M_PI * (double) (Position % Syllable) / (double) Syllable);
+    double Total    = 0.0;
+
+    // A new vowel every syllable, and a pitch that drifts but stays in a voice's range
+    if ((Position % Syllable) < Frame) {
+      Formant1 = 300.0 + 600.0 * Uniform (State);
+      Formant2 = 900.0 + 1600.0 * Uniform (State);
+    }
+
+    Pitch *= 1.0 + 0.04 * (Uniform (State) - 0.5);
+    Pitch  = (Pitch < 70.0) ? 70.0 : (Pitch > 300.0) ? 300.0 : Pitch;
+
+    for (int Harmonic = 0; Harmonic < GEN_SPEECH_HARMONICS; Harmonic++) {
+      double Frequency = Pitch * (Harmonic + 1);
+      double Distance1 = (Frequency - Formant1) / 150.0, Distance2 = (Frequency - Formant2) / 200.0;
+
+      Frequencies [Harmonic] = Frequency;
+      Weights     [Harmonic] = ((Frequency < GEN_SPEECH_TOP_HZ) && (Frequency < Settings->Rate / 2.0)) ?
+			       (1.0 + 4.0 * exp (-Distance1 * Distance1) + 3.0 * exp (-Distance2 * Distance2)) / (Harmonic + 1) : 0.0;
+
+      Total += Weights [Harmonic] * Weights [Harmonic];
+    }
+
+    // Scale the harmonics so the frame has the speech's power (times the syllable's envelope)
+    for (int Harmonic = 0; Harmonic < GEN_SPEECH_HARMONICS; Harmonic++) {
+      Bank->SetTone (Harmonic, Frequencies [Harmonic],
+		     GEN_MIX_INPUTS * GEN_FULL_SCALE * Envelope * Weights [Harmonic] * sqrt (2.0 * Power / Total));
+    }
+
+    Bank->GenerateMix (&Speech [Position], Count);
+  }
+
+  delete Bank;
+}
+
+void AddNoise (SettingsType *Settings, unsigned long long *State, fftw_real *Noise, long Length)
+{
+  double Deviation = GEN_MIX_INPUTS * GEN_FULL_SCALE * pow (10.0, Settings->NoiseLevel / 20.0);
+
+  // White Gaussian noise, two samples at a time (Box-Muller)
+  for (long Sample = 0; Sample < Length; Sample += 2) {
+    double Radius = Deviation * sqrt (-2.0 * log (1.0 - Uniform (State)));
+    double Angle  = 2.0 * M_PI * Uniform (State);
+
+    Noise [Sample] = Radius * cos (Angle);
+
+    if ((Sample + 1) < Length) {
+      Noise [Sample + 1] = Radius * sin (Angle);
+    }
+  }
+}
+
+bool WriteBlock (BlockType *Block, FILE *Output, FILE *Labels)
+{
+  long Count = Block->Length * Block->Settings->Channels;
+  unsigned char *Bytes = new unsigned char [2 * Count];
+  bool Written;
+
+  // WAV and raw are both little endian
+  for (long Sample = 0; Sample < Count; Sample++) {
+    Bytes [2 * Sample]     = (unsigned char) Block->Out [Sample];
+    Bytes [2 * Sample + 1] = (unsigned char) (Block->Out [Sample] >> 8);
+  }
+
+  Written = (fwrite (Bytes, 2, Count, Output) == (size_t) Count);
+
+  if (Labels != NULL) {
+    for (int Loop = 0; Loop < Block->LabelCount; Loop++) {
+      LabelType *Label = &Block->Labels [Loop];
+
+      fprintf (Labels, "%d\t%c\t%ld\t%ld\t%.2f\t%.2f\t%.2f\n", Label->Channel, Label->Symbol, Label->Onset,
+	       Label->Offset, Label->SNR, Label->Twist, Label->Level);
+    }
+  }
+
+  delete [] Bytes;
+  delete [] Block->Out;
+  delete [] Block->Labels;
+
+  return Written;
+}
+
+unsigned long long SeedRandom (unsigned long long Seed, long Channel, long Block)
+{
+  // SplitMix64 of the three mixed together, so neighbouring blocks and channels don't start off alike
+  unsigned long long State = Seed ^ ((unsigned long long) Channel * 0x9E3779B97F4A7C15ULL) ^
+			     ((unsigned long long) Block * 0xC2B2AE3D27D4EB4FULL);
+
+  State = (State ^ (State >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  State = (State ^ (State >> 27)) * 0x94D049BB133111EBULL;
+  State =  State ^ (State >> 31);
+
+  return (State != 0) ? State : 1;
+}
+
+double Uniform (unsigned long long *State)
+{
+  // xorshift64*, top 53 bits
+  *State ^= *State >> 12;
+  *State ^= *State << 25;
+  *State ^= *State >> 27;
+
+  return (double) ((*State * 0x2545F4914F6CDD1DULL) >> 11) / 9007199254740992.0;
+}
+
+double Pick (RangeType *Range, unsigned long long *State)
+{
+  return Range->Min + (Range->Max - Range->Min) * Uniform (State);
+}
+
+RangeType ParseRange (const char *Text)
+{
+  RangeType Range;
+  const char *Comma = strchr (Text, ',');
+
+  Range.Min = atof (Text);
+  Range.Max = (Comma != NULL) ? atof (Comma + 1) : Range.Min;
+
+  return Range;
+}
+
+bool PutWAVHeader (FILE *Output, int Rate, int Channels, long SampleCount)
+{
+  unsigned char Header [44];
+  unsigned long DataSize = (unsigned long) SampleCount * Channels * 2;
+  unsigned long Fields [] = { 0, 0, 16, 0, 0, 0, 0, 0 };
+  bool TooBig;
+
+  // Over 4 GB the sizes can't be right, so they say the data goes on to the end of the file instead
+  TooBig = (DataSize > DSPLIB_WAV_TO_END - 36);
+
+  memcpy (&Header [0],  "RIFF", 4);
+  memcpy (&Header [8],  "WAVEfmt ", 8);
+  memcpy (&Header [36], "data", 4);
+
+  Fields [0] = TooBig ? DSPLIB_WAV_TO_END : DataSize + 36;
+  Fields [1] = 16;
+  Fields [2] = 1 | (Channels << 16);						// PCM, channels
+  Fields [3] = Rate;
+  Fields [4] = Rate * Channels * 2;						// Bytes per second
+  Fields [5] = (Channels * 2) | (16 << 16);					// Bytes per frame, bits
+  Fields [6] = TooBig ? DSPLIB_WAV_TO_END : DataSize;
+
+  // RIFF size, fmt size, then the format, then the data size
+  for (int Loop = 0; Loop < 4; Loop++) {
+    Header [4  + Loop] = (unsigned char) (Fields [0] >> (8 * Loop));
+    Header [16 + Loop] = (unsigned char) (Fields [1] >> (8 * Loop));
+    Header [20 + Loop] = (unsigned char) (Fields [2] >> (8 * Loop));
+    Header [24 + Loop] = (unsigned char) (Fields [3] >> (8 * Loop));
+    Header [28 + Loop] = (unsigned char) (Fields [4] >> (8 * Loop));
+    Header [32 + Loop] = (unsigned char) (Fields [5] >> (8 * Loop));
+    Header [40 + Loop] = (unsigned char) (Fields [6] >> (8 * Loop));
+  }
+
+  return (fwrite (Header, 1, 44, Output) == 44);
+}
@@ -0,0 +1,180 @@
+// <BEHOLD the GPL!>
+// ntheory's tt-trace, turns DSPlib traces back into text
+// Copyright (C) 2003  ntheory
+//
+// This program is free software; you can redistribute it and/or
+// modify it under the terms of the GNU General Public License
+// as published by the Free Software Foundation; either version 2
+// of the License, or (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+//
+// </BEHOLD>
+
+#include <rfftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "../library/DSPlibTrace.h"
+
+int main (int argc, char **argv) {
+  DSPlibTraceReader *Trace;
+  long FirstRow = 0, LastRow = -1, Rows;
+  double Start = -1.0, End = -1.0;
+  char *ColumnList = NULL, *Name;
+  bool Info = false, Negative = false;
+  int *Picked, PickedCount = 0, NameCount = 1;
+  float **Columns;
+  int Option;
+
+  static struct option LongOptions [] = {
+    { "from",    required_argument, NULL, 'f' },
+    { "to",      required_argument, NULL, 't' },
+    { "start",   required_argument, NULL, 's' },
+    { "end",     required_argument, NULL, 'e' },
+    { "columns", required_argument, NULL, 'c' },
+    { "info",    no_argument,       NULL, 'i' },
+    { NULL,      0,                 NULL, 0   }
+  };
+
+  // Parse the options
+  while ((Option = getopt_long (argc, argv, "f:t:s:e:c:i", LongOptions, NULL)) != -1) {
+    switch (Option) {
+      case 'f': FirstRow   = atol (optarg); break;
+      case 't': LastRow    = atol (optarg); break;
+      case 's': Start      = atof (optarg); Negative = Negative || (Start < 0.0); break;
+      case 'e': End        = atof (optarg); break;
+      case 'c': ColumnList = optarg;        break;
+      case 'i': Info       = true;          break;
+      default:
+	printf ("Usage: %s [--info] [--from row] [--to row] [--start seconds] [--end seconds] [--columns a,b,...] file.trace\n",
+		argv [0]);
+	exit (0);
+    }
+  }
+
+  if (argv [optind] == NULL) {
+    printf ("You need to enter a trace file.\n");
+    exit (0);
+  }
+
+  // -1 means no --start, so a negative one has to be caught as it's read
+  if (Negative || (FirstRow < 0)) {
+    printf ("--from and --start can't be negative.\n");
+    exit (0);
+  }
+
+  Trace = new DSPlibTraceReader (argv [optind]);
+
+  if (!Trace->IsGood ()) {
+    printf ("%s isn't a trace.\n", argv [optind]);
+    exit (0);
+  }
+
+  if (Info) {
+    printf ("Rows:     %ld\n", Trace->GetRowCount ());
+    printf ("Row rate: %g per second\n", Trace->GetRowRate ());
+    printf ("Comment:  %s\n", Trace->GetComment ());
+    printf ("Columns: ");
+
+    for (int Column = 0; Column < Trace->GetColumnCount (); Column++) {
+      printf (" %s", Trace->GetColumnName (Column));
+    }
+
+    printf ("\n");
+    exit (0);
+  }
+
+  // Times only mean something when the rows are evenly spaced
+  if ((Start >= 0.0) || (End >= 0.0)) {
+    if (Trace->GetRowRate () <= 0.0) {
+      printf ("This trace doesn't have a row rate so --start and --end can't be used.\n");
+      exit (0);
+    }
+
+    if (Start >= 0.0) FirstRow = (long) (Start * Trace->GetRowRate ());
+    if (End   >= 0.0) LastRow  = (long) (End   * Trace->GetRowRate ());
+  }
+
+  if ((LastRow < 0) || (LastRow > Trace->GetRowCount ())) {
+    LastRow = Trace->GetRowCount ();
+  }
+
+  // Pick the columns to print (all of them if there's no list).  A list can name a column more than once.
+  for (int Loop = 0; (ColumnList != NULL) && (ColumnList [Loop] != '\0'); Loop++) {
+    NameCount += (ColumnList [Loop] == ',') ? 1 : 0;
+  }
+
+  Picked = new int [(ColumnList == NULL) ? Trace->GetColumnCount () : NameCount];
+
+  if (ColumnList == NULL) {
+    for (int Column = 0; Column < Trace->GetColumnCount (); Column++) {
+      Picked [PickedCount++] = Column;
+    }
+  }
+  else {
+    for (Name = strtok (ColumnList, ","); Name != NULL; Name = strtok (NULL, ",")) {
+      if ((Picked [PickedCount++] = Trace->FindColumn (Name)) < 0) {
+	printf ("There's no column called \"%s\".\n", Name);
+	exit (0);
+      }
+    }
+  }
+
+  Columns = new float * [Trace->GetColumnCount ()];
+
+  for (int Column = 0; Column < Trace->GetColumnCount (); Column++) {
+    Columns [Column] = NULL;
+  }
+
+  for (int Loop = 0; Loop < PickedCount; Loop++) {
+    if (Columns [Picked [Loop]] == NULL) {
+      Columns [Picked [Loop]] = new float [DSPLIB_TRACE_BLOCK_ROWS];
+    }
+  }
+
+  // A header line, then the slice a block's worth of rows at a time so only that much of the file is ever read
+  printf ("# row%s", (Trace->GetRowRate () > 0.0) ? "\ttime" : "");
+
+  for (int Loop = 0; Loop < PickedCount; Loop++) {
+    printf ("\t%s", Trace->GetColumnName (Picked [Loop]));
+  }
+
+  printf ("\n");
+
+  for (long Row = FirstRow; Row < LastRow; Row += DSPLIB_TRACE_BLOCK_ROWS) {
+    Rows = Trace->GetRows (Row, ((LastRow - Row) < DSPLIB_TRACE_BLOCK_ROWS) ? (LastRow - Row) : DSPLIB_TRACE_BLOCK_ROWS,
+			   Columns);
+
+    for (long Loop = 0; Loop < Rows; Loop++) {
+      printf ("%ld", Row + Loop);
+
+      if (Trace->GetRowRate () > 0.0) {
+	printf ("\t%.6f", (double) (Row + Loop) / Trace->GetRowRate ());
+      }
+
+      for (int Column = 0; Column < PickedCount; Column++) {
+	printf ("\t%g", Columns [Picked [Column]][Loop]);
+      }
+
+      printf ("\n");
+    }
+  }
+
+  for (int Column = 0; Column < Trace->GetColumnCount (); Column++) {
+    delete [] Columns [Column];
+  }
+
+  delete [] Columns;
+  delete [] Picked;
+  delete Trace;
+}